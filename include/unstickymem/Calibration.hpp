@@ -0,0 +1,52 @@
+#ifndef UNSTICKYMEM_CALIBRATION_HPP_
+#define UNSTICKYMEM_CALIBRATION_HPP_
+
+#include <string>
+#include <vector>
+
+#include "unstickymem/Topology.hpp"
+
+namespace unstickymem {
+
+/**
+ * Initial node weights for the weighted modes, proportional to the read
+ * bandwidth the worker CPUs get from each node.
+ *
+ * The bandwidth is measured at startup with a STREAM-like read kernel (one
+ * thread per worker CPU) and the weights are cached per machine, so only the
+ * first run on a machine pays for the calibration.
+ */
+
+// bytes read from each node per pass, and number of passes
+static const size_t CALIBRATION_BUFFER_SIZE = 64ULL << 20;
+static const int CALIBRATION_PASSES = 4;
+
+// read bandwidth (bytes/s) of the worker CPUs from each node, by node id
+std::vector<double> measure_node_bandwidth(const Topology &topology);
+
+// weights (in %, rounded to 0.1, summing 100) proportional to `bandwidth`
+std::vector<double> bandwidth_weights(const std::vector<double> &bandwidth);
+
+// identifies the machine (CPU model, nodes) and the worker nodes
+std::string calibration_key(const Topology &topology);
+
+// the cached weights for this machine, calibrating (and caching) them first
+// if needed. an empty `cache_dir` disables the cache
+std::vector<double> calibrated_weights(const Topology &topology,
+                                       const std::string &cache_dir);
+
+// directory of the cache: $XDG_CACHE_HOME/unstickymem or ~/.cache/unstickymem
+std::string default_calibration_cache(void);
+
+// mkdir -p
+bool make_directories(const std::string &path);
+
+// weights files have one "<weight> <node id>" line per node ('#' comments)
+std::vector<double> read_weights(const std::string &filename);
+bool write_weights(const std::string &filename,
+                   const std::vector<double> &weights,
+                   const std::string &comment);
+
+}  // namespace unstickymem
+
+#endif  // UNSTICKYMEM_CALIBRATION_HPP_
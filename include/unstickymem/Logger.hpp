@@ -61,7 +61,7 @@
 #define DIEF(fmt, ...) \
   printf("\n\n");\
   L->printHorizontalRule("FATAL ERROR");\
-  LFATALF(fmt, ...);\
+  LFATALF(fmt, __VA_ARGS__);\
   LFATALF("errno:   %s", strerror(errno));\
   LFATALF("dlerror: %s", dlerror());\
   perror("perror");\
@@ -78,7 +78,7 @@
 #define DIEIFF(expr, fmt, ...) \
   do {\
     if (expr) {\
-      DIEF(fmt, ...);\
+      DIEF(fmt, __VA_ARGS__);\
     }\
   } while (0)
 
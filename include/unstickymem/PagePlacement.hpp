@@ -5,8 +5,12 @@
 #include <numaif.h>
 #include <numa.h>
 
+#include <vector>
+
 #include "unstickymem/memory/MemoryMap.hpp"
 #include "unstickymem/memory/MemorySegment.hpp"
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/placement/PlacementPlan.hpp"
 
 #define PAGE_ALIGN_DOWN(x) (((intptr_t) (x)) & PAGE_MASK)
 #define PAGE_ALIGN_UP(x) ((((intptr_t) (x)) + ~PAGE_MASK) & PAGE_MASK)
@@ -22,20 +26,38 @@ static const int PAGE_MASK = (~(PAGE_SIZE - 1));
 #define MPOL_LOCAL 4
 #endif
 
-void force_uniform_interleave(char *addr, unsigned long len);
-void force_uniform_interleave(MemorySegment &segment);
-void place_pages(void *addr, unsigned long len, double ratio);
-void place_pages_weighted_initial(const MemorySegment &segment);
-void place_pages_weighted_initial(void *addr, unsigned long len);
-void place_all_pages(MemoryMap &segments, double ratio);
+void force_uniform_interleave(
+    const Topology &topology, char *addr, unsigned long len,
+    MigrationBackend backend = MigrationBackend::MBIND);
+void force_uniform_interleave(
+    const Topology &topology, const MemorySegment &segment,
+    MigrationBackend backend = MigrationBackend::MBIND);
+void place_on_node(const Topology &topology, char *addr, unsigned long len,
+                   int node);
+void place_pages(const Topology &topology, void *addr, unsigned long len,
+                 double ratio);
+void place_pages_weighted_initial(const Topology &topology,
+                                  const MemorySegment &segment);
+void place_pages_weighted_initial(const Topology &topology, void *addr,
+                                  unsigned long len);
+// in the background, returns once the migrations are queued
+void place_all_pages(const Topology &topology, MemoryMap &segments,
+                     double ratio, bool background = false);
 void place_all_pages(double ratio);
 
-void place_pages_weighted_s(void *addr, unsigned long len, double s);
-void place_pages_weighted(void *addr, unsigned long len);
+void place_pages_weighted_s(const Topology &topology, void *addr,
+                            unsigned long len, double s);
+void place_pages_weighted(const Topology &topology, void *addr,
+                          unsigned long len,
+                          const std::vector<double> &weights);
 void place_all_pages_adaptive(double ratio);
 
-void place_all_pages_adaptive(MemoryMap &segments, double ratio);
-void place_pages_adaptive(MemorySegment &segment, double ratio);
+// the local pages are the hottest ones, if `tracker` has sampled them
+void place_all_pages_adaptive(const Topology &topology, MemoryMap &segments,
+                              double ratio,
+                              const AccessTracker *tracker = nullptr);
+void place_pages_adaptive(const Topology &topology,
+                          const MemorySegment &segment, double ratio);
 
 }  // namespace unstickymem
 
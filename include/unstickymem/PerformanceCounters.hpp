@@ -1,22 +1,60 @@
 #ifndef UNSTICKYMEM_HARDWARE_EVENTS
 #define UNSTICKYMEM_HARDWARE_EVENTS
 
+#include <unistd.h>
+
 #include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "unstickymem/Progress.hpp"
+#include "unstickymem/stats/Estimators.hpp"
+#include "unstickymem/stats/HypothesisTest.hpp"
 
 namespace unstickymem {
 
-void initialize_likwid();
+// starts the given counter backend ("auto" for the best available)
+void initialize_counters(const std::string &backend);
 
 // checks performance counters and computes stalls per second since last call
 double get_stall_rate();  // via joao barreto's lib
 
-double get_stall_rate_v2();  // via Like I Knew What I'm Doing (LIKWID Library!)
+// via the selected CounterBackend: the total over all the worker CPUs, and
+// the rate on the CPUs of each node (by node id) if node_stall_rates is given
+double get_stall_rate_v2(std::vector<double> *node_stall_rates = nullptr);
+
+// stall cycles counted on all the worker CPUs since the counters started
+double get_stall_count();
+
 void stop_all_counters();  // Restarting it might have some issues if counters are not stopped!
 
 // samples stall rate multiple times and filters outliers
 double get_average_stall_rate(size_t num_measurements,
                               useconds_t usec_between_measurements,
                               size_t num_outliers_to_filter);
+// samples the stall rate until the confidence interval of its mean is within
+// `relative_precision` of it, for at most `budget` seconds, or until `stop`
+// holds (checked after each sample, once there are enough)
+Estimate estimate_stall_rate(useconds_t usec_between_measurements,
+                             double relative_precision, double budget,
+                             const std::function<bool()> &stop = nullptr);
+// samples the stall rate until it is significantly lower, higher or the same
+// as `reference` (see compare()), or for at most `budget` seconds
+Comparison compare_stall_rate(const RunningStats &reference,
+                              useconds_t usec_between_measurements,
+                              double significance, double equivalence,
+                              double budget);
+// the same, for any objective (see Progress.hpp)
+Estimate estimate_objective(Objective objective,
+                            useconds_t usec_between_measurements,
+                            double relative_precision, double budget,
+                            const std::function<bool()> &stop = nullptr);
+Comparison compare_objective(Objective objective,
+                             const RunningStats &reference,
+                             useconds_t usec_between_measurements,
+                             double significance, double equivalence,
+                             double budget);
 double get_average_stall_rate2(size_t num_measurements,
                                useconds_t usec_between_measurements,
                                size_t num_outliers_to_filter);
@@ -25,11 +63,28 @@ double get_average_stall_rate2(size_t num_measurements,
 void unstickymem_log(double ratio, double sr);
 void unstickymem_log(double ratio);
 
+#if defined(__unix__) || defined(__linux__)
+// System-specific definitions for Linux
+
 // read time stamp counter
-inline uint64_t readtsc(void);
+inline uint64_t readtsc(void) {
+  uint32_t lo, hi;
+  __asm __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi) : : );
+  return lo | (uint64_t)hi << 32;
+}
 
 // read performance monitor counter
-inline uint64_t readpmc(int32_t n);
+inline uint64_t readpmc(int32_t n) {
+  uint32_t lo, hi;
+  __asm __volatile__ ("rdpmc" : "=a"(lo), "=d"(hi) : "c"(n) : );
+  return lo | (uint64_t)hi << 32;
+}
+
+#else  // not Linux
+
+#error We only support Linux
+
+#endif
 
 }  // namespace unstickymem
 
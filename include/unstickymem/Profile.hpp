@@ -0,0 +1,45 @@
+#ifndef UNSTICKYMEM_PROFILE_HPP_
+#define UNSTICKYMEM_PROFILE_HPP_
+
+#include <string>
+
+#include "unstickymem/Topology.hpp"
+
+namespace unstickymem {
+
+/**
+ * The result of tuning a program, kept so that the next run of the same
+ * program (same build, same arguments) on the same machine (and worker
+ * nodes) can start from it instead of searching again.
+ *
+ * Profiles are stored next to the calibrated weights, one file per program.
+ */
+struct Profile {
+  std::string mode;   // the mode that found it
+  double ratio;       // share of pages moved to the worker nodes (in %)
+  double stall_rate;  // measured there
+};
+
+// the GNU build-id of the executable (in hex), or "" if it has none
+std::string executable_build_id(void);
+
+// identifies the executable (its build-id, or its path, size and mtime), its
+// arguments, the machine and the worker nodes
+std::string profile_key(const Topology &topology);
+
+// the profile file of this program in `cache_dir`
+std::string profile_filename(const Topology &topology,
+                             const std::string &cache_dir);
+
+// profile files have "<field> <value>" lines ('#' comments). false if the
+// file does not exist or is incomplete
+bool read_profile(const std::string &filename, Profile *profile);
+bool write_profile(const std::string &filename, const Profile &profile,
+                   const std::string &comment);
+
+// as above, but atomically replacing the file (creating its directory)
+bool save_profile(const std::string &filename, const Profile &profile);
+
+}  // namespace unstickymem
+
+#endif  // UNSTICKYMEM_PROFILE_HPP_
@@ -0,0 +1,59 @@
+#ifndef UNSTICKYMEM_PROGRESS_HPP_
+#define UNSTICKYMEM_PROGRESS_HPP_
+
+#include <cstdint>
+#include <string>
+
+#include "better-enums/enum.h"
+
+namespace unstickymem {
+
+/**
+ * Progress reported by the application (see unstickymem_report_progress()
+ * and unstickymem_iteration_done()), so that the modes can tune for its
+ * throughput rather than (or as well as) for the stall rate.
+ *
+ * Each thread counts in its own cache line, without locks; the tuner adds
+ * them up when it samples. Reporting threads also add their own stalls,
+ * read from user space without stopping their counter (if the CPU lets them
+ * read it with rdpmc).
+ */
+
+// what the adaptive modes minimize:
+//   STALLS         the stall rate
+//   PROGRESS       the time per operation (or per iteration)
+//   STALLS_PER_OP  the stall cycles per operation (or per iteration)
+BETTER_ENUM(Objective, int, STALLS, PROGRESS, STALLS_PER_OP)
+
+// "stalls", "progress" or "stalls_per_op" (dies on anything else)
+Objective parse_objective(const std::string &name);
+
+// threads beyond these share their counters (still atomically)
+static const size_t PROGRESS_SLOTS = 256;
+
+struct ProgressCount {
+  uint64_t ops;
+  uint64_t iterations;
+  uint64_t stalls;  // of the reporting threads, until their last report
+};
+
+void report_progress(uint64_t ops);
+void iteration_done(void);
+
+// everything reported so far, by all the threads
+ProgressCount read_progress(void);
+
+// seconds per operation since the last call, or per iteration if no
+// operations were ever reported. periods without progress count as one
+double get_time_per_op(void);
+
+// stall cycles per operation since the last call: counted by the reporting
+// threads if they can, on all the worker CPUs otherwise
+double get_stalls_per_op(void);
+
+// the objective since the last call (lower is better)
+double get_objective(Objective objective);
+
+}  // namespace unstickymem
+
+#endif  // UNSTICKYMEM_PROGRESS_HPP_
@@ -6,6 +6,7 @@
 #include <boost/program_options.hpp>
 
 #include "unstickymem/mode/Mode.hpp"
+#include "unstickymem/Profile.hpp"
 
 namespace po = boost::program_options;
 
@@ -16,6 +17,13 @@ class Runtime {
   std::string _mode_name;
   std::shared_ptr<Mode> _mode;
   bool _autostart;
+  size_t _alloc_threshold;
+  size_t _migration_threads;
+  size_t _migration_bandwidth;
+  bool _native_weights;
+  bool _profile;
+  bool _profile_refine;
+  std::string _profile_dir;
 
  private:
   Runtime();
@@ -31,7 +39,16 @@ class Runtime {
   void printUsage();
   void printConfiguration();
   std::shared_ptr<Mode> getMode();
+  bool getAutostart() const;
+  size_t getAllocThreshold() const;
+  size_t getMigrationThreads() const;
+  size_t getMigrationBandwidth() const;
   void startSelectedMode();
+
+  // where this program's profile is kept ("" if profiles are disabled)
+  std::string profileFilename() const;
+  // keeps the result of tuning (by the selected mode) for the next run
+  void saveProfile(double ratio, double stall_rate);
 };
 
 }  // namespace unstickymem
@@ -0,0 +1,86 @@
+#ifndef UNSTICKYMEM_TOPOLOGY_HPP_
+#define UNSTICKYMEM_TOPOLOGY_HPP_
+
+#include <numa.h>
+
+#include <string>
+#include <vector>
+
+namespace unstickymem {
+
+/**
+ * The NUMA nodes of the machine (as seen by libnuma), which of them run the
+ * application (the worker nodes) and the weight of each node, i.e. the share
+ * (in %) of the pages it should get when interleaving.
+ *
+ * Nodemasks are `unsigned long`s, so node ids go up to 63.
+ */
+class Topology {
+ public:
+  struct Node {
+    int id;
+    std::vector<int> cpus;  // all the CPUs of the node
+    bool allowed_cpus;  // whether the process cpuset has any of its CPUs
+    bool allowed_memory;  // whether the process can allocate from it
+    long long memory;  // bytes
+    bool worker;
+  };
+
+ private:
+  std::vector<Node> _nodes;  // indexed by node id
+  std::vector<std::vector<int>> _distances;
+  std::vector<struct bitmask*> _node_bitmasks;
+  unsigned long _memory_mask = 0;
+  unsigned long _worker_mask = 0;
+  std::vector<double> _weights;  // indexed by node id
+
+ private:
+  Topology();
+
+ public:
+  // singleton
+  static Topology& getInstance(void);
+  Topology(Topology const&) = delete;
+  void operator=(Topology const&) = delete;
+
+  // all the (configured) nodes, by id
+  const std::vector<Node>& nodes(void) const;
+  const Node& node(int id) const;
+  size_t numNodes(void) const;
+  int distance(int from, int to) const;
+
+  // nodes we can place pages on (with memory, allowed by the cpuset)
+  std::vector<int> memoryNodes(void) const;
+  unsigned long memoryMask(void) const;
+  // nodes with CPUs we are allowed to run on
+  std::vector<int> cpuNodes(void) const;
+
+  // bitmask with only the given node set (do not free)
+  const struct bitmask* nodeBitmask(int id) const;
+
+  // worker nodes: from UNSTICKYMEM_WORKER_NODES (e.g. "0,2-3"),
+  // UNSTICKYMEM_WORKERS (the first N nodes) or the nodes in our cpuset
+  // (only the one we start on if the cpuset spans all the memory nodes)
+  void setWorkerNodes(const std::vector<int> &nodes);
+  void detectWorkerNodes(void);
+  std::vector<int> workerNodes(void) const;
+  unsigned long workerMask(void) const;
+  bool isWorker(int id) const;
+
+  // initial weights (in %) of every node, indexed by id
+  void setWeights(const std::vector<double> &weights);
+  const std::vector<double>& weights(void) const;
+  double workerWeight(void) const;
+  double nonWorkerWeight(void) const;
+  // weights when `s` more % of the pages go to the worker nodes
+  std::vector<double> weightsForWorkerShare(double s) const;
+
+  void print(void) const;
+
+  // parses a libnuma node string ("0-3,5")
+  static std::vector<int> parseNodeList(const std::string &list);
+};
+
+}  // namespace unstickymem
+
+#endif  // UNSTICKYMEM_TOPOLOGY_HPP_
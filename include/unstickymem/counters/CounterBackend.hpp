@@ -0,0 +1,81 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_COUNTERBACKEND_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_COUNTERBACKEND_HPP_
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/Logger.hpp"
+
+namespace unstickymem {
+
+/**
+ * A source of stall counts (the hardware performance counters).
+ *
+ * Backends register themselves by name, like the modes, and the one to use
+ * is picked at runtime (UNSTICKYMEM_COUNTERS). With "auto" they are tried by
+ * priority until one starts, ending with "none", which always does. Backends
+ * with a negative priority are only used when requested by name.
+ */
+class CounterBackend {
+  using create_f = std::unique_ptr<CounterBackend>();
+  using Description = struct {
+    create_f* create_function;
+    std::string description;
+    int priority;  // "auto" tries the highest first (negative: never)
+  };
+
+ private:
+  static std::map<std::string, Description> & registry();
+
+ public:
+  virtual ~CounterBackend() = default;
+
+  // opens and starts the counters. false if they are not available here
+  virtual bool start(const Topology &topology) = 0;
+  virtual void stop() = 0;
+
+  // stall cycles counted since start on the CPUs of each node (by node id)
+  virtual std::vector<double> readNodeStalls() = 0;
+
+  // stall cycles counted since start, on all the CPUs
+  double readStalls();
+
+  static void registerBackend(std::string const & name, Description desc) {
+    // disallow replacing entries
+    DIEIF(registry().count(name) == 1, "Counter backend already registered");
+    registry()[name] = desc;
+  }
+
+  static std::unique_ptr<CounterBackend> create(std::string const & name);
+
+  // starts the backend `name` (or the best available for "auto"), falling
+  // back to the others if it cannot start
+  static std::unique_ptr<CounterBackend> select(std::string const & name,
+                                                const Topology &topology,
+                                                std::string *selected);
+
+  static void printAvailableBackends();
+
+  // "GenuineIntel", "AuthenticAMD", ... (from /proc/cpuinfo)
+  static std::string cpuVendor(void);
+
+  // the CPUs of the worker nodes we are allowed to run on
+  static std::vector<int> workerCpus(const Topology &topology);
+
+  template<typename BackendImplementation>
+  struct Registrar {
+    explicit Registrar(std::string const & name,
+                       std::string const & description, int priority) {
+      CounterBackend::registerBackend(
+          name, { &BackendImplementation::createInstance, description,
+              priority });
+    }
+  };
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_COUNTERBACKEND_HPP_
@@ -0,0 +1,52 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_EVENTTABLE_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_EVENTTABLE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "better-enums/enum.h"
+#include "unstickymem/counters/PerfEventBackend.hpp"
+
+namespace unstickymem {
+
+// what the counters measure
+BETTER_ENUM(CounterMetric, int, STALLS, LOCAL_DRAM, REMOTE_DRAM, BANDWIDTH)
+
+// the CPU we run on, as in /proc/cpuinfo
+struct CpuModel {
+  std::string vendor;  // "GenuineIntel", "AuthenticAMD", ...
+  int family;
+  int model;
+
+  static CpuModel current(void);
+};
+
+// the events of one microarchitecture (a range of models of a family)
+struct Microarchitecture {
+  const char *name;
+  const char *vendor;
+  int family;
+  int first_model;
+  int last_model;
+  // raw perf events for each metric, best first
+  std::vector<PerfEventBackend::Event> stalls;
+  std::vector<PerfEventBackend::Event> local_dram;
+  std::vector<PerfEventBackend::Event> remote_dram;
+  std::vector<PerfEventBackend::Event> bandwidth;  // 64B lines from memory
+  const char *likwid_stalls;  // LIKWID event set, nullptr if none
+};
+
+// the table entry of the CPU, nullptr if it is not in the table
+const Microarchitecture* find_microarchitecture(const CpuModel &cpu);
+
+// the events to try for a metric: the CPU's own events, then the kernel's
+// generic ones (which it maps to whatever the CPU has, if anything)
+std::vector<PerfEventBackend::Event> counter_events(
+    CounterMetric metric, const CpuModel &cpu = CpuModel::current());
+
+// the LIKWID event set that counts stalls on the CPU, nullptr if none
+const char* likwid_stall_events(const CpuModel &cpu = CpuModel::current());
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_EVENTTABLE_HPP_
@@ -0,0 +1,61 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_LIKWIDBACKEND_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_LIKWIDBACKEND_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "unstickymem/counters/CounterBackend.hpp"
+
+namespace unstickymem {
+
+/**
+ * Counts stalls with LIKWID (Like I Knew What I'm Doing).
+ *
+ * liblikwid is loaded when the backend starts, so the library neither links
+ * against it nor needs it installed. LIKWID reads the MSRs directly: it
+ * usually needs root or its access daemon.
+ */
+class LikwidBackend : public CounterBackend {
+ private:
+  void *_library = nullptr;
+  int _group = -1;
+  std::vector<int> _cpus;
+  std::vector<double> _stalls;  // per node, over the measurement intervals
+
+  // the LIKWID functions we use
+  int (*_topology_init)(void);
+  void (*_topology_finalize)(void);
+  void (*_affinity_init)(void);
+  void (*_affinity_finalize)(void);
+  int (*_perfmon_init)(int, const int*);
+  void (*_perfmon_finalize)(void);
+  int (*_perfmon_addEventSet)(const char*);
+  int (*_perfmon_setupCounters)(int);
+  int (*_perfmon_startCounters)(void);
+  int (*_perfmon_stopCounters)(void);
+  double (*_perfmon_getResult)(int, int, int);
+
+  bool loadLibrary(void);
+
+ public:
+  static std::string name() {
+    return "likwid";
+  }
+  static std::string description() {
+    return "LIKWID (needs MSR access)";
+  }
+  static std::unique_ptr<CounterBackend> createInstance() {
+    return std::make_unique<LikwidBackend>();
+  }
+
+  ~LikwidBackend();
+
+  bool start(const Topology &topology);
+  void stop();
+  std::vector<double> readNodeStalls();
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_LIKWIDBACKEND_HPP_
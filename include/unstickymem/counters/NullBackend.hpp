@@ -0,0 +1,38 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_NULLBACKEND_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_NULLBACKEND_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "unstickymem/counters/CounterBackend.hpp"
+
+namespace unstickymem {
+
+/**
+ * No counters: the stall rate is always zero, so the adaptive modes cannot
+ * tune anything. The last resort when no other backend can start.
+ */
+class NullBackend : public CounterBackend {
+ private:
+  size_t _num_nodes = 0;
+
+ public:
+  static std::string name() {
+    return "none";
+  }
+  static std::string description() {
+    return "No performance counters";
+  }
+  static std::unique_ptr<CounterBackend> createInstance() {
+    return std::make_unique<NullBackend>();
+  }
+
+  bool start(const Topology &topology);
+  void stop();
+  std::vector<double> readNodeStalls();
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_NULLBACKEND_HPP_
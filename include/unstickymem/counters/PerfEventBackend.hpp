@@ -0,0 +1,75 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_PERFEVENTBACKEND_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_PERFEVENTBACKEND_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "unstickymem/counters/CounterBackend.hpp"
+
+namespace unstickymem {
+
+/**
+ * Counts stalls with perf_event_open.
+ *
+ * There is one counter per CPU of the worker nodes. Each follows the process
+ * (every thread created after it is opened, through perf inheritance) while
+ * it runs on that CPU, and only counts user space, which is what an
+ * unprivileged process may do with perf_event_paranoid up to 2. No root, no
+ * msr module.
+ */
+class PerfEventBackend : public CounterBackend {
+ public:
+  struct Event {
+    std::string name;
+    uint32_t type;  // PERF_TYPE_*
+    uint64_t config;
+  };
+
+ private:
+  // a counter on one CPU, and its last reading
+  struct Counter {
+    int cpu;
+    int node;
+    int fd;
+    uint64_t count;
+    uint64_t enabled;
+    uint64_t running;
+    double stalls;  // scaled, since start
+  };
+
+  std::vector<Event> _candidates;  // the first one that opens is used
+  std::vector<Counter> _counters;
+  size_t _num_nodes = 0;
+
+  bool open(const Event &event, const std::vector<int> &cpus);
+  void close(void);
+
+ public:
+  static std::string name() {
+    return "perf";
+  }
+  static std::string description() {
+    return "Linux perf_event_open (no root needed)";
+  }
+  static std::unique_ptr<CounterBackend> createInstance() {
+    return std::make_unique<PerfEventBackend>();
+  }
+
+  // the stall events of this CPU
+  PerfEventBackend();
+  explicit PerfEventBackend(const std::vector<Event> &candidates);
+  ~PerfEventBackend();
+
+  bool start(const Topology &topology);
+  void stop();
+  std::vector<double> readNodeStalls();
+
+  // the stall events of this CPU model, then the generic one
+  static std::vector<Event> stallEvents(void);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_PERFEVENTBACKEND_HPP_
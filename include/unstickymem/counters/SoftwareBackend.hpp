@@ -0,0 +1,74 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_SOFTWAREBACKEND_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_SOFTWAREBACKEND_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "better-enums/enum.h"
+#include "unstickymem/counters/CounterBackend.hpp"
+
+namespace unstickymem {
+
+// where the software backend learns how local the memory accesses are
+BETTER_ENUM(LocalitySource, int,
+            TASK_FAULTS,  // NUMA balancing faults of our threads (sched)
+            NUMASTAT,  // per-node allocations of the whole machine (sysfs)
+            VMSTAT)  // allocations of the whole machine (procfs)
+
+/**
+ * A stall proxy from kernel statistics only, for hosts without hardware
+ * counters (VMs, containers).
+ *
+ * The "stalls" are the CPU time of the process, in TSC cycles, times the
+ * share of its memory accesses that were remote, attributed to the nodes
+ * the remote memory is on. The modes then minimise remote accesses made
+ * while busy. It cannot see bandwidth saturation: a proxy, not a substitute.
+ *
+ * The share of remote accesses comes from the NUMA balancing faults of our
+ * threads if the kernel samples them (kernel.numa_balancing), or else from
+ * which node the allocations were satisfied on. Those allocation statistics
+ * are machine-wide: every other process moves them too. So the backend is
+ * never picked by "auto", only when asked for (UNSTICKYMEM_COUNTERS).
+ */
+class SoftwareBackend : public CounterBackend {
+ private:
+  LocalitySource _source = LocalitySource::VMSTAT;
+  std::vector<int> _memory_nodes;
+  std::vector<double> _stalls;  // per node, since start
+  std::vector<double> _remote_share;  // per node, of the last interval
+  std::vector<double> _prev_accesses;
+  std::vector<double> _prev_remote;
+  double _prev_cpu_ns = 0;
+  double _start_ns = 0;
+  uint64_t _start_tsc = 0;
+  bool _started = false;
+
+  // cumulative accesses and remote accesses per node, from _source
+  bool readAccesses(std::vector<double> *accesses,
+                    std::vector<double> *remote) const;
+
+ public:
+  static std::string name() {
+    return "software";
+  }
+  static std::string description() {
+    return "Kernel NUMA statistics (no hardware counters)";
+  }
+  static std::unique_ptr<CounterBackend> createInstance() {
+    return std::make_unique<SoftwareBackend>();
+  }
+
+  bool start(const Topology &topology);
+  void stop();
+  std::vector<double> readNodeStalls();
+
+  // share of the accesses that were local in the last interval read
+  double locality(void) const;
+  LocalitySource source(void) const;
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_SOFTWAREBACKEND_HPP_
@@ -0,0 +1,51 @@
+#ifndef INCLUDE_UNSTICKYMEM_COUNTERS_THREADCOUNTER_HPP_
+#define INCLUDE_UNSTICKYMEM_COUNTERS_THREADCOUNTER_HPP_
+
+#include <linux/perf_event.h>
+
+#include <vector>
+
+#include "unstickymem/counters/PerfEventBackend.hpp"
+
+namespace unstickymem {
+
+/**
+ * A counter of the calling thread, read from user space.
+ *
+ * The event is mapped (its perf_event_mmap_page) and, while the thread runs,
+ * read with rdpmc plus the offset the kernel keeps in the page: no syscall,
+ * and the counter is never stopped. Events the CPU cannot read this way
+ * (software events, rdpmc disabled in /sys/devices/cpu/rdpmc) are read with
+ * read(2) instead.
+ *
+ * rdpmc only reads the counters of the thread running it, so a counter is
+ * only valid in the thread that opened it.
+ */
+class ThreadCounter {
+ private:
+  int _fd = -1;
+  struct perf_event_mmap_page *_page = nullptr;
+
+ public:
+  // the first of the candidates that can be opened (see isOpen)
+  explicit ThreadCounter(const std::vector<PerfEventBackend::Event> &candidates
+                         = PerfEventBackend::stallEvents());
+  ~ThreadCounter();
+  ThreadCounter(ThreadCounter const&) = delete;
+  void operator=(ThreadCounter const&) = delete;
+
+  bool isOpen(void) const;
+
+  // whether read() gets by without a syscall
+  bool userspaceReads(void) const;
+
+  // events counted since the counter was opened, scaled if multiplexed
+  double read(void) const;
+
+  // the same, always through the read(2) syscall
+  double readSyscall(void) const;
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_COUNTERS_THREADCOUNTER_HPP_
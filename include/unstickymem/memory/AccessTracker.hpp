@@ -0,0 +1,86 @@
+#ifndef INCLUDE_UNSTICKYMEM_MEMORY_ACCESSTRACKER_HPP_
+#define INCLUDE_UNSTICKYMEM_MEMORY_ACCESSTRACKER_HPP_
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include "better-enums/enum.h"
+#include "unstickymem/memory/SegmentTree.hpp"
+
+namespace unstickymem {
+
+// how the access tracker sees which pages were used
+BETTER_ENUM(AccessSource, int,
+            IDLE_PAGES,  // page_idle bitmap: reads and writes (root)
+            SOFT_DIRTY,  // soft-dirty bits of the pagemap: writes only
+            NONE)
+
+/**
+ * Ranks the chunks of the address space by how often their pages are
+ * accessed, so that the placement can move the hottest pages first.
+ *
+ * A sampling window marks the resident pages of every segment as idle (or,
+ * without idle page tracking, clears the soft-dirty bits of the process),
+ * waits, and counts the pages that were accessed since. The counts of all
+ * the windows sampled are added up per chunk.
+ *
+ * Clearing the soft-dirty bits write-protects every page of the process:
+ * the first write to each page after that takes a minor fault. It also
+ * resets the bits for everyone else using them (e.g. CRIU), and only writes
+ * are seen, so chunks that are only read rank as cold. They are only used
+ * if asked for.
+ */
+class AccessTracker {
+ public:
+  static const size_t DEFAULT_CHUNK_SIZE = 2ULL << 20;
+
+ private:
+  AccessSource _source = AccessSource::NONE;
+  size_t _chunk_size;
+  int _pagemap = -1;
+  int _bitmap = -1;
+  std::map<uintptr_t, uint64_t> _heat;  // accessed pages, by chunk start
+
+  bool readPagemap(uintptr_t start, size_t pages,
+                   std::vector<uint64_t> *entries) const;
+  bool clearSoftDirty(void) const;
+  bool probe(AccessSource source);
+
+ public:
+  explicit AccessTracker(size_t chunk_size = DEFAULT_CHUNK_SIZE);
+  ~AccessTracker();
+  AccessTracker(AccessTracker const&) = delete;
+  void operator=(AccessTracker const&) = delete;
+
+  // picks the best source this kernel (and our privileges) allows, the
+  // soft-dirty bits only if `soft_dirty`. false if there is none
+  bool start(bool soft_dirty = false);
+  AccessSource source(void) const;
+  size_t chunkSize(void) const;
+
+  // one window over a region: marks its pages, then counts the ones that
+  // were accessed since. with soft-dirty bits, marking is process-wide
+  void mark(uintptr_t start, size_t length);
+  void collect(uintptr_t start, size_t length);
+
+  // one window of `window` us over every segment the placement handles
+  void sample(const SegmentTree &segments, useconds_t window);
+
+  // counts accesses to the chunk that holds `address` seen by other means
+  void add(uintptr_t address, uint64_t accesses);
+
+  // pages accessed in the chunk that holds `address`, over all windows
+  uint64_t heat(uintptr_t address) const;
+  // false until an accessed page was seen
+  bool hasSamples(void) const;
+  // chunks with accessed pages
+  size_t hotChunks(void) const;
+  void reset(void);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_MEMORY_ACCESSTRACKER_HPP_
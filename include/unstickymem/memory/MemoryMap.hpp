@@ -3,8 +3,10 @@
 
 #include <stdlib.h>
 
+#include <atomic>
 #include <list>
 #include <iterator>
+#include <memory>
 #include <mutex>
 #include <string>
 
@@ -12,6 +14,7 @@
 #include <boost/interprocess/containers/list.hpp>
 
 #include "unstickymem/memory/MemorySegment.hpp"
+#include "unstickymem/memory/SegmentTree.hpp"
 
 namespace unstickymem {
 
@@ -25,15 +28,14 @@ using Alloc = ipc::allocator<T, Manager>;
 template<typename K>
 using List = ipc::list<K, Alloc<K> >;
 
-typedef std::list<MemorySegment> SegmentsList;
-
 class MemoryMap {
  private:
-  SegmentsList *_segments;
-  MemorySegment *_heap = nullptr;
-  MemorySegment *_stack = nullptr;
-  MemorySegment *_text = nullptr;
-  MemorySegment *_data = nullptr;
+  // only modified by allocating threads, while holding _segments_lock
+  SegmentTree _segments;
+  // immutable copy of _segments, republished after every modification
+  std::shared_ptr<const SegmentTree> _snapshot;
+  void *_heap_start = nullptr;
+  std::atomic<void*> _heap_end { nullptr };
   std::mutex _segments_lock;
 
   // FIXME(joaomlneto): this won't work if multiple unstickymem processes
@@ -42,6 +44,8 @@ class MemoryMap {
 
  private:
   MemoryMap();
+  bool inHeap(void *addr) const;
+  void publish(void);
 
  public:
   // singleton
@@ -52,12 +56,16 @@ class MemoryMap {
   void *getHeapStartAddress(void) const;
   void print(void) const;
   void updateHeap(void);
+  size_t size(void) const;
+
+  // consistent view of the segments, never blocked by (nor blocking) writers
+  std::shared_ptr<const SegmentTree> snapshot(void) const;
 
-  // iterators
-  SegmentsList::iterator begin() noexcept;
-  SegmentsList::iterator end() noexcept;
-  SegmentsList::const_iterator cbegin() const noexcept;
-  SegmentsList::const_iterator cend() const noexcept;
+  // iterators (over the snapshot taken when calling begin)
+  SegmentTree::const_iterator begin() const noexcept;
+  SegmentTree::const_iterator end() const noexcept;
+  SegmentTree::const_iterator cbegin() const noexcept;
+  SegmentTree::const_iterator cend() const noexcept;
 
   // handle allocations/deallocations
   void* handle_malloc(size_t size);
@@ -0,0 +1,157 @@
+#ifndef INCLUDE_UNSTICKYMEM_MEMORY_SEGMENTTREE_HPP_
+#define INCLUDE_UNSTICKYMEM_MEMORY_SEGMENTTREE_HPP_
+
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+#include "unstickymem/memory/MemorySegment.hpp"
+
+namespace unstickymem {
+
+/**
+ * Interval index of memory segments.
+ *
+ * An AVL tree ordered by start address where every node also stores the
+ * highest end address found in its subtree. Insertion, removal, stabbing
+ * (which segments contain an address) and overlap queries are O(log n)
+ * (plus the number of segments reported). Iteration is in address order.
+ *
+ * Nodes are immutable and shared: modifications copy the path from the root
+ * to the modified node. Copying a tree is O(1) and the copy is a snapshot
+ * that is not affected by later modifications of the original.
+ */
+class SegmentTree {
+ private:
+  struct Node;
+  using NodePtr = std::shared_ptr<const Node>;
+
+  struct Node {
+    MemorySegment segment;
+    uint64_t id;  // breaks ties between segments with the same start address
+    uintptr_t max_end;
+    int height;
+    NodePtr left;
+    NodePtr right;
+
+    Node(const MemorySegment &s, uint64_t i, NodePtr l, NodePtr r);
+    uintptr_t start() const;
+    uintptr_t end() const;
+  };
+
+  NodePtr _root;
+  size_t _size = 0;
+  uint64_t _next_id = 0;
+
+ public:
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = MemorySegment;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const MemorySegment*;
+    using reference = const MemorySegment&;
+
+    Iterator() = default;
+    // holds on to the root, so the nodes outlive the tree that created them
+    explicit Iterator(NodePtr root)
+        : _root(root) {
+      pushLeftSpine(_root.get());
+    }
+
+    reference operator*() const {
+      return _stack.back()->segment;
+    }
+
+    pointer operator->() const {
+      return &_stack.back()->segment;
+    }
+
+    // unique for each inserted segment (kept when it is resized)
+    uint64_t id() const {
+      return _stack.back()->id;
+    }
+
+    Iterator& operator++() {
+      const Node *node = _stack.back();
+      _stack.pop_back();
+      pushLeftSpine(node->right.get());
+      return *this;
+    }
+
+    Iterator operator++(int) {
+      Iterator previous = *this;
+      ++(*this);
+      return previous;
+    }
+
+    bool operator==(const Iterator &other) const {
+      if (_stack.empty() || other._stack.empty()) {
+        return _stack.empty() && other._stack.empty();
+      }
+      return _stack.back() == other._stack.back();
+    }
+
+    bool operator!=(const Iterator &other) const {
+      return !(*this == other);
+    }
+
+   private:
+    NodePtr _root;
+    std::vector<const Node*> _stack;
+
+    void pushLeftSpine(const Node *node) {
+      for (; node != nullptr; node = node->left.get()) {
+        _stack.push_back(node);
+      }
+    }
+  };
+
+  using iterator = Iterator;
+  using const_iterator = Iterator;
+
+  // iterators (in address order)
+  const_iterator begin() const noexcept;
+  const_iterator end() const noexcept;
+  const_iterator cbegin() const noexcept;
+  const_iterator cend() const noexcept;
+
+  size_t size() const noexcept;
+  bool empty() const noexcept;
+
+  void insert(const MemorySegment &segment);
+
+  // queries (the returned pointer is valid while this tree is not modified)
+  const MemorySegment* find(void *addr) const;
+  std::vector<MemorySegment> containing(void *addr) const;
+  std::vector<MemorySegment> overlapping(void *start, void *end) const;
+
+  // removes (and returns) the segments containing/overlapping the address(es)
+  std::vector<MemorySegment> extract(void *addr);
+  std::vector<MemorySegment> extract(void *start, void *end);
+
+  // moves the end address of the segment starting at `start`
+  bool resize(void *start, void *end);
+
+  void clear();
+
+ private:
+  static int height(const NodePtr &node);
+  static NodePtr make(const MemorySegment &segment, uint64_t id, NodePtr left,
+                      NodePtr right);
+  static NodePtr balance(const MemorySegment &segment, uint64_t id,
+                         NodePtr left, NodePtr right);
+  static NodePtr insert(const NodePtr &root, const MemorySegment &segment,
+                        uint64_t id);
+  static NodePtr removeMin(const NodePtr &root, NodePtr *min);
+  static NodePtr remove(const NodePtr &root, uintptr_t start, uint64_t id);
+  static NodePtr resize(const NodePtr &root, uintptr_t start, uintptr_t end);
+  static void overlapping(const Node *node, uintptr_t start, uintptr_t end,
+                          std::vector<const Node*> *result);
+  std::vector<MemorySegment> extractRange(uintptr_t start, uintptr_t end);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_MEMORY_SEGMENTTREE_HPP_
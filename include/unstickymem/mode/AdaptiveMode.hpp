@@ -9,8 +9,13 @@ class AdaptiveMode : public Mode {
  private:
   unsigned int _wait_start;
   unsigned int _num_polls;
-  unsigned int _num_poll_outliers;
   useconds_t _poll_sleep;
+  double _poll_precision;
+  double _significance;
+  std::string _objective;
+  bool _hot_pages;
+  bool _hot_soft_dirty;
+  useconds_t _hot_window;
  public:
   static std::string name() {
     return "adaptive";
@@ -28,6 +33,9 @@ class AdaptiveMode : public Mode {
   void printParameters();
   void adaptiveThread();
   void start();
+  bool usesWeights() {
+    return false;
+  }
 };
 
 }  // namespace unstickymem
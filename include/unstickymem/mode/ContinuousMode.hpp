@@ -0,0 +1,64 @@
+#ifndef INCLUDE_UNSTICKYMEM_MODE_CONTINUOUSMODE_HPP_
+#define INCLUDE_UNSTICKYMEM_MODE_CONTINUOUSMODE_HPP_
+
+#include <atomic>
+#include <string>
+
+#include "unstickymem/mode/SearchMode.hpp"
+
+namespace unstickymem {
+
+/**
+ * The search mode, but it never stops: once tuned, it keeps sampling the
+ * stall rate (one sample per period) and, when the Page-Hinkley test says
+ * the workload changed phase, searches again around the last optimum.
+ *
+ * To avoid thrashing, it waits a while after each search before watching
+ * again, and only moves to a new ratio if it is better than the current one
+ * by more than the measurement precision.
+ *
+ * Moving to the tuned ratio can be done at once (fast convergence) or in the
+ * background, within UNSTICKYMEM_MIGRATION_BW (low interference): then the
+ * phase changes are only watched once the pages are in place.
+ */
+class ContinuousMode : public SearchMode {
+ protected:
+  useconds_t _monitor_period;
+  double _change_drift;
+  double _change_threshold;
+  unsigned int _holdoff;
+  std::atomic<double> _ratio { 0 };  // the share it is tuned to
+  std::atomic<bool> _stopping { false };
+
+  // samples until the background migrations are done
+  void waitForMigrations(void);
+  // samples until the stall rate moves away from `baseline` (false once the
+  // mode is stopped)
+  virtual bool waitForPhaseChange(double baseline);
+
+ public:
+  static std::string name() {
+    return "continuous";
+  }
+
+  static std::string description() {
+    return "Search, then re-tune whenever the workload changes phase";
+  }
+
+  static std::unique_ptr<Mode> createInstance() {
+    return std::make_unique<ContinuousMode>();
+  }
+
+  // the share it is tuned to (0 until the first search is done)
+  double tunedRatio(void) const;
+
+  po::options_description getOptions();
+  void printParameters();
+  void tuningThread();
+  void start();
+  void stop();
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_MODE_CONTINUOUSMODE_HPP_
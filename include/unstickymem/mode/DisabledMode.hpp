@@ -23,6 +23,9 @@ class DisabledMode : public Mode {
   void printParameters();
 
   void start();
+  bool usesWeights() {
+    return false;
+  }
 };
 
 }  // namespace unstickymem
@@ -31,6 +31,9 @@ class FixedRatioMode : public Mode {
   void printParameters();
   void pollerThread();
   void start();
+  bool usesWeights() {
+    return false;
+  }
   void processSegmentAddition(const MemorySegment& segment);
 };
 
@@ -8,6 +8,7 @@
 #include <boost/program_options.hpp>
 
 #include "unstickymem/memory/MemorySegment.hpp"
+#include "unstickymem/Profile.hpp"
 #include "unstickymem/Logger.hpp"
 #include "unstickymem/wrap.hpp"
 
@@ -30,10 +31,31 @@ class Mode {
   virtual void printParameters() = 0;
   virtual void start() = 0;
 
+  // whether the mode places pages by the node weights (only then are they
+  // calibrated at startup)
+  virtual bool usesWeights() {
+    return true;
+  }
+
+  // called before start() with the result of a previous run: the mode should
+  // start there, and keep tuning only if `refine`. false if it cannot
+  virtual bool warmStart(const Profile &profile, bool refine) {
+    return false;
+  }
+
+  // asks the threads of the mode to finish (at exit)
+  virtual void stop() {
+  }
+
   virtual void processSegmentAddition(const MemorySegment& segment) {
   }
   virtual void processSegmentRemoval(const MemorySegment& segment) {
   }
+  // the application entered/left a phase (see unstickymem_phase_begin())
+  virtual void processPhaseBegin(const std::string &phase) {
+  }
+  virtual void processPhaseEnd() {
+  }
 
   static void registerMode(std::string const & name, Description desc) {
     // disallow replacing entries
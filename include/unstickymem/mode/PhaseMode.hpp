@@ -0,0 +1,72 @@
+#ifndef INCLUDE_UNSTICKYMEM_MODE_PHASEMODE_HPP_
+#define INCLUDE_UNSTICKYMEM_MODE_PHASEMODE_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "unstickymem/mode/SearchMode.hpp"
+
+namespace unstickymem {
+
+/**
+ * The search mode, once per phase of the application (as marked with
+ * unstickymem_phase_begin() and unstickymem_phase_end()).
+ *
+ * The first time a phase runs, its share is searched for; after that, it is
+ * put back as soon as the phase begins again. Going back only migrates the
+ * pages whose node changes (see PlacementEngine). All the placement is done
+ * by the tuning thread: marking a phase never blocks the application.
+ *
+ * A phase that ends before its search does keeps the measurements made, and
+ * the search goes on from there the next time it runs. Meanwhile, the pages
+ * go back to the share of the phase running then, or to the initial weights.
+ */
+class PhaseMode : public SearchMode {
+ private:
+  std::mutex _lock;
+  std::condition_variable _phase_changed;
+  std::string _phase;                    // "" outside of any phase
+  std::atomic<uint64_t> _epoch { 0 };    // phase changes so far
+  uint64_t _tuning_epoch = 0;            // the phase change last handled
+  std::map<std::string, double> _ratios;  // of the phases tuned
+  // the measurements of each phase (only used by the tuning thread)
+  std::map<std::string, std::map<double, double>> _evaluations;
+
+  // searches the share of the phase. false if it changed meanwhile
+  bool tunePhase(const std::string &phase);
+
+ protected:
+  // true if the phase changed since the current search began
+  bool interrupted(void) const;
+  double evaluate(double share);
+
+ public:
+  static std::string name() {
+    return "phases";
+  }
+
+  static std::string description() {
+    return "Search mode, separately for each phase of the application";
+  }
+
+  static std::unique_ptr<Mode> createInstance() {
+    return std::make_unique<PhaseMode>();
+  }
+
+  // the share the phase was tuned to, if it was
+  bool tunedRatio(const std::string &phase, double *ratio);
+
+  bool warmStart(const Profile &profile, bool refine);
+  void tuningThread();
+  void start();
+  void processPhaseBegin(const std::string &phase);
+  void processPhaseEnd();
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_MODE_PHASEMODE_HPP_
@@ -0,0 +1,69 @@
+#ifndef INCLUDE_UNSTICKYMEM_MODE_SEARCHMODE_HPP_
+#define INCLUDE_UNSTICKYMEM_MODE_SEARCHMODE_HPP_
+
+#include <map>
+#include <string>
+
+#include "unstickymem/mode/Mode.hpp"
+
+namespace unstickymem {
+
+/**
+ * Weighted interleaving, tuned by a golden-section search over the share of
+ * pages moved from the non-worker to the worker nodes: it goes back and
+ * forth instead of walking the shares in order, and ends on the best one
+ * it measured.
+ */
+class SearchMode : public Mode {
+ protected:
+  bool _started = false;
+  unsigned int _wait_start;
+  unsigned int _num_polls;
+  useconds_t _poll_sleep;
+  double _poll_precision;
+  double _tolerance;
+  double _window;
+  bool _warm_start = false;
+  bool _refine = true;
+  double _initial_ratio = 0;  // from the profile
+  bool _background_migration = false;  // move to the best share gradually
+
+  // the largest share: all the weight of the non-worker nodes
+  virtual double maxShare(void);
+  // whether the measurements under way are worthless (stops them)
+  virtual bool interrupted(void) const {
+    return false;
+  }
+  // moves the pages and measures the stall rate there
+  virtual double evaluate(double share);
+  // the best share in [lo, hi] (or in `evaluations`), left in place (or
+  // queued, when migrating in the background), and its stall rate
+  double search(double lo, double hi, std::map<double, double> *evaluations,
+                double *stall_rate = nullptr);
+  // the first search: over all the shares, or near the profile's
+  double tune();
+
+ public:
+  static std::string name() {
+    return "search";
+  }
+
+  static std::string description() {
+    return "Golden-section search with weighted interleaving";
+  }
+
+  static std::unique_ptr<Mode> createInstance() {
+    return std::make_unique<SearchMode>();
+  }
+
+  po::options_description getOptions();
+  void printParameters();
+  bool warmStart(const Profile &profile, bool refine);
+  void searchThread();
+  void start();
+  void processSegmentAddition(const MemorySegment& segment);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_MODE_SEARCHMODE_HPP_
@@ -0,0 +1,44 @@
+#ifndef INCLUDE_UNSTICKYMEM_MODE_USERFAULTMODE_HPP_
+#define INCLUDE_UNSTICKYMEM_MODE_USERFAULTMODE_HPP_
+
+#include <string>
+
+#include "unstickymem/mode/SearchMode.hpp"
+
+namespace unstickymem {
+
+/**
+ * The search mode, with the pages of new anonymous mappings placed exactly
+ * (page by page, by the initial weights) as they are first touched, with
+ * userfaultfd (see UserfaultHandler), instead of by a memory policy.
+ *
+ * Mappings that cannot be registered, and those that existed before the
+ * mode started, are placed as in the search mode. The registered mappings
+ * are handed back to the kernel when the search starts moving pages: from
+ * then on, their new pages follow the policies the search gives them.
+ */
+class UserfaultMode : public SearchMode {
+ protected:
+  double evaluate(double share);
+
+ public:
+  static std::string name() {
+    return "userfault";
+  }
+
+  static std::string description() {
+    return "Search mode, placing new mappings on first touch (userfaultfd)";
+  }
+
+  static std::unique_ptr<Mode> createInstance() {
+    return std::make_unique<UserfaultMode>();
+  }
+
+  void start();
+  void processSegmentAddition(const MemorySegment& segment);
+  void processSegmentRemoval(const MemorySegment& segment);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_MODE_USERFAULTMODE_HPP_
@@ -12,8 +12,13 @@ class WeightedAdaptiveMode : public Mode {
   bool _started = false;
   unsigned int _wait_start;
   unsigned int _num_polls;
-  unsigned int _num_poll_outliers;
   useconds_t _poll_sleep;
+  double _poll_precision;
+  double _significance;
+  std::string _objective;
+  bool _warm_start = false;
+  bool _refine = true;
+  int _initial_ratio = 0;  // from the profile
  public:
   static std::string name() {
     return "wadaptive";
@@ -29,6 +34,7 @@ class WeightedAdaptiveMode : public Mode {
 
   po::options_description getOptions();
   void printParameters();
+  bool warmStart(const Profile &profile, bool refine);
   void adaptiveThread();
   void start();
   void processSegmentAddition(const MemorySegment& segment);
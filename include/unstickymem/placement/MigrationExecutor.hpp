@@ -0,0 +1,112 @@
+#ifndef INCLUDE_UNSTICKYMEM_PLACEMENT_MIGRATIONEXECUTOR_HPP_
+#define INCLUDE_UNSTICKYMEM_PLACEMENT_MIGRATIONEXECUTOR_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "unstickymem/placement/PlacementPlan.hpp"
+#include "unstickymem/placement/TokenBucket.hpp"
+
+namespace unstickymem {
+
+/**
+ * Pool of threads applying placement plans in parallel.
+ *
+ * Plans are split into chunks, queued on the worker pinned to the node the
+ * pages go to, and workers that run out of chunks steal from the others.
+ * MPOL_LOCAL chunks are tagged with the node of the thread that submitted
+ * them, since that is the node the pages are moved to; a worker of another
+ * node moves there to run them.
+ *
+ * Migrations can be capped to a bandwidth (of resident pages moved) so they
+ * do not disturb the application (and the stall rate measurements) too
+ * much. Plans can then be submitted in the background and their progress
+ * followed with pendingBytes().
+ */
+class MigrationExecutor {
+ public:
+  // largest range handled by a single mbind call
+  static constexpr size_t CHUNK_LENGTH = 16ULL << 20;
+
+  struct Statistics {
+    size_t bytes = 0;
+    size_t chunks = 0;
+    size_t steals = 0;
+    size_t syscalls = 0;
+    double seconds = 0;
+
+    double pagesPerSecond(void) const;
+  };
+
+ private:
+  struct Task {
+    PlacementRange range;
+    unsigned flags;
+    int node;  // node to run on (-1 for any)
+    MigrationBackend backend = MigrationBackend::MBIND;
+  };
+
+  struct Worker {
+    int node;
+    std::mutex lock;
+    std::deque<Task> tasks;
+    std::thread thread;
+  };
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::mutex _lock;
+  std::condition_variable _work_available;
+  std::condition_variable _work_done;
+  size_t _pending = 0;
+  std::atomic<size_t> _pending_bytes { 0 };
+  uint64_t _generation = 0;  // number of plans queued so far
+  std::chrono::steady_clock::time_point _batch_start;
+  Statistics _batch;
+  Statistics _last;
+  TokenBucket _bandwidth;
+
+ private:
+  MigrationExecutor();
+  void startWorkers(void);
+  void work(Worker *worker);
+  bool next(Worker *worker, int node, Task *task);
+  void execute(const Task &task, int node, bool stolen);
+  size_t chunkLength(void);
+
+ public:
+  // singleton
+  static MigrationExecutor& getInstance(void);
+  MigrationExecutor(MigrationExecutor const&) = delete;
+  void operator=(MigrationExecutor const&) = delete;
+
+  // queues the ranges of the plan to be applied in the background
+  void submit(const PlacementPlan &plan, unsigned flags,
+              MigrationBackend backend = MigrationBackend::MBIND);
+  // waits until all submitted plans are done. the calling thread helps with
+  // the chunks it can run on its current node
+  Statistics wait(void);
+  // submit and wait
+  Statistics run(const PlacementPlan &plan, unsigned flags,
+                 MigrationBackend backend = MigrationBackend::MBIND);
+
+  // bytes submitted but not migrated yet
+  size_t pendingBytes(void) const;
+
+  // migration bandwidth cap in bytes per second (0 for unlimited)
+  size_t getBandwidth(void);
+  void setBandwidth(size_t bytes_per_second);
+
+  size_t numWorkers(void) const;
+  Statistics lastRun(void) const;
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_PLACEMENT_MIGRATIONEXECUTOR_HPP_
@@ -0,0 +1,64 @@
+#ifndef INCLUDE_UNSTICKYMEM_PLACEMENT_PLACEMENTENGINE_HPP_
+#define INCLUDE_UNSTICKYMEM_PLACEMENT_PLACEMENTENGINE_HPP_
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+
+#include "unstickymem/memory/SegmentTree.hpp"
+#include "unstickymem/placement/PlacementPlan.hpp"
+
+namespace unstickymem {
+
+/**
+ * Applies placement plans incrementally.
+ *
+ * Remembers the layout each segment was left with by the previous pass and
+ * only mbinds the ranges whose policy changes, so moving between two close
+ * ratios migrates the pages in between instead of the whole segment.
+ */
+class PlacementEngine {
+ public:
+  // builds the layout a (page-aligned) region should have
+  using Planner = std::function<PlacementPlan(void *addr, unsigned long len)>;
+
+  // segments smaller than this are left alone
+  static const size_t MIN_SEGMENT_LENGTH = 1ULL << 20;
+
+ private:
+  // layout of each segment after the last pass, keyed by segment id
+  std::map<uint64_t, PlacementPlan> _layouts;
+  size_t _bytes_planned = 0;
+  size_t _bytes_moved = 0;
+  std::mutex _lock;
+
+ private:
+  PlacementEngine() = default;
+
+ public:
+  // singleton
+  static PlacementEngine& getInstance(void);
+  PlacementEngine(PlacementEngine const&) = delete;
+  void operator=(PlacementEngine const&) = delete;
+
+  // lays out every segment according to `target`. segments that were not
+  // placed by a previous pass are assumed to follow `initial` (if given).
+  // in the background, the migrations are only queued (see
+  // MigrationExecutor::pendingBytes)
+  void placeAll(const SegmentTree &segments, const Planner &target,
+                const Planner &initial = nullptr,
+                MigrationBackend backend = MigrationBackend::MBIND,
+                bool background = false);
+
+  // forget all layouts: the next pass moves everything again
+  void reset(void);
+
+  // statistics of the last pass (bytes queued, in the background)
+  size_t bytesPlanned(void) const;
+  size_t bytesMoved(void) const;
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_PLACEMENT_PLACEMENTENGINE_HPP_
@@ -0,0 +1,117 @@
+#ifndef INCLUDE_UNSTICKYMEM_PLACEMENT_PLACEMENTPLAN_HPP_
+#define INCLUDE_UNSTICKYMEM_PLACEMENT_PLACEMENTPLAN_HPP_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "better-enums/enum.h"
+
+#include "unstickymem/Topology.hpp"
+
+namespace unstickymem {
+
+class AccessTracker;
+
+/**
+ * How plans are applied:
+ *  - MBIND sets the policy of the ranges and moves their pages (the kernel
+ *    splits the mappings at every range boundary)
+ *  - MOVE_PAGES moves each resident page to its node in large batches,
+ *    leaving the policies (and the mappings) untouched
+ */
+BETTER_ENUM(MigrationBackend, int, MBIND, MOVE_PAGES)
+
+// nodes that fit in a nodemask
+static const int MAX_PLAN_NODES = sizeof(unsigned long) * 8;
+
+/**
+ * A page range and the memory policy it should have.
+ * `nodemask` is ignored for MPOL_LOCAL, `weights` are only used (and
+ * compared) by MPOL_WEIGHTED_INTERLEAVE.
+ */
+struct PlacementRange {
+  uintptr_t start;
+  size_t length;
+  int mode;
+  unsigned long nodemask;
+  std::array<uint8_t, MAX_PLAN_NODES> weights {};
+
+  uintptr_t end() const {
+    return start + length;
+  }
+
+  bool samePolicyAs(const PlacementRange &other) const;
+};
+
+/**
+ * A layout for a memory region: sorted, non-overlapping, page-aligned ranges.
+ */
+typedef std::vector<PlacementRange> PlacementPlan;
+
+// all pages interleaved through all the memory nodes (the process default)
+PlacementPlan plan_interleave_all(const Topology &topology, void *addr,
+                                  unsigned long len);
+
+// a fraction of the pages in the local node, the rest interleaved (see
+// plan_local_bytes)
+PlacementPlan plan_local_ratio(const Topology &topology, void *addr,
+                               unsigned long len, double ratio,
+                               const AccessTracker *tracker = nullptr);
+
+// `local_len` bytes of the region in the local node, the rest interleaved.
+// the local pages are the hottest chunks of the region by `tracker`, or the
+// tail of the region without one (or without samples)
+PlacementPlan plan_local_bytes(const Topology &topology, void *addr,
+                               unsigned long len, unsigned long local_len,
+                               const AccessTracker *tracker = nullptr);
+
+// pages interleaved proportionally to the node weights (in %, by node id),
+// natively if the kernel supports it and the weights agree with the ones
+// the process already set, slicing the region otherwise
+PlacementPlan plan_weighted(const Topology &topology, void *addr,
+                            unsigned long len,
+                            const std::vector<double> &weights);
+
+// consecutive slices, each interleaved over the nodes with weight left
+PlacementPlan plan_weighted_slices(const Topology &topology, void *addr,
+                                   unsigned long len,
+                                   const std::vector<double> &weights);
+
+// a single MPOL_WEIGHTED_INTERLEAVE range
+PlacementPlan plan_weighted_interleave(const Topology &topology, void *addr,
+                                       unsigned long len,
+                                       const std::vector<double> &weights);
+
+// the ranges of `to` whose policy differs from the one they have in `from`
+PlacementPlan plan_difference(const PlacementPlan &from,
+                              const PlacementPlan &to);
+
+// total number of bytes covered by the plan
+size_t plan_length(const PlacementPlan &plan);
+
+// the parts of the plan whose pages are resident (see mincore(2))
+PlacementPlan plan_resident(const PlacementPlan &plan);
+
+// mbind every range of the plan
+void apply_plan(const PlacementPlan &plan, unsigned flags);
+
+// sets the policy of every range without migrating anything, so pages that
+// are faulted in later are born on their node, then moves the pages that
+// are already resident. returns the number of bytes moved
+size_t apply_plan_lazily(const PlacementPlan &plan);
+
+// the node the policy of `range` gives `page` (MPOL_LOCAL: `local_node`),
+// or -1 if it has none
+int plan_page_node(const PlacementRange &range, uintptr_t page,
+                   int local_node);
+
+// move every resident page of the plan to the node its policy gives it.
+// MPOL_LOCAL pages go to `local_node` (and are left alone if it is -1).
+// returns the number of syscalls made
+size_t move_plan_pages(const PlacementPlan &plan, unsigned flags,
+                       int local_node);
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_PLACEMENT_PLACEMENTPLAN_HPP_
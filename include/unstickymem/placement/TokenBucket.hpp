@@ -0,0 +1,38 @@
+#ifndef INCLUDE_UNSTICKYMEM_PLACEMENT_TOKENBUCKET_HPP_
+#define INCLUDE_UNSTICKYMEM_PLACEMENT_TOKENBUCKET_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+namespace unstickymem {
+
+/**
+ * Limits the rate (in bytes per second) at which pages are migrated.
+ *
+ * Tokens accumulate at the configured rate, up to a tenth of a second worth
+ * of them. Acquiring more than available puts the bucket in debt and blocks
+ * the caller until it is paid back, so chunks of any size are paced.
+ */
+class TokenBucket {
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  std::mutex _lock;
+  size_t _rate;  // 0 for unlimited
+  double _tokens = 0;
+  Clock::time_point _last = Clock::now();
+
+ public:
+  explicit TokenBucket(size_t rate = 0);
+
+  size_t getRate(void);
+  void setRate(size_t bytes_per_second);
+
+  // blocks until `bytes` can be transferred without exceeding the rate
+  void acquire(size_t bytes);
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_PLACEMENT_TOKENBUCKET_HPP_
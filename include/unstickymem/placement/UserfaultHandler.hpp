@@ -0,0 +1,81 @@
+#ifndef INCLUDE_UNSTICKYMEM_PLACEMENT_USERFAULTHANDLER_HPP_
+#define INCLUDE_UNSTICKYMEM_PLACEMENT_USERFAULTHANDLER_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "unstickymem/placement/PlacementPlan.hpp"
+
+namespace unstickymem {
+
+/**
+ * Places the pages of anonymous regions exactly where a plan says, as they
+ * are first touched, with userfaultfd.
+ *
+ * Registered regions have no memory policy of their own. When a missing
+ * page is touched, the handler thread binds itself to the node the plan
+ * gives the page and fills it with UFFDIO_COPY (from a zero page). The
+ * kernel allocates the new page under the policy of the thread doing the
+ * copy, so the page is born on its node. Faults in the kernel (e.g. a read()
+ * into the region) are resolved the same way.
+ *
+ * A region that is given a memory policy (mbind) while registered has its
+ * pages allocated under that policy instead: the plan no longer applies.
+ *
+ * The handler thread must never wait for the faulting threads: it does not
+ * allocate, log or take any lock but its own while resolving faults.
+ */
+class UserfaultHandler {
+ public:
+  struct Statistics {
+    uint64_t faults = 0;
+    uint64_t misplaced = 0;  // outside of any registered plan
+    double seconds = 0;      // spent resolving them
+
+    double faultsPerSecond(void) const;
+  };
+
+ private:
+  int _fd = -1;
+  void *_zero_page = nullptr;
+  int _bound_node = -1;  // the policy of the handler thread
+  std::mutex _lock;
+  std::map<uintptr_t, PlacementPlan> _plans;  // by start address
+  std::atomic<uint64_t> _faults { 0 };
+  std::atomic<uint64_t> _misplaced { 0 };
+  std::atomic<uint64_t> _nanoseconds { 0 };
+
+ private:
+  UserfaultHandler() = default;
+  void handleFaults(void);
+  void resolve(uintptr_t address);
+  int pageNode(uintptr_t page);
+
+ public:
+  // singleton
+  static UserfaultHandler& getInstance(void);
+  UserfaultHandler(UserfaultHandler const&) = delete;
+  void operator=(UserfaultHandler const&) = delete;
+
+  // opens the userfaultfd and starts the handler thread. false if the
+  // kernel does not let us handle all the faults (that takes privileges)
+  bool start(void);
+  bool isRunning(void) const;
+
+  // registers the (page-aligned, anonymous) region covered by the plan.
+  // false if it cannot be registered (e.g. it is file-backed)
+  bool registerPlan(const PlacementPlan &plan);
+  // forgets the plans for the pages in [start, start + length)
+  void unregister(uintptr_t start, size_t length);
+  // hands all the registered regions back to the kernel
+  void unregisterAll(void);
+
+  Statistics statistics(void) const;
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_PLACEMENT_USERFAULTHANDLER_HPP_
@@ -0,0 +1,52 @@
+#ifndef INCLUDE_UNSTICKYMEM_PLACEMENT_WEIGHTEDINTERLEAVE_HPP_
+#define INCLUDE_UNSTICKYMEM_PLACEMENT_WEIGHTEDINTERLEAVE_HPP_
+
+#include <cstdint>
+
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/placement/PlacementPlan.hpp"
+
+// available since Linux 6.9
+#ifndef MPOL_WEIGHTED_INTERLEAVE
+#define MPOL_WEIGHTED_INTERLEAVE 6
+#endif
+
+namespace unstickymem {
+
+/**
+ * Native weighted interleaving (MPOL_WEIGHTED_INTERLEAVE).
+ *
+ * The per-node weights are system-wide, in
+ * /sys/kernel/mm/mempolicy/weighted_interleave/node<N>, and the kernel reads
+ * them at fault time: changing them affects every process using
+ * MPOL_WEIGHTED_INTERLEAVE on the machine, and every range placed before.
+ * So they are only written if allowed (UNSTICKYMEM_NATIVE_WEIGHTS, needs
+ * root), once per node: the process keeps the first weights it sets, and
+ * plans with other weights slice their regions instead. The weights that
+ * were changed are restored at exit, unless someone changed them since.
+ */
+
+// lets the weights be written (off by default: nothing is native then).
+// probes again the next time it is asked
+void weighted_interleave_allow_writes(bool allowed);
+
+// whether the kernel has weighted interleave and we may set its weights
+// (probed once, without writing). false after a failed update
+bool weighted_interleave_supported(const Topology &topology);
+
+// whether a range with these weights can use the weights the process set
+bool weighted_interleave_compatible(const uint8_t weights[],
+                                    unsigned long nodemask);
+
+// makes the kernel weights of the nodes in `nodemask` match `weights`. false
+// if they cannot be set, or differ from the ones already set: plans then
+// fall back to slices of plain interleaving
+bool weighted_interleave_program(const uint8_t weights[],
+                                 unsigned long nodemask);
+
+// node that the kernel gives to `page` in a weighted interleaved range
+int weighted_interleave_node(const PlacementRange &range, uintptr_t page);
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_PLACEMENT_WEIGHTEDINTERLEAVE_HPP_
@@ -0,0 +1,42 @@
+#ifndef INCLUDE_UNSTICKYMEM_STATS_CHANGEDETECTOR_HPP_
+#define INCLUDE_UNSTICKYMEM_STATS_CHANGEDETECTOR_HPP_
+
+#include <cstddef>
+
+namespace unstickymem {
+
+/**
+ * Page-Hinkley test: detects a lasting shift of the mean of a signal, up or
+ * down.
+ *
+ * It accumulates the deviations of each sample from the mean so far, minus
+ * a tolerated `drift`, and signals a change when the accumulated deviation
+ * has grown by more than `threshold` since its lowest point (or fallen by
+ * more than `threshold` since its highest, for a downward shift). A single
+ * outlier adds one deviation only; a shift adds one per sample.
+ */
+class PageHinkley {
+ private:
+  double _drift;
+  double _threshold;
+  size_t _count = 0;
+  double _mean = 0;
+  double _up = 0;  // accumulated deviations, above the mean
+  double _min_up = 0;
+  double _down = 0;  // and below it
+  double _max_down = 0;
+
+ public:
+  PageHinkley(double drift, double threshold);
+
+  // true if the mean has changed
+  bool add(double x);
+  void reset(void);
+
+  size_t count(void) const;
+  double mean(void) const;  // since the last reset
+};
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_STATS_CHANGEDETECTOR_HPP_
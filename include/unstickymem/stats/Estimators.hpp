@@ -0,0 +1,121 @@
+#ifndef INCLUDE_UNSTICKYMEM_STATS_ESTIMATORS_HPP_
+#define INCLUDE_UNSTICKYMEM_STATS_ESTIMATORS_HPP_
+
+#include <unistd.h>
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace unstickymem {
+
+/**
+ * Online estimators for noisy measurements (the stall rate): constant
+ * memory, one update per sample, so a caller can stop sampling as soon as
+ * the estimate is good enough.
+ */
+
+// mean and variance of all the samples so far (Welford)
+class RunningStats {
+ private:
+  size_t _count = 0;
+  double _mean = 0;
+  double _m2 = 0;  // sum of squared differences from the mean
+
+ public:
+  void add(double x);
+  void clear(void);
+
+  size_t count(void) const;
+  double mean(void) const;
+  double variance(void) const;  // of the samples (n - 1)
+  double stddev(void) const;
+
+  // half-width of the confidence interval of the mean (Student's t)
+  double halfWidth(double confidence = 0.95) const;
+};
+
+// exponentially weighted mean and variance: recent samples weigh more
+class Ewma {
+ private:
+  double _alpha;
+  double _mean = 0;
+  double _variance = 0;
+  bool _empty = true;
+
+ public:
+  // alpha: weight of each new sample, in (0, 1]
+  explicit Ewma(double alpha);
+
+  void add(double x);
+  void clear(void);
+
+  bool empty(void) const;
+  double mean(void) const;
+  double variance(void) const;
+};
+
+// robust statistics of the last `size` samples
+class WindowedStats {
+ private:
+  std::vector<double> _samples;  // ring buffer
+  size_t _next = 0;
+  size_t _count = 0;
+
+  std::vector<double> sorted(void) const;
+
+ public:
+  explicit WindowedStats(size_t size);
+
+  void add(double x);
+  void clear(void);
+
+  size_t count(void) const;
+  bool full(void) const;
+  double mean(void) const;
+  double median(void) const;
+  // median absolute deviation, scaled to estimate the standard deviation
+  double mad(void) const;
+  // mean without the `fraction` lowest and highest samples
+  double trimmedMean(double fraction) const;
+};
+
+// the result of sampling until precise enough
+struct Estimate {
+  double mean;
+  double half_width;  // of the confidence interval of the mean
+  size_t samples;  // kept
+  size_t outliers;  // discarded
+  double seconds;  // spent sampling
+  bool converged;  // precise enough before the budget ran out
+  RunningStats stats;  // of the samples kept, to compare with others
+};
+
+/**
+ * Samples every `period` until the half-width of the confidence interval of
+ * the mean is at most `relative_precision` of the mean (after at least
+ * `min_samples`), or until `budget` seconds have passed.
+ *
+ * Samples further than `OUTLIER_MADS` MADs from the median of the recent
+ * ones are discarded as outliers.
+ */
+static const double OUTLIER_MADS = 5.0;
+static const size_t OUTLIER_WINDOW = 16;
+
+Estimate estimate(const std::function<double()> &sample, useconds_t period,
+                  double relative_precision, double budget,
+                  size_t min_samples = 5, double confidence = 0.95);
+
+// the same, stopping when `done` holds for the samples kept so far
+Estimate sample_until(const std::function<double()> &sample,
+                      useconds_t period, double budget, size_t min_samples,
+                      const std::function<bool(const RunningStats&)> &done,
+                      double confidence = 0.95);
+
+// quantiles of the standard normal and of Student's t distributions
+double normal_quantile(double p);
+double student_t_quantile(double p, double degrees_of_freedom);
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_STATS_ESTIMATORS_HPP_
@@ -0,0 +1,50 @@
+#ifndef INCLUDE_UNSTICKYMEM_STATS_HYPOTHESISTEST_HPP_
+#define INCLUDE_UNSTICKYMEM_STATS_HYPOTHESISTEST_HPP_
+
+#include <unistd.h>
+
+#include <functional>
+
+#include "better-enums/enum.h"
+#include "unstickymem/stats/Estimators.hpp"
+
+namespace unstickymem {
+
+/**
+ * Whether a candidate (placement) has a lower stall rate than a reference,
+ * decided while the candidate is still being sampled.
+ *
+ * Lower is better. SAME means the difference is significantly within the
+ * equivalence margin; INCONCLUSIVE that the samples ran out first.
+ */
+BETTER_ENUM(Verdict, int, BETTER, WORSE, SAME, INCONCLUSIVE)
+
+// Welch's t-test (unequal variances), two-sided at significance `alpha`,
+// with SAME if the (1 - alpha) interval of the difference of the means is
+// within +-`equivalence` of the reference mean
+Verdict welch_test(const RunningStats &candidate,
+                   const RunningStats &reference, double alpha,
+                   double equivalence);
+
+struct Comparison {
+  Verdict verdict;
+  Estimate candidate;
+};
+
+/**
+ * Samples the candidate (like estimate()) and tests it against `reference`
+ * after every sample, stopping as soon as the verdict is not INCONCLUSIVE
+ * or after `budget` seconds.
+ *
+ * Testing after every sample would find differences that are not there, so
+ * each test is made at alpha divided by the number of tests the budget
+ * allows (Bonferroni): the whole comparison is wrong with probability at
+ * most `alpha`.
+ */
+Comparison compare(const std::function<double()> &sample, useconds_t period,
+                   const RunningStats &reference, double alpha,
+                   double equivalence, double budget, size_t min_samples = 5);
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_STATS_HYPOTHESISTEST_HPP_
@@ -0,0 +1,27 @@
+#ifndef INCLUDE_UNSTICKYMEM_STATS_SEARCH_HPP_
+#define INCLUDE_UNSTICKYMEM_STATS_SEARCH_HPP_
+
+#include <functional>
+#include <map>
+
+namespace unstickymem {
+
+// 1/phi: each golden-section step keeps this fraction of the bracket
+static const double GOLDEN_RATIO_CONJUGATE = 0.6180339887498949;
+
+/**
+ * Minimises `f` over [lo, hi] by golden-section search: the bracket shrinks
+ * by 1/phi per evaluation, so it takes log(width/tolerance)/log(phi)
+ * evaluations. `f` is assumed unimodal (one minimum); noisy or not, the
+ * result is the best x evaluated, not the middle of the final bracket.
+ *
+ * `evaluations` (optional) gets every x evaluated and f(x); points already
+ * in it are not evaluated again.
+ */
+double golden_section_search(const std::function<double(double)> &f,
+                             double lo, double hi, double tolerance,
+                             std::map<double, double> *evaluations = nullptr);
+
+}  // namespace unstickymem
+
+#endif  // INCLUDE_UNSTICKYMEM_STATS_SEARCH_HPP_
@@ -1,39 +1,32 @@
 #ifndef UNSTICKYMEM_H_
 #define UNSTICKYMEM_H_
 
+#include <stdint.h>
 #include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// the number of worker nodes
-extern int OPT_NUM_WORKERS_VALUE;
-// Maximum number of nodes in the system
-#define MAX_NODES 8
-// A structure to hold the nodes information
-typedef struct rec {
-  int id;
-  float weight;
-  int count;
-} RECORD;
-
-// hold the nodes information ids and weights
-extern RECORD nodes_info[MAX_NODES];
-// sum of worker nodes weights
-extern double sum_ww;
-// sum of non-worker nodes weights
-extern double sum_nww;
 // The adaptation step
 // TODO: Make this a command line parameter!
 #define ADAPTATION_STEP 10  // E.g. Move 10% of shared pages to the worker nodes
 
-int check_sum(RECORD nodes_info[MAX_NODES]);
 void unstickymem_nop(void);
 void unstickymem_start(void);
 void unstickymem_print_memory(void);
-void read_weights(char filename[]);
-void get_sum_nww_ww(int num_workers);
+
+// progress of the application, for UNSTICKYMEM_OBJECTIVE=progress: report
+// the operations (requests, items, ...) done by the calling thread, or the
+// end of an iteration of the main loop. cheap enough to call per operation
+void unstickymem_report_progress(uint64_t ops);
+void unstickymem_iteration_done(void);
+
+// phases of the application that want different placements (e.g. loading
+// and querying): with UNSTICKYMEM_MODE=phases each phase is tuned the first
+// time it runs, and its placement is restored whenever it begins again
+void unstickymem_phase_begin(const char *name);
+void unstickymem_phase_end(void);
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -0,0 +1,277 @@
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <numaif.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#include "unstickymem/Calibration.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+// keeps the compiler from dropping the reads
+static std::atomic<uint64_t> calibration_sink(0);
+
+// reads a buffer bound to `node` from all the `cpus` at once
+static double measure_read_bandwidth(const Topology &topology, int node,
+                                     const std::vector<int> &cpus) {
+  size_t size = CALIBRATION_BUFFER_SIZE;
+  void *buffer = WRAP(mmap)(nullptr, size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  DIEIF(buffer == MAP_FAILED, "could not allocate the calibration buffer");
+  const struct bitmask *nodemask = topology.nodeBitmask(node);
+  if (WRAP(mbind)(buffer, size, MPOL_BIND, nodemask->maskp,
+                  nodemask->size + 1, 0) != 0) {
+    LWARNF("could not bind the calibration buffer to node %d", node);
+    WRAP(munmap)(buffer, size);
+    return 0;
+  }
+  memset(buffer, 1, size);
+
+  size_t words_per_thread = size / cpus.size() / sizeof(uint64_t);
+  std::atomic<size_t> ready(0);
+  std::atomic<bool> go(false);
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < cpus.size(); i++) {
+    threads.emplace_back([&, i]() {
+      cpu_set_t mask;
+      CPU_ZERO(&mask);
+      CPU_SET(cpus[i], &mask);
+      DIEIF(sched_setaffinity(0, sizeof(mask), &mask) != 0,
+            "could not pin the calibration thread");
+      const uint64_t *words = static_cast<const uint64_t*>(buffer)
+          + i * words_per_thread;
+      ready++;
+      while (!go) {
+        std::this_thread::yield();
+      }
+      uint64_t sum = 0;
+      for (int pass = 0; pass < CALIBRATION_PASSES; pass++) {
+        for (size_t j = 0; j < words_per_thread; j++) {
+          sum += words[j];
+        }
+      }
+      calibration_sink += sum;
+    });
+  }
+
+  // only start the clock once every thread is pinned
+  while (ready < threads.size()) {
+    std::this_thread::yield();
+  }
+  auto start = std::chrono::steady_clock::now();
+  go = true;
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now()
+      - start;
+  WRAP(munmap)(buffer, size);
+
+  double bytes = static_cast<double>(words_per_thread) * sizeof(uint64_t)
+      * cpus.size() * CALIBRATION_PASSES;
+  return elapsed.count() > 0 ? bytes / elapsed.count() : 0;
+}
+
+std::vector<double> measure_node_bandwidth(const Topology &topology) {
+  std::vector<double> bandwidth(topology.numNodes(), 0.0);
+
+  // the worker CPUs we are allowed to run on
+  cpu_set_t affinity;
+  DIEIF(sched_getaffinity(0, sizeof(affinity), &affinity) != 0,
+        "could not get the cpu affinity");
+  std::vector<int> cpus;
+  for (int node : topology.workerNodes()) {
+    for (int cpu : topology.node(node).cpus) {
+      if (CPU_ISSET(cpu, &affinity)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  DIEIF(cpus.empty(), "no worker CPU to run the calibration on");
+
+  for (int node : topology.memoryNodes()) {
+    bandwidth[node] = measure_read_bandwidth(topology, node, cpus);
+    LDEBUGF("node %d: %.0lf MB/s", node, bandwidth[node] / (1 << 20));
+  }
+  return bandwidth;
+}
+
+// the rounding error goes to the fastest node
+std::vector<double> bandwidth_weights(const std::vector<double> &bandwidth) {
+  double total = 0;
+  for (double b : bandwidth) {
+    total += b;
+  }
+  DIEIF(total <= 0, "could not measure the bandwidth of any node");
+
+  std::vector<double> weights(bandwidth.size(), 0.0);
+  double sum = 0;
+  for (size_t node = 0; node < bandwidth.size(); node++) {
+    weights[node] = std::round(bandwidth[node] / total * 1000) / 10;
+    sum += weights[node];
+  }
+  auto fastest = std::max_element(bandwidth.begin(), bandwidth.end());
+  weights[fastest - bandwidth.begin()] += std::round((100 - sum) * 10) / 10;
+  return weights;
+}
+
+static std::string cpu_model(void) {
+  std::string model = "unknown";
+  FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+  if (cpuinfo == NULL) {
+    return model;
+  }
+  char line[1024];
+  while (fgets(line, sizeof(line), cpuinfo) != NULL) {
+    char *value = strchr(line, ':');
+    if (strncmp(line, "model name", 10) == 0 && value != NULL) {
+      model = value + 2;
+      model.erase(model.find_last_not_of(" \n") + 1);
+      break;
+    }
+  }
+  fclose(cpuinfo);
+  return model;
+}
+
+std::string calibration_key(const Topology &topology) {
+  std::string description = cpu_model();
+  for (const Topology::Node &node : topology.nodes()) {
+    description += "|" + std::to_string(node.id) + ":"
+        + std::to_string(node.cpus.size()) + ":"
+        + std::to_string(node.memory >> 30) + (node.worker ? ":w" : "");
+  }
+  char key[32];
+  snprintf(key, sizeof(key), "%016zx",
+           std::hash<std::string>()(description));
+  return key;
+}
+
+std::string default_calibration_cache(void) {
+  if (std::getenv("XDG_CACHE_HOME") != nullptr) {
+    return std::string(std::getenv("XDG_CACHE_HOME")) + "/unstickymem";
+  }
+  if (std::getenv("HOME") != nullptr) {
+    return std::string(std::getenv("HOME")) + "/.cache/unstickymem";
+  }
+  return "";
+}
+
+bool make_directories(const std::string &path) {
+  for (size_t slash = path.find('/', 1); ; slash = path.find('/', slash + 1)) {
+    std::string prefix = path.substr(0, slash);
+    if (mkdir(prefix.c_str(), 0755) != 0 && errno != EEXIST) {
+      return false;
+    }
+    if (slash == std::string::npos) {
+      return true;
+    }
+  }
+}
+
+std::vector<double> calibrated_weights(const Topology &topology,
+                                       const std::string &cache_dir) {
+  std::string filename;
+  if (!cache_dir.empty()) {
+    filename = cache_dir + "/weights-" + calibration_key(topology) + ".txt";
+    if (access(filename.c_str(), R_OK) == 0) {
+      LINFOF("using the node weights in %s", filename.c_str());
+      return read_weights(filename);
+    }
+  }
+
+  LINFO("calibrating the node weights");
+  std::vector<double> weights = bandwidth_weights(
+      measure_node_bandwidth(topology));
+
+  // other processes may be calibrating too: write and rename
+  if (!filename.empty()) {
+    std::string workers;
+    for (int node : topology.workerNodes()) {
+      workers += (workers.empty() ? "" : ",") + std::to_string(node);
+    }
+    std::string temporary = filename + "." + std::to_string(getpid());
+    if (make_directories(cache_dir)
+        && write_weights(temporary, weights,
+                         cpu_model() + ", worker nodes " + workers)
+        && rename(temporary.c_str(), filename.c_str()) == 0) {
+      LINFOF("node weights saved in %s", filename.c_str());
+    } else {
+      LWARNF("could not save the node weights in %s", filename.c_str());
+      unlink(temporary.c_str());
+    }
+  }
+  return weights;
+}
+
+std::vector<double> read_weights(const std::string &filename) {
+  FILE * fp;
+  char * line = NULL;
+  size_t len = 0;
+  ssize_t read;
+
+  const char s[] = " \t\n";
+  char *token;
+
+  fp = fopen(filename.c_str(), "r");
+  DIEIF(fp == NULL, "could not open the weights file");
+
+  std::vector<double> weights;
+  while ((read = getline(&line, &len, fp)) != -1) {
+    char *strtok_saveptr;
+    if (line[0] == '#') {
+      continue;
+    }
+
+    // get the first token
+    token = strtok_r(line, s, &strtok_saveptr);
+    if (token == NULL) {
+      continue;
+    }
+    double weight = atof(token);
+
+    // get the second token
+    token = strtok_r(NULL, s, &strtok_saveptr);
+    DIEIF(token == NULL, "weights file lines must be \"<weight> <node id>\"");
+    int node = atoi(token);
+    DIEIF(node < 0, "invalid node id in the weights file");
+    if (static_cast<size_t>(node) >= weights.size()) {
+      weights.resize(node + 1, 0.0);
+    }
+    weights[node] = weight;
+  }
+
+  fclose(fp);
+  if (line)
+    free(line);
+  return weights;
+}
+
+bool write_weights(const std::string &filename,
+                   const std::vector<double> &weights,
+                   const std::string &comment) {
+  FILE *fp = fopen(filename.c_str(), "w");
+  if (fp == NULL) {
+    return false;
+  }
+  bool ok = fprintf(fp, "# %s\n", comment.c_str()) > 0;
+  for (size_t node = 0; node < weights.size(); node++) {
+    ok = fprintf(fp, "%.1lf %zu\n", weights[node], node) > 0 && ok;
+  }
+  ok = (fclose(fp) == 0) && ok;
+  return ok;
+}
+
+}  // namespace unstickymem
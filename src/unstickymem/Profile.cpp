@@ -0,0 +1,168 @@
+#include <elf.h>
+#include <link.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+#include "unstickymem/Profile.hpp"
+#include "unstickymem/Calibration.hpp"
+#include "unstickymem/Logger.hpp"
+
+namespace unstickymem {
+
+// the first object dl_iterate_phdr reports is the executable
+static int find_build_id(struct dl_phdr_info *info, size_t size, void *data) {
+  std::string *id = static_cast<std::string*>(data);
+  for (int i = 0; i < info->dlpi_phnum; i++) {
+    const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+    if (phdr.p_type != PT_NOTE) {
+      continue;
+    }
+    const char *note = reinterpret_cast<const char*>(info->dlpi_addr
+        + phdr.p_vaddr);
+    const char *end = note + phdr.p_memsz;
+    while (note + sizeof(ElfW(Nhdr)) <= end) {
+      const ElfW(Nhdr) *header = reinterpret_cast<const ElfW(Nhdr)*>(note);
+      const char *name = note + sizeof(ElfW(Nhdr));
+      const unsigned char *desc = reinterpret_cast<const unsigned char*>(
+          name + ((header->n_namesz + 3) & ~3));
+      if (header->n_type == NT_GNU_BUILD_ID && header->n_namesz == 4
+          && memcmp(name, "GNU", 4) == 0) {
+        char hex[3];
+        for (size_t j = 0; j < header->n_descsz; j++) {
+          snprintf(hex, sizeof(hex), "%02x", desc[j]);
+          *id += hex;
+        }
+        return 1;
+      }
+      note = reinterpret_cast<const char*>(desc)
+          + ((header->n_descsz + 3) & ~3);
+    }
+  }
+  return 1;
+}
+
+std::string executable_build_id(void) {
+  std::string id;
+  dl_iterate_phdr(find_build_id, &id);
+  return id;
+}
+
+static std::string executable_path(void) {
+  char path[4096];
+  ssize_t length = readlink("/proc/self/exe", path, sizeof(path) - 1);
+  if (length < 0) {
+    return "unknown";
+  }
+  path[length] = '\0';
+  return path;
+}
+
+// the arguments (without the program name), separated by spaces
+static std::string program_arguments(void) {
+  std::string arguments;
+  FILE *cmdline = fopen("/proc/self/cmdline", "r");
+  if (cmdline == NULL) {
+    return arguments;
+  }
+  bool program_name = true;
+  for (int c = fgetc(cmdline); c != EOF; c = fgetc(cmdline)) {
+    if (c == '\0') {
+      if (!program_name) {
+        arguments += ' ';
+      }
+      program_name = false;
+    } else if (!program_name) {
+      arguments += static_cast<char>(c);
+    }
+  }
+  fclose(cmdline);
+  if (!arguments.empty()) {
+    arguments.pop_back();
+  }
+  return arguments;
+}
+
+std::string profile_key(const Topology &topology) {
+  // without a build-id, a rebuilt executable is told apart by its size/mtime
+  std::string executable = executable_build_id();
+  if (executable.empty()) {
+    struct stat st;
+    executable = executable_path();
+    if (stat(executable.c_str(), &st) == 0) {
+      executable += ":" + std::to_string(st.st_size) + ":"
+          + std::to_string(st.st_mtime);
+    }
+  }
+  std::string description = executable + "|" + program_arguments() + "|"
+      + calibration_key(topology);
+  char key[32];
+  snprintf(key, sizeof(key), "%016zx",
+           std::hash<std::string>()(description));
+  return key;
+}
+
+std::string profile_filename(const Topology &topology,
+                             const std::string &cache_dir) {
+  return cache_dir + "/profile-" + profile_key(topology) + ".txt";
+}
+
+bool read_profile(const std::string &filename, Profile *profile) {
+  FILE *fp = fopen(filename.c_str(), "r");
+  if (fp == NULL) {
+    return false;
+  }
+  char line[1024];
+  char mode[256];
+  bool has_mode = false, has_ratio = false, has_stall_rate = false;
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (line[0] == '#') {
+      continue;
+    }
+    if (sscanf(line, "mode %255s", mode) == 1) {
+      profile->mode = mode;
+      has_mode = true;
+    } else if (sscanf(line, "ratio %lf", &profile->ratio) == 1) {
+      has_ratio = true;
+    } else if (sscanf(line, "stall_rate %lf", &profile->stall_rate) == 1) {
+      has_stall_rate = true;
+    }
+  }
+  fclose(fp);
+  return has_mode && has_ratio && has_stall_rate;
+}
+
+bool write_profile(const std::string &filename, const Profile &profile,
+                   const std::string &comment) {
+  FILE *fp = fopen(filename.c_str(), "w");
+  if (fp == NULL) {
+    return false;
+  }
+  bool ok = fprintf(fp, "# %s\n", comment.c_str()) > 0;
+  ok = fprintf(fp, "mode %s\n", profile.mode.c_str()) > 0 && ok;
+  ok = fprintf(fp, "ratio %.1lf\n", profile.ratio) > 0 && ok;
+  ok = fprintf(fp, "stall_rate %.10lf\n", profile.stall_rate) > 0 && ok;
+  ok = (fclose(fp) == 0) && ok;
+  return ok;
+}
+
+// other runs of the program may be saving theirs too: write and rename
+bool save_profile(const std::string &filename, const Profile &profile) {
+  std::string directory = filename.substr(0, filename.rfind('/'));
+  std::string temporary = filename + "." + std::to_string(getpid());
+  std::string arguments = program_arguments();
+  std::string comment = executable_path()
+      + (arguments.empty() ? "" : " " + arguments);
+  if (make_directories(directory)
+      && write_profile(temporary, profile, comment)
+      && rename(temporary.c_str(), filename.c_str()) == 0) {
+    return true;
+  }
+  unlink(temporary.c_str());
+  return false;
+}
+
+}  // namespace unstickymem
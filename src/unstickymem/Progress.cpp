@@ -0,0 +1,122 @@
+#include <atomic>
+#include <chrono>
+
+#include "unstickymem/Progress.hpp"
+#include "unstickymem/PerformanceCounters.hpp"
+#include "unstickymem/counters/ThreadCounter.hpp"
+#include "unstickymem/Logger.hpp"
+
+namespace unstickymem {
+
+Objective parse_objective(const std::string &name) {
+  auto objective = Objective::_from_string_nocase_nothrow(name.c_str());
+  DIEIFF(!objective, "unknown objective %s (use stalls, progress or "
+         "stalls_per_op)", name.c_str());
+  return *objective;
+}
+
+struct alignas(64) ProgressSlot {
+  std::atomic<uint64_t> ops;
+  std::atomic<uint64_t> iterations;
+  std::atomic<uint64_t> stalls;
+};
+
+// zero-initialized before any constructor runs
+static ProgressSlot slots[PROGRESS_SLOTS];
+static std::atomic<size_t> next_slot(0);
+static thread_local ProgressSlot *slot = nullptr;
+
+static ProgressSlot* my_slot(void) {
+  if (slot == nullptr) {
+    slot = &slots[next_slot++ % PROGRESS_SLOTS];
+  }
+  return slot;
+}
+
+// the stalls of the calling thread since its previous report, read from
+// user space (see ThreadCounter). not counted where that takes a syscall:
+// reports must stay cheap
+static void count_stalls(ProgressSlot *s) {
+  thread_local ThreadCounter counter;
+  thread_local double previous = 0;
+  if (!counter.isOpen() || !counter.userspaceReads()) {
+    return;
+  }
+  double stalls = counter.read();
+  s->stalls.fetch_add(static_cast<uint64_t>(stalls - previous),
+                      std::memory_order_relaxed);
+  previous = stalls;
+}
+
+void report_progress(uint64_t ops) {
+  ProgressSlot *s = my_slot();
+  count_stalls(s);
+  s->ops.fetch_add(ops, std::memory_order_relaxed);
+}
+
+void iteration_done(void) {
+  ProgressSlot *s = my_slot();
+  count_stalls(s);
+  s->iterations.fetch_add(1, std::memory_order_relaxed);
+}
+
+ProgressCount read_progress(void) {
+  ProgressCount count = { 0, 0, 0 };
+  for (const ProgressSlot &s : slots) {
+    count.ops += s.ops.load(std::memory_order_relaxed);
+    count.iterations += s.iterations.load(std::memory_order_relaxed);
+    count.stalls += s.stalls.load(std::memory_order_relaxed);
+  }
+  return count;
+}
+
+double get_time_per_op(void) {
+  static ProgressCount previous = { 0, 0, 0 };
+  static auto previous_time = std::chrono::steady_clock::now();
+  static bool warned = false;
+
+  ProgressCount count = read_progress();
+  auto now = std::chrono::steady_clock::now();
+  uint64_t done = count.ops > 0 ? count.ops - previous.ops
+      : count.iterations - previous.iterations;
+  std::chrono::duration<double> elapsed = now - previous_time;
+  previous = count;
+  previous_time = now;
+
+  if (count.ops == 0 && count.iterations == 0 && !warned) {
+    LWARN("the application has not reported any progress yet");
+    warned = true;
+  }
+  return elapsed.count() / (done > 0 ? done : 1);
+}
+
+double get_stalls_per_op(void) {
+  static ProgressCount previous = { 0, 0, 0 };
+  static double previous_stalls = 0;
+
+  ProgressCount count = read_progress();
+  double stalls = get_stall_count();
+  uint64_t done = count.ops > 0 ? count.ops - previous.ops
+      : count.iterations - previous.iterations;
+  double thread_stalls = count.stalls - previous.stalls;
+  double all_stalls = stalls - previous_stalls;
+  previous = count;
+  previous_stalls = stalls;
+
+  return (thread_stalls > 0 ? thread_stalls : all_stalls)
+      / (done > 0 ? done : 1);
+}
+
+double get_objective(Objective objective) {
+  switch (objective) {
+    case Objective::STALLS:
+      return get_stall_rate_v2();
+    case Objective::PROGRESS:
+      return get_time_per_op();
+    case Objective::STALLS_PER_OP:
+      return get_stalls_per_op();
+  }
+  return 0;
+}
+
+}  // namespace unstickymem
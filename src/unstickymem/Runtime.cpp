@@ -1,6 +1,7 @@
 #include <sys/mman.h>
 
 #include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <fstream>
 
@@ -9,7 +10,9 @@
 #include "better-enums/enum.h"
 
 #include "unstickymem/mode/Mode.hpp"
+#include "unstickymem/Calibration.hpp"
 #include "unstickymem/Runtime.hpp"
+#include "unstickymem/placement/WeightedInterleave.hpp"
 #include "unstickymem/Logger.hpp"
 
 namespace unstickymem {
@@ -26,12 +29,11 @@ Runtime& Runtime::getInstance(void) {
   return *object;
 }
 
+// the mode is started by the library constructor (once the weights and the
+// memory map are ready), if autostart is enabled
 Runtime::Runtime() {
   loadConfiguration();
   printConfiguration();
-  if (_autostart) {
-    startSelectedMode();
-  }
 }
 
 void Runtime::loadConfiguration() {
@@ -50,6 +52,27 @@ void Runtime::loadConfiguration() {
       "UNSTICKYMEM_AUTOSTART",
       po::value<bool>(&_autostart)->default_value(false),
       "Run the algorithm automatically at startup")(
+      "UNSTICKYMEM_ALLOC_THRESHOLD",
+      po::value<size_t>(&_alloc_threshold)->default_value(128 * 1024),
+      "Allocations smaller than this (in bytes) are not tracked")(
+      "UNSTICKYMEM_MIGRATION_THREADS",
+      po::value<size_t>(&_migration_threads)->default_value(0),
+      "Threads migrating pages (0 for one per NUMA node)")(
+      "UNSTICKYMEM_MIGRATION_BW",
+      po::value<size_t>(&_migration_bandwidth)->default_value(0),
+      "Page migration bandwidth cap in bytes/s (0 for unlimited)")(
+      "UNSTICKYMEM_NATIVE_WEIGHTS",
+      po::value<bool>(&_native_weights)->default_value(false),
+      "Set the system-wide weighted interleave weights (root)")(
+      "UNSTICKYMEM_PROFILE",
+      po::value<bool>(&_profile)->default_value(true),
+      "Start from the result of previous runs of the program, and save it")(
+      "UNSTICKYMEM_PROFILE_REFINE",
+      po::value<bool>(&_profile_refine)->default_value(true),
+      "Keep tuning (near it) after starting from a profile")(
+      "UNSTICKYMEM_PROFILE_DIR",
+      po::value < std::string > (&_profile_dir)->default_value(""),
+      "Directory of the profiles (default: the calibration cache)")(
       "UNSTICKYMEM_LOGLEVEL",
       po::value < std::string > (&option_loglevel)->default_value("info"),
       "Log level (trace, debug, info, warn, error, fatal, off)");
@@ -66,6 +89,7 @@ void Runtime::loadConfiguration() {
       lib_env);
   po::store(po::parse_config_file(ini_filename, lib_options, true), lib_env);
   po::notify(lib_env);
+  weighted_interleave_allow_writes(_native_weights);
 
   // get options of selected mode
   _mode = Mode::getMode(_mode_name);
@@ -101,15 +125,75 @@ void Runtime::loadConfiguration() {
 void Runtime::printConfiguration() {
   LINFOF("Mode:      %s", _mode_name.c_str());
   LINFOF("Autostart: %s", _autostart ? "enabled" : "disabled");
+  LINFOF("Threshold: %zu bytes", _alloc_threshold);
+  LINFOF("Migration: %zu threads", _migration_threads);
+  LINFOF("Bandwidth: %zu bytes/s", _migration_bandwidth);
+  LINFOF("Weights:   %s", _native_weights ? "native (if possible)" : "sliced");
+  LINFOF("Profile:   %s%s", _profile ? "enabled" : "disabled",
+         _profile && !_profile_refine ? " (no refinement)" : "");
 }
 
 std::shared_ptr<Mode> Runtime::getMode() {
   return _mode;
 }
 
+bool Runtime::getAutostart() const {
+  return _autostart;
+}
+
+size_t Runtime::getAllocThreshold() const {
+  return _alloc_threshold;
+}
+
+size_t Runtime::getMigrationThreads() const {
+  return _migration_threads;
+}
+
+size_t Runtime::getMigrationBandwidth() const {
+  return _migration_bandwidth;
+}
+
+std::string Runtime::profileFilename() const {
+  // next to the calibrated weights by default
+  std::string directory = _profile_dir;
+  if (directory.empty()) {
+    const char *cache = std::getenv("UNSTICKYMEM_CALIBRATION_CACHE");
+    directory = cache ? cache : default_calibration_cache();
+  }
+  if (!_profile || directory.empty()) {
+    return "";
+  }
+  return profile_filename(Topology::getInstance(), directory);
+}
+
+void Runtime::saveProfile(double ratio, double stall_rate) {
+  std::string filename = profileFilename();
+  if (filename.empty()) {
+    return;
+  }
+  if (save_profile(filename, { _mode_name, ratio, stall_rate })) {
+    LINFOF("profile saved in %s", filename.c_str());
+  } else {
+    LWARNF("could not save the profile in %s", filename.c_str());
+  }
+}
+
 void Runtime::startSelectedMode() {
   LINFO("Mode parameters:");
   _mode->printParameters();
+
+  // a previous run of this program may have done the tuning already
+  Profile profile;
+  std::string filename = profileFilename();
+  if (!filename.empty() && read_profile(filename, &profile)) {
+    if (_mode->warmStart(profile, _profile_refine)) {
+      LINFOF("starting from %s: ratio %.1lf, stall rate %1.10lf (%s)",
+             filename.c_str(), profile.ratio, profile.stall_rate,
+             profile.mode.c_str());
+    } else {
+      LINFOF("mode %s cannot start from a profile", _mode_name.c_str());
+    }
+  }
   _mode->start();
 }
 
@@ -0,0 +1,247 @@
+#include <sched.h>
+#include <sys/mman.h>
+
+#include <cmath>
+#include <cstdlib>
+
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+static const int MAX_MASK_NODES = sizeof(unsigned long) * 8;
+
+Topology& Topology::getInstance(void) {
+  static Topology *object = nullptr;
+  if (!object) {
+    LDEBUG("Creating Topology singleton object");
+    void *buf = WRAP(mmap)(nullptr, sizeof(Topology), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    DIEIF(buf == MAP_FAILED, "error allocating space for topology object");
+    object = new (buf) Topology();
+  }
+  return *object;
+}
+
+Topology::Topology() {
+  int num_nodes = numa_num_configured_nodes();
+  int max_node = numa_max_node();
+  DIEIF(max_node >= MAX_MASK_NODES, "too many NUMA nodes");
+
+  cpu_set_t affinity;
+  DIEIF(sched_getaffinity(0, sizeof(affinity), &affinity) != 0,
+        "could not get the cpu affinity");
+  struct bitmask *mems_allowed = numa_get_mems_allowed();
+  struct bitmask *cpus = numa_allocate_cpumask();
+
+  for (int id = 0; id <= max_node; id++) {
+    Node node = { id, { }, false, false, 0, false };
+    if (numa_node_to_cpus(id, cpus) == 0) {
+      for (unsigned cpu = 0; cpu < cpus->size; cpu++) {
+        if (numa_bitmask_isbitset(cpus, cpu)) {
+          node.cpus.push_back(cpu);
+          node.allowed_cpus |= CPU_ISSET(cpu, &affinity);
+        }
+      }
+    }
+    long long free_memory;
+    node.memory = std::max(numa_node_size64(id, &free_memory), 0LL);
+    node.allowed_memory = node.memory > 0
+        && numa_bitmask_isbitset(mems_allowed, id);
+    if (node.allowed_memory) {
+      _memory_mask |= 1UL << id;
+    }
+    _nodes.push_back(node);
+
+    struct bitmask *node_bitmask = numa_allocate_nodemask();
+    numa_bitmask_setbit(node_bitmask, id);
+    _node_bitmasks.push_back(node_bitmask);
+  }
+  numa_free_cpumask(cpus);
+  DIEIF(_memory_mask == 0, "no NUMA node to place memory on");
+  LDEBUGF("%d NUMA nodes configured", num_nodes);
+
+  _distances.resize(_nodes.size(), std::vector<int>(_nodes.size(), 0));
+  for (size_t from = 0; from < _nodes.size(); from++) {
+    for (size_t to = 0; to < _nodes.size(); to++) {
+      _distances[from][to] = numa_distance(from, to);
+    }
+  }
+
+  _weights.assign(_nodes.size(), 0.0);
+  detectWorkerNodes();
+}
+
+const std::vector<Topology::Node>& Topology::nodes(void) const {
+  return _nodes;
+}
+
+const Topology::Node& Topology::node(int id) const {
+  DIEIF(id < 0 || id >= static_cast<int>(_nodes.size()), "invalid node id");
+  return _nodes[id];
+}
+
+size_t Topology::numNodes(void) const {
+  return _nodes.size();
+}
+
+int Topology::distance(int from, int to) const {
+  return _distances[node(from).id][node(to).id];
+}
+
+std::vector<int> Topology::memoryNodes(void) const {
+  std::vector<int> result;
+  for (const Node &node : _nodes) {
+    if (node.allowed_memory) {
+      result.push_back(node.id);
+    }
+  }
+  return result;
+}
+
+unsigned long Topology::memoryMask(void) const {
+  return _memory_mask;
+}
+
+std::vector<int> Topology::cpuNodes(void) const {
+  std::vector<int> result;
+  for (const Node &node : _nodes) {
+    if (node.allowed_cpus) {
+      result.push_back(node.id);
+    }
+  }
+  return result;
+}
+
+const struct bitmask* Topology::nodeBitmask(int id) const {
+  return _node_bitmasks[node(id).id];
+}
+
+void Topology::setWorkerNodes(const std::vector<int> &nodes) {
+  DIEIF(nodes.empty(), "there must be at least one worker node");
+  _worker_mask = 0;
+  for (Node &node : _nodes) {
+    node.worker = false;
+  }
+  for (int id : nodes) {
+    DIEIF(id < 0 || id >= static_cast<int>(_nodes.size()),
+          "invalid worker node id");
+    _nodes[id].worker = true;
+    _worker_mask |= 1UL << id;
+  }
+}
+
+// the nodes the application can run on. if that is every memory node, no
+// page could be moved to the workers: only the node we start on is one
+void Topology::detectWorkerNodes(void) {
+  std::vector<int> nodes = cpuNodes();
+  if (nodes.empty()) {
+    // no CPU information (e.g. inside some containers)
+    nodes.push_back(0);
+  }
+  unsigned long mask = 0;
+  for (int id : nodes) {
+    mask |= 1UL << id;
+  }
+  if (nodes.size() > 1 && (_memory_mask & ~mask) == 0) {
+    int cpu = sched_getcpu();
+    int current = cpu >= 0 ? numa_node_of_cpu(cpu) : -1;
+    bool allowed = current >= 0 && (mask & (1UL << current));
+    nodes = { allowed ? current : nodes[0] };
+  }
+  setWorkerNodes(nodes);
+}
+
+std::vector<int> Topology::workerNodes(void) const {
+  std::vector<int> result;
+  for (const Node &node : _nodes) {
+    if (node.worker) {
+      result.push_back(node.id);
+    }
+  }
+  return result;
+}
+
+unsigned long Topology::workerMask(void) const {
+  return _worker_mask;
+}
+
+bool Topology::isWorker(int id) const {
+  return node(id).worker;
+}
+
+void Topology::setWeights(const std::vector<double> &weights) {
+  _weights.assign(_nodes.size(), 0.0);
+  for (size_t id = 0; id < weights.size(); id++) {
+    if (id >= _nodes.size() || !_nodes[id].allowed_memory) {
+      if (weights[id] > 0) {
+        LWARNF("ignoring the weight of node %zu (no memory there)", id);
+      }
+      continue;
+    }
+    _weights[id] = weights[id];
+  }
+}
+
+const std::vector<double>& Topology::weights(void) const {
+  return _weights;
+}
+
+double Topology::workerWeight(void) const {
+  double sum = 0;
+  for (const Node &node : _nodes) {
+    sum += node.worker ? _weights[node.id] : 0;
+  }
+  return sum;
+}
+
+double Topology::nonWorkerWeight(void) const {
+  double sum = 0;
+  for (const Node &node : _nodes) {
+    sum += node.worker ? 0 : _weights[node.id];
+  }
+  return sum;
+}
+
+// worker nodes share sum_ww + s % of the pages, the others the rest (each
+// keeping its proportion within the group), rounded to 0.1%
+std::vector<double> Topology::weightsForWorkerShare(double s) const {
+  double sum_ww = workerWeight();
+  double sum_nww = nonWorkerWeight();
+  double new_s = std::min(sum_ww + s, 100.0);
+  std::vector<double> result(_nodes.size(), 0.0);
+  for (const Node &node : _nodes) {
+    double group_weight = node.worker ? sum_ww : sum_nww;
+    double group_share = node.worker ? new_s : 100 - new_s;
+    if (group_weight > 0) {
+      result[node.id] = std::round(
+          (_weights[node.id] / group_weight * group_share) * 10) / 10;
+    }
+  }
+  return result;
+}
+
+void Topology::print(void) const {
+  for (const Node &node : _nodes) {
+    LINFOF("node %d: %zu cpus%s, %lld MB%s, weight %.1lf%s", node.id,
+           node.cpus.size(), node.allowed_cpus ? "" : " (not allowed)",
+           node.memory >> 20, node.allowed_memory ? "" : " (not allowed)",
+           _weights[node.id], node.worker ? " [worker]" : "");
+  }
+}
+
+std::vector<int> Topology::parseNodeList(const std::string &list) {
+  std::vector<int> result;
+  struct bitmask *nodes = numa_parse_nodestring(list.c_str());
+  DIEIF(nodes == nullptr, "invalid node list");
+  for (unsigned id = 0; id < nodes->size; id++) {
+    if (numa_bitmask_isbitset(nodes, id)) {
+      result.push_back(id);
+    }
+  }
+  numa_bitmask_free(nodes);
+  return result;
+}
+
+}  // namespace unstickymem
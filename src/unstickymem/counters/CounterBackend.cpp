@@ -0,0 +1,112 @@
+#include <sched.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+
+#include "unstickymem/counters/CounterBackend.hpp"
+
+namespace unstickymem {
+
+std::map<std::string, CounterBackend::Description> & CounterBackend::registry() {
+  static std::map<std::string, CounterBackend::Description> r;
+  return r;
+}
+
+std::unique_ptr<CounterBackend> CounterBackend::create(
+    std::string const & name) {
+  if (registry().count(name) == 0) {
+    printAvailableBackends();
+    DIE("Please select one of the available counter backends");
+  }
+  return registry()[name].create_function();
+}
+
+std::unique_ptr<CounterBackend> CounterBackend::select(
+    std::string const & name, const Topology &topology,
+    std::string *selected) {
+  // the requested backend first, then the others by priority (those with a
+  // negative one only when requested)
+  std::vector<std::string> candidates;
+  for (auto & [backend, d] : registry()) {
+    if (d.priority >= 0 || backend == name) {
+      candidates.push_back(backend);
+    }
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const std::string &a, const std::string &b) {
+                     return registry()[a].priority > registry()[b].priority;
+                   });
+  if (name != "auto") {
+    create(name);  // dies if it does not exist
+    candidates.erase(std::find(candidates.begin(), candidates.end(), name));
+    candidates.insert(candidates.begin(), name);
+  }
+
+  for (const std::string &candidate : candidates) {
+    std::unique_ptr<CounterBackend> backend = create(candidate);
+    if (backend->start(topology)) {
+      if (name != "auto" && candidate != name) {
+        LWARNF("counter backend %s is not available, using %s", name.c_str(),
+               candidate.c_str());
+      }
+      if (selected != nullptr) {
+        *selected = candidate;
+      }
+      return backend;
+    }
+    LDEBUGF("counter backend %s is not available", candidate.c_str());
+  }
+  DIE("no counter backend could be started");
+}
+
+double CounterBackend::readStalls() {
+  std::vector<double> stalls = readNodeStalls();
+  return std::accumulate(stalls.begin(), stalls.end(), 0.0);
+}
+
+void CounterBackend::printAvailableBackends() {
+  LWARN("Available Counter Backends:");
+  for (auto & [name, d] : registry()) {
+    LWARNF("> %-10s (%s)", name.c_str(), d.description.c_str());
+  }
+}
+
+std::string CounterBackend::cpuVendor(void) {
+  std::string vendor = "unknown";
+  FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+  if (cpuinfo == NULL) {
+    return vendor;
+  }
+  char line[1024];
+  while (fgets(line, sizeof(line), cpuinfo) != NULL) {
+    char *value = strchr(line, ':');
+    if (strncmp(line, "vendor_id", 9) == 0 && value != NULL) {
+      vendor = value + 2;
+      vendor.erase(vendor.find_last_not_of(" \n") + 1);
+      break;
+    }
+  }
+  fclose(cpuinfo);
+  return vendor;
+}
+
+std::vector<int> CounterBackend::workerCpus(const Topology &topology) {
+  std::vector<int> cpus;
+  cpu_set_t affinity;
+  CPU_ZERO(&affinity);
+  DIEIF(sched_getaffinity(0, sizeof(affinity), &affinity) != 0,
+        "could not get the CPU affinity");
+  for (int node : topology.workerNodes()) {
+    for (int cpu : topology.node(node).cpus) {
+      if (CPU_ISSET(cpu, &affinity)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
+}  // namespace unstickymem
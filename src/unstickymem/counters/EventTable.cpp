@@ -0,0 +1,191 @@
+#include <linux/perf_event.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "unstickymem/counters/EventTable.hpp"
+
+namespace unstickymem {
+
+// raw Intel events: event | umask << 8 | cmask << 24
+static const PerfEventBackend::Event RESOURCE_STALLS_ANY =
+    { "RESOURCE_STALLS.ANY", PERF_TYPE_RAW, 0x01a2 };
+static const PerfEventBackend::Event STALLS_MEM_ANY =
+    { "CYCLE_ACTIVITY.STALLS_MEM_ANY", PERF_TYPE_RAW, 0x140014a3 };
+static const PerfEventBackend::Event STALLS_L3_MISS =
+    { "CYCLE_ACTIVITY.STALLS_L3_MISS", PERF_TYPE_RAW, 0x060006a3 };
+static const PerfEventBackend::Event LONGEST_LAT_CACHE_MISS =
+    { "LONGEST_LAT_CACHE.MISS", PERF_TYPE_RAW, 0x412e };
+
+// raw AMD events: event | umask << 8
+static const PerfEventBackend::Event DISPATCH_STALLS =
+    { "DISPATCH_STALLS", PERF_TYPE_RAW, 0x00d1 };
+static const PerfEventBackend::Event DISPATCH_TOKEN_STALLS =
+    { "DE_DIS_DISPATCH_TOKEN_STALLS1", PERF_TYPE_RAW, 0xffae };
+
+static const Microarchitecture MICROARCHITECTURES[] = {
+  { "Haswell-EP", "GenuineIntel", 6, 0x3f, 0x3f,
+    { RESOURCE_STALLS_ANY },
+    { { "MEM_LOAD_UOPS_L3_MISS_RETIRED.LOCAL_DRAM", PERF_TYPE_RAW, 0x01d3 } },
+    { { "MEM_LOAD_UOPS_L3_MISS_RETIRED.REMOTE_DRAM", PERF_TYPE_RAW, 0x04d3 } },
+    { LONGEST_LAT_CACHE_MISS },
+    "RESOURCE_STALLS_ANY:PMC0" },
+  { "Broadwell-EP", "GenuineIntel", 6, 0x4f, 0x4f,
+    { RESOURCE_STALLS_ANY },
+    { { "MEM_LOAD_UOPS_L3_MISS_RETIRED.LOCAL_DRAM", PERF_TYPE_RAW, 0x01d3 } },
+    { { "MEM_LOAD_UOPS_L3_MISS_RETIRED.REMOTE_DRAM", PERF_TYPE_RAW, 0x04d3 } },
+    { LONGEST_LAT_CACHE_MISS },
+    "RESOURCE_STALLS_ANY:PMC0" },
+  // also Cascade Lake and Cooper Lake
+  { "Skylake-SP", "GenuineIntel", 6, 0x55, 0x55,
+    { STALLS_MEM_ANY, RESOURCE_STALLS_ANY },
+    { { "MEM_LOAD_L3_MISS_RETIRED.LOCAL_DRAM", PERF_TYPE_RAW, 0x01d3 } },
+    { { "MEM_LOAD_L3_MISS_RETIRED.REMOTE_DRAM", PERF_TYPE_RAW, 0x02d3 } },
+    { LONGEST_LAT_CACHE_MISS },
+    "RESOURCE_STALLS_ANY:PMC0" },
+  { "Ice Lake-SP", "GenuineIntel", 6, 0x6a, 0x6c,
+    { STALLS_MEM_ANY },
+    { { "MEM_LOAD_L3_MISS_RETIRED.LOCAL_DRAM", PERF_TYPE_RAW, 0x01d3 } },
+    { { "MEM_LOAD_L3_MISS_RETIRED.REMOTE_DRAM", PERF_TYPE_RAW, 0x02d3 } },
+    { LONGEST_LAT_CACHE_MISS },
+    nullptr },
+  { "Sapphire Rapids", "GenuineIntel", 6, 0x8f, 0x8f,
+    { STALLS_L3_MISS },
+    { { "MEM_LOAD_L3_MISS_RETIRED.LOCAL_DRAM", PERF_TYPE_RAW, 0x01d3 } },
+    { { "MEM_LOAD_L3_MISS_RETIRED.REMOTE_DRAM", PERF_TYPE_RAW, 0x02d3 } },
+    { LONGEST_LAT_CACHE_MISS },
+    nullptr },
+  { "Emerald Rapids", "GenuineIntel", 6, 0xcf, 0xcf,
+    { STALLS_L3_MISS },
+    { { "MEM_LOAD_L3_MISS_RETIRED.LOCAL_DRAM", PERF_TYPE_RAW, 0x01d3 } },
+    { { "MEM_LOAD_L3_MISS_RETIRED.REMOTE_DRAM", PERF_TYPE_RAW, 0x02d3 } },
+    { LONGEST_LAT_CACHE_MISS },
+    nullptr },
+  { "K10", "AuthenticAMD", 0x10, 0x00, 0xff,
+    { DISPATCH_STALLS }, {}, {}, {},
+    "DISPATCH_STALLS:PMC0" },
+  { "Bulldozer", "AuthenticAMD", 0x15, 0x00, 0x1f,
+    { DISPATCH_STALLS }, {}, {}, {},
+    "DISPATCH_STALLS:PMC0" },
+  // Zen, Zen+ and Zen 2
+  { "Zen 2", "AuthenticAMD", 0x17, 0x00, 0xff,
+    { DISPATCH_TOKEN_STALLS },
+    { { "LS_REFILLS_FROM_SYS.LS_MABRESP_LCL_DRAM", PERF_TYPE_RAW, 0x0843 } },
+    { { "LS_REFILLS_FROM_SYS.LS_MABRESP_RMT_DRAM", PERF_TYPE_RAW, 0x4043 } },
+    {},
+    nullptr },
+  { "Zen 3", "AuthenticAMD", 0x19, 0x00, 0x0f,
+    { DISPATCH_TOKEN_STALLS },
+    { { "LS_ANY_FILLS_FROM_SYS.DRAM_IO_NEAR", PERF_TYPE_RAW, 0x0844 } },
+    { { "LS_ANY_FILLS_FROM_SYS.DRAM_IO_FAR", PERF_TYPE_RAW, 0x4044 } },
+    {},
+    nullptr },
+  { "Zen 4", "AuthenticAMD", 0x19, 0x10, 0x1f,
+    { DISPATCH_TOKEN_STALLS },
+    { { "LS_ANY_FILLS_FROM_SYS.DRAM_IO_NEAR", PERF_TYPE_RAW, 0x0844 } },
+    { { "LS_ANY_FILLS_FROM_SYS.DRAM_IO_FAR", PERF_TYPE_RAW, 0x4044 } },
+    {},
+    nullptr },
+  { "Zen 3", "AuthenticAMD", 0x19, 0x20, 0x5f,
+    { DISPATCH_TOKEN_STALLS },
+    { { "LS_ANY_FILLS_FROM_SYS.DRAM_IO_NEAR", PERF_TYPE_RAW, 0x0844 } },
+    { { "LS_ANY_FILLS_FROM_SYS.DRAM_IO_FAR", PERF_TYPE_RAW, 0x4044 } },
+    {},
+    nullptr },
+  { "Zen 4", "AuthenticAMD", 0x19, 0x60, 0xaf,
+    { DISPATCH_TOKEN_STALLS },
+    { { "LS_ANY_FILLS_FROM_SYS.DRAM_IO_NEAR", PERF_TYPE_RAW, 0x0844 } },
+    { { "LS_ANY_FILLS_FROM_SYS.DRAM_IO_FAR", PERF_TYPE_RAW, 0x4044 } },
+    {},
+    nullptr },
+};
+
+// generic events: cache id | op << 8 | result << 16
+static const uint64_t NODE_LOADS = PERF_COUNT_HW_CACHE_NODE
+    | PERF_COUNT_HW_CACHE_OP_READ << 8
+    | PERF_COUNT_HW_CACHE_RESULT_ACCESS << 16;
+static const uint64_t NODE_LOAD_MISSES = PERF_COUNT_HW_CACHE_NODE
+    | PERF_COUNT_HW_CACHE_OP_READ << 8
+    | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+static const uint64_t LLC_LOAD_MISSES = PERF_COUNT_HW_CACHE_LL
+    | PERF_COUNT_HW_CACHE_OP_READ << 8
+    | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+
+CpuModel CpuModel::current(void) {
+  CpuModel cpu = { "unknown", -1, -1 };
+  FILE *cpuinfo = fopen("/proc/cpuinfo", "r");
+  if (cpuinfo == NULL) {
+    return cpu;
+  }
+  char line[1024];
+  while (fgets(line, sizeof(line), cpuinfo) != NULL) {
+    char *value = strchr(line, ':');
+    if (value == NULL) {
+      continue;
+    }
+    if (strncmp(line, "vendor_id", 9) == 0) {
+      cpu.vendor = value + 2;
+      cpu.vendor.erase(cpu.vendor.find_last_not_of(" \n") + 1);
+    } else if (strncmp(line, "cpu family", 10) == 0) {
+      cpu.family = atoi(value + 1);
+    } else if (strncmp(line, "model\t", 6) == 0) {
+      cpu.model = atoi(value + 1);
+    } else if (line[0] == '\n') {
+      break;  // the first CPU is enough
+    }
+  }
+  fclose(cpuinfo);
+  return cpu;
+}
+
+const Microarchitecture* find_microarchitecture(const CpuModel &cpu) {
+  for (const Microarchitecture &uarch : MICROARCHITECTURES) {
+    if (cpu.vendor == uarch.vendor && cpu.family == uarch.family
+        && cpu.model >= uarch.first_model && cpu.model <= uarch.last_model) {
+      return &uarch;
+    }
+  }
+  return nullptr;
+}
+
+std::vector<PerfEventBackend::Event> counter_events(CounterMetric metric,
+                                                    const CpuModel &cpu) {
+  std::vector<PerfEventBackend::Event> events;
+  const Microarchitecture *uarch = find_microarchitecture(cpu);
+  if (uarch != nullptr) {
+    const std::vector<PerfEventBackend::Event> &own =
+        metric == +CounterMetric::STALLS ? uarch->stalls :
+        metric == +CounterMetric::LOCAL_DRAM ? uarch->local_dram :
+        metric == +CounterMetric::REMOTE_DRAM ? uarch->remote_dram :
+        uarch->bandwidth;
+    events.insert(events.end(), own.begin(), own.end());
+  }
+  switch (metric) {
+    case CounterMetric::STALLS:
+      events.push_back({ "stalled-cycles-backend", PERF_TYPE_HARDWARE,
+          PERF_COUNT_HW_STALLED_CYCLES_BACKEND });
+      break;
+    case CounterMetric::LOCAL_DRAM:
+      events.push_back({ "node-loads", PERF_TYPE_HW_CACHE, NODE_LOADS });
+      break;
+    case CounterMetric::REMOTE_DRAM:
+      events.push_back({ "node-load-misses", PERF_TYPE_HW_CACHE,
+          NODE_LOAD_MISSES });
+      break;
+    case CounterMetric::BANDWIDTH:
+      events.push_back({ "LLC-load-misses", PERF_TYPE_HW_CACHE,
+          LLC_LOAD_MISSES });
+      events.push_back({ "cache-misses", PERF_TYPE_HARDWARE,
+          PERF_COUNT_HW_CACHE_MISSES });
+      break;
+  }
+  return events;
+}
+
+const char* likwid_stall_events(const CpuModel &cpu) {
+  const Microarchitecture *uarch = find_microarchitecture(cpu);
+  return uarch != nullptr ? uarch->likwid_stalls : nullptr;
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,137 @@
+#include <dlfcn.h>
+#include <numa.h>
+
+#include "unstickymem/counters/LikwidBackend.hpp"
+#include "unstickymem/counters/EventTable.hpp"
+
+namespace unstickymem {
+
+static CounterBackend::Registrar<LikwidBackend> registrar(
+    LikwidBackend::name(), LikwidBackend::description(), 10);
+
+static const char *LIKWID_LIBRARIES[] = { "liblikwid.so", "liblikwid.so.5",
+    "liblikwid.so.4" };
+
+template<typename F>
+static bool load_symbol(void *library, const char *symbol, F *function) {
+  *function = reinterpret_cast<F>(dlsym(library, symbol));
+  if (*function == nullptr) {
+    LDEBUGF("LIKWID has no %s", symbol);
+  }
+  return *function != nullptr;
+}
+
+bool LikwidBackend::loadLibrary(void) {
+  for (const char *library : LIKWID_LIBRARIES) {
+    _library = dlopen(library, RTLD_NOW | RTLD_LOCAL);
+    if (_library != nullptr) {
+      break;
+    }
+  }
+  if (_library == nullptr) {
+    LDEBUG("LIKWID is not installed");
+    return false;
+  }
+  bool ok = load_symbol(_library, "topology_init", &_topology_init)
+      && load_symbol(_library, "topology_finalize", &_topology_finalize)
+      && load_symbol(_library, "affinity_init", &_affinity_init)
+      && load_symbol(_library, "affinity_finalize", &_affinity_finalize)
+      && load_symbol(_library, "perfmon_init", &_perfmon_init)
+      && load_symbol(_library, "perfmon_finalize", &_perfmon_finalize)
+      && load_symbol(_library, "perfmon_addEventSet", &_perfmon_addEventSet)
+      && load_symbol(_library, "perfmon_setupCounters",
+                     &_perfmon_setupCounters)
+      && load_symbol(_library, "perfmon_startCounters",
+                     &_perfmon_startCounters)
+      && load_symbol(_library, "perfmon_stopCounters", &_perfmon_stopCounters)
+      && load_symbol(_library, "perfmon_getResult", &_perfmon_getResult);
+  if (!ok) {
+    dlclose(_library);
+    _library = nullptr;
+  }
+  return ok;
+}
+
+LikwidBackend::~LikwidBackend() {
+  stop();
+}
+
+// monitors every worker CPU we may run on
+bool LikwidBackend::start(const Topology &topology) {
+  _cpus = workerCpus(topology);
+  _stalls.assign(topology.numNodes(), 0);
+  if (_cpus.empty()) {
+    LDEBUG("no worker CPUs to count on");
+    return false;
+  }
+  if (!loadLibrary()) {
+    return false;
+  }
+  if (_topology_init() < 0) {
+    LDEBUG("Failed to initialize LIKWID's topology module");
+    dlclose(_library);
+    _library = nullptr;
+    return false;
+  }
+  _affinity_init();
+
+  // the event set for this CPU model (see EventTable)
+  CpuModel cpu = CpuModel::current();
+  const char *events = likwid_stall_events(cpu);
+  bool ok = events != nullptr;
+  if (!ok) {
+    LDEBUGF("no LIKWID events for %s family %d model %d", cpu.vendor.c_str(),
+            cpu.family, cpu.model);
+  }
+  ok = ok && _perfmon_init(_cpus.size(), _cpus.data()) >= 0;
+  if (ok) {
+    _group = _perfmon_addEventSet(events);
+    ok = _group >= 0 && _perfmon_setupCounters(_group) >= 0
+        && _perfmon_startCounters() >= 0;
+    if (!ok) {
+      LDEBUGF("Failed to set up %s in LIKWID", events);
+      _perfmon_finalize();
+    }
+  }
+  if (!ok) {
+    _affinity_finalize();
+    _topology_finalize();
+    dlclose(_library);
+    _library = nullptr;
+    return false;
+  }
+  LINFOF("counting %s with LIKWID on %zu CPUs", events, _cpus.size());
+  return true;
+}
+
+void LikwidBackend::stop() {
+  if (_library == nullptr) {
+    return;
+  }
+  _perfmon_stopCounters();
+  _perfmon_finalize();
+  _affinity_finalize();
+  _topology_finalize();
+  dlclose(_library);
+  _library = nullptr;
+}
+
+// LIKWID reports per interval: stop the counters, read, and restart them
+std::vector<double> LikwidBackend::readNodeStalls() {
+  if (_library == nullptr) {
+    return _stalls;
+  }
+  if (_perfmon_stopCounters() < 0) {
+    LWARN("Failed to stop the LIKWID counters");
+    return _stalls;
+  }
+  for (size_t i = 0; i < _cpus.size(); i++) {
+    _stalls[numa_node_of_cpu(_cpus[i])] += _perfmon_getResult(_group, 0, i);
+  }
+  if (_perfmon_startCounters() < 0) {
+    LWARN("Failed to restart the LIKWID counters");
+  }
+  return _stalls;
+}
+
+}  // namespace unstickymem
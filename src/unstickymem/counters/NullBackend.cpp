@@ -0,0 +1,21 @@
+#include "unstickymem/counters/NullBackend.hpp"
+
+namespace unstickymem {
+
+static CounterBackend::Registrar<NullBackend> registrar(
+    NullBackend::name(), NullBackend::description(), 0);
+
+bool NullBackend::start(const Topology &topology) {
+  _num_nodes = topology.numNodes();
+  LWARN("no performance counters: stall rates will be reported as zero");
+  return true;
+}
+
+void NullBackend::stop() {
+}
+
+std::vector<double> NullBackend::readNodeStalls() {
+  return std::vector<double>(_num_nodes, 0);
+}
+
+}  // namespace unstickymem
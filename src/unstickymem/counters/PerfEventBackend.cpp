@@ -0,0 +1,126 @@
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <numa.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "unstickymem/counters/PerfEventBackend.hpp"
+#include "unstickymem/counters/EventTable.hpp"
+
+namespace unstickymem {
+
+static CounterBackend::Registrar<PerfEventBackend> registrar(
+    PerfEventBackend::name(), PerfEventBackend::description(), 20);
+
+static int perf_event_paranoid(void) {
+  int level = -1;
+  FILE *f = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+  if (f != NULL) {
+    if (fscanf(f, "%d", &level) != 1) {
+      level = -1;
+    }
+    fclose(f);
+  }
+  return level;
+}
+
+PerfEventBackend::PerfEventBackend()
+    : PerfEventBackend(stallEvents()) {
+}
+
+PerfEventBackend::PerfEventBackend(const std::vector<Event> &candidates)
+    : _candidates(candidates) {
+}
+
+PerfEventBackend::~PerfEventBackend() {
+  stop();
+}
+
+// the best stall event of this CPU model (see EventTable)
+std::vector<PerfEventBackend::Event> PerfEventBackend::stallEvents(void) {
+  return counter_events(CounterMetric::STALLS);
+}
+
+// opens the event on each CPU: all or nothing
+bool PerfEventBackend::open(const Event &event, const std::vector<int> &cpus) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = event.type;
+  attr.config = event.config;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+      | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+
+  for (int cpu : cpus) {
+    // this process (and its future threads), while on this CPU
+    int fd = syscall(SYS_perf_event_open, &attr, 0, cpu, -1,
+                     PERF_FLAG_FD_CLOEXEC);
+    if (fd < 0) {
+      LDEBUGF("could not open %s on CPU %d: %s (perf_event_paranoid is %d)",
+              event.name.c_str(), cpu, strerror(errno),
+              perf_event_paranoid());
+      close();
+      return false;
+    }
+    _counters.push_back({ cpu, numa_node_of_cpu(cpu), fd, 0, 0, 0, 0 });
+  }
+  return true;
+}
+
+void PerfEventBackend::close(void) {
+  for (Counter &counter : _counters) {
+    ::close(counter.fd);
+  }
+  _counters.clear();
+}
+
+bool PerfEventBackend::start(const Topology &topology) {
+  std::vector<int> cpus = workerCpus(topology);
+  _num_nodes = topology.numNodes();
+  if (cpus.empty()) {
+    LDEBUG("no worker CPUs to count on");
+    return false;
+  }
+  for (const Event &event : _candidates) {
+    if (open(event, cpus)) {
+      LINFOF("counting %s with perf_event_open on %zu CPUs",
+             event.name.c_str(), cpus.size());
+      return true;
+    }
+  }
+  return false;
+}
+
+void PerfEventBackend::stop() {
+  close();
+}
+
+// each CPU's delta is scaled by the time its counter actually ran in the
+// interval (they may be multiplexed, each differently)
+std::vector<double> PerfEventBackend::readNodeStalls() {
+  std::vector<double> stalls(_num_nodes, 0);
+  for (Counter &counter : _counters) {
+    uint64_t values[3];
+    if (read(counter.fd, values, sizeof(values)) == sizeof(values)) {
+      uint64_t count = values[0] - counter.count;
+      uint64_t enabled = values[1] - counter.enabled;
+      uint64_t running = values[2] - counter.running;
+      if (running > 0) {
+        counter.stalls += static_cast<double>(count) * enabled / running;
+      }
+      counter.count = values[0];
+      counter.enabled = values[1];
+      counter.running = values[2];
+    }
+    stalls[counter.node] += counter.stalls;
+  }
+  return stalls;
+}
+
+}  // namespace unstickymem
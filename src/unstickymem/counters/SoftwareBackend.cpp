@@ -0,0 +1,241 @@
+#include <dirent.h>
+#include <time.h>
+
+#include <cstdio>
+#include <cstring>
+#include <numeric>
+
+#include "unstickymem/PerformanceCounters.hpp"
+#include "unstickymem/counters/SoftwareBackend.hpp"
+
+namespace unstickymem {
+
+// opt-in: without NUMA balancing, the proxy sees the whole machine
+static CounterBackend::Registrar<SoftwareBackend> registrar(
+    SoftwareBackend::name(), SoftwareBackend::description(), -1);
+
+static double clock_ns(clockid_t clock) {
+  struct timespec ts;
+  clock_gettime(clock, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool numa_balancing_enabled(void) {
+  int enabled = 0;
+  FILE *f = fopen("/proc/sys/kernel/numa_balancing", "r");
+  if (f != NULL) {
+    if (fscanf(f, "%d", &enabled) != 1) {
+      enabled = 0;
+    }
+    fclose(f);
+  }
+  return enabled != 0;
+}
+
+// the recent NUMA faults of a thread, by the node of the memory: remote if
+// the thread is on another node
+static bool read_thread_faults(const char *tid, std::vector<double> *accesses,
+                               std::vector<double> *remote) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/self/task/%s/sched", tid);
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return false;
+  }
+  char line[256];
+  int current_node = -1, node;
+  unsigned long task_private, task_shared;
+  bool found = false;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "current_node=%d", &current_node) == 1) {
+      continue;
+    }
+    if (sscanf(line, "numa_faults node=%d task_private=%lu task_shared=%lu",
+               &node, &task_private, &task_shared) == 3
+        && node >= 0 && static_cast<size_t>(node) < accesses->size()) {
+      (*accesses)[node] += task_private + task_shared;
+      if (node != current_node) {
+        (*remote)[node] += task_private + task_shared;
+      }
+      found = true;
+    }
+  }
+  fclose(f);
+  return found;
+}
+
+static bool read_task_faults(std::vector<double> *accesses,
+                             std::vector<double> *remote) {
+  DIR *tasks = opendir("/proc/self/task");
+  if (tasks == NULL) {
+    return false;
+  }
+  bool found = false;
+  struct dirent *task;
+  while ((task = readdir(tasks)) != NULL) {
+    if (task->d_name[0] != '.') {
+      found = read_thread_faults(task->d_name, accesses, remote) || found;
+    }
+  }
+  closedir(tasks);
+  return found;
+}
+
+// allocations made on each node by processes on the same/another node: all
+// the processes of the machine, not only ours
+static bool read_numastat(const std::vector<int> &nodes,
+                          std::vector<double> *accesses,
+                          std::vector<double> *remote) {
+  for (int node : nodes) {
+    char path[64];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/numastat",
+             node);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+      return false;
+    }
+    char line[256];
+    unsigned long value;
+    while (fgets(line, sizeof(line), f) != NULL) {
+      if (sscanf(line, "local_node %lu", &value) == 1) {
+        (*accesses)[node] += value;
+      } else if (sscanf(line, "other_node %lu", &value) == 1) {
+        (*accesses)[node] += value;
+        (*remote)[node] += value;
+      }
+    }
+    fclose(f);
+  }
+  return true;
+}
+
+// the same, for the whole system: spread evenly over the nodes
+static bool read_vmstat(const std::vector<int> &nodes,
+                        std::vector<double> *accesses,
+                        std::vector<double> *remote) {
+  FILE *f = fopen("/proc/vmstat", "r");
+  if (f == NULL) {
+    return false;
+  }
+  char line[256];
+  unsigned long value;
+  double local = -1, other = -1;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    if (sscanf(line, "numa_local %lu", &value) == 1) {
+      local = value;
+    } else if (sscanf(line, "numa_other %lu", &value) == 1) {
+      other = value;
+    }
+  }
+  fclose(f);
+  if (local < 0 || other < 0 || nodes.empty()) {
+    return false;
+  }
+  for (int node : nodes) {
+    (*accesses)[node] += (local + other) / nodes.size();
+    (*remote)[node] += other / nodes.size();
+  }
+  return true;
+}
+
+bool SoftwareBackend::readAccesses(std::vector<double> *accesses,
+                                   std::vector<double> *remote) const {
+  accesses->assign(_stalls.size(), 0);
+  remote->assign(_stalls.size(), 0);
+  switch (_source) {
+    case LocalitySource::TASK_FAULTS:
+      return read_task_faults(accesses, remote);
+    case LocalitySource::NUMASTAT:
+      return read_numastat(_memory_nodes, accesses, remote);
+    case LocalitySource::VMSTAT:
+      return read_vmstat(_memory_nodes, accesses, remote);
+  }
+  return false;
+}
+
+bool SoftwareBackend::start(const Topology &topology) {
+  _memory_nodes = topology.memoryNodes();
+  _stalls.assign(topology.numNodes(), 0);
+  _remote_share.assign(topology.numNodes(), 0);
+
+  // the most precise source this kernel gives us
+  _started = false;
+  for (LocalitySource source : LocalitySource::_values()) {
+    if (source == +LocalitySource::TASK_FAULTS && !numa_balancing_enabled()) {
+      continue;
+    }
+    _source = source;
+    if (readAccesses(&_prev_accesses, &_prev_remote)) {
+      _started = true;
+      break;
+    }
+  }
+  if (!_started) {
+    LDEBUG("no NUMA statistics in /proc or /sys");
+    return false;
+  }
+  _prev_cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+  _start_ns = clock_ns(CLOCK_MONOTONIC);
+  _start_tsc = readtsc();
+  LINFOF("estimating stalls from the CPU time and %s", _source._to_string());
+  if (_source != +LocalitySource::TASK_FAULTS) {
+    LWARN("no NUMA balancing: the locality comes from the allocations of "
+          "every process on the machine");
+  }
+  return true;
+}
+
+void SoftwareBackend::stop() {
+  _started = false;
+  std::fill(_stalls.begin(), _stalls.end(), 0);
+}
+
+std::vector<double> SoftwareBackend::readNodeStalls() {
+  if (!_started) {
+    return _stalls;
+  }
+  std::vector<double> accesses, remote;
+  if (readAccesses(&accesses, &remote)) {
+    // NUMA balancing faults already are a recent window (the kernel decays
+    // them); the allocation statistics are totals
+    if (_source != +LocalitySource::TASK_FAULTS) {
+      for (size_t node = 0; node < accesses.size(); node++) {
+        double a = accesses[node], r = remote[node];
+        accesses[node] -= _prev_accesses[node];
+        remote[node] -= _prev_remote[node];
+        _prev_accesses[node] = a;
+        _prev_remote[node] = r;
+      }
+    }
+    // no accesses in the interval: keep the previous shares
+    double total = std::accumulate(accesses.begin(), accesses.end(), 0.0);
+    if (total > 0) {
+      for (size_t node = 0; node < remote.size(); node++) {
+        _remote_share[node] = remote[node] / total;
+      }
+    }
+  }
+
+  // CPU time in TSC cycles, at the TSC rate measured since start
+  double cpu_ns = clock_ns(CLOCK_PROCESS_CPUTIME_ID);
+  double elapsed_ns = clock_ns(CLOCK_MONOTONIC) - _start_ns;
+  double cycles_per_ns = elapsed_ns > 0 ?
+      (readtsc() - _start_tsc) / elapsed_ns : 0;
+  double cycles = (cpu_ns - _prev_cpu_ns) * cycles_per_ns;
+  _prev_cpu_ns = cpu_ns;
+
+  for (size_t node = 0; node < _stalls.size(); node++) {
+    _stalls[node] += cycles * _remote_share[node];
+  }
+  return _stalls;
+}
+
+double SoftwareBackend::locality(void) const {
+  return 1 - std::accumulate(_remote_share.begin(), _remote_share.end(), 0.0);
+}
+
+LocalitySource SoftwareBackend::source(void) const {
+  return _source;
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,119 @@
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "unstickymem/PerformanceCounters.hpp"
+#include "unstickymem/counters/ThreadCounter.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+ThreadCounter::ThreadCounter(
+    const std::vector<PerfEventBackend::Event> &candidates) {
+  for (const PerfEventBackend::Event &event : candidates) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+        | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    // this thread, on any CPU
+    _fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC);
+    if (_fd >= 0) {
+      break;
+    }
+    LDEBUGF("could not open %s: %s", event.name.c_str(), strerror(errno));
+  }
+  if (_fd < 0) {
+    return;
+  }
+
+  // just the control page, no sample buffer
+  void *page = WRAP(mmap)(NULL, sysconf(_SC_PAGESIZE), PROT_READ, MAP_SHARED,
+                          _fd, 0);
+  if (page == MAP_FAILED) {
+    LDEBUGF("could not map the counter: %s", strerror(errno));
+  } else {
+    _page = reinterpret_cast<struct perf_event_mmap_page*>(page);
+  }
+}
+
+ThreadCounter::~ThreadCounter() {
+  if (_page != nullptr) {
+    WRAP(munmap)(_page, sysconf(_SC_PAGESIZE));
+  }
+  if (_fd >= 0) {
+    close(_fd);
+  }
+}
+
+bool ThreadCounter::isOpen(void) const {
+  return _fd >= 0;
+}
+
+bool ThreadCounter::userspaceReads(void) const {
+  return _page != nullptr && _page->cap_user_rdpmc && _page->index != 0;
+}
+
+// the protocol described in linux/perf_event.h: retry until the kernel did
+// not update the page (lock) while we were reading it
+double ThreadCounter::read(void) const {
+  if (_page == nullptr) {
+    return readSyscall();
+  }
+  uint32_t seq, index;
+  uint64_t count, enabled, running;
+  do {
+    seq = _page->lock;
+    __sync_synchronize();
+
+    index = _page->index;
+    if (!_page->cap_user_rdpmc || index == 0) {
+      return readSyscall();
+    }
+    enabled = _page->time_enabled;
+    running = _page->time_running;
+    if (_page->cap_user_time && enabled != running) {
+      // time since the kernel last updated the page
+      uint64_t cycles = readtsc();
+      uint64_t quot = cycles >> _page->time_shift;
+      uint64_t rem = cycles & ((1ULL << _page->time_shift) - 1);
+      uint64_t delta = _page->time_offset + quot * _page->time_mult
+          + ((rem * _page->time_mult) >> _page->time_shift);
+      enabled += delta;
+      running += delta;
+    }
+
+    // the hardware counter is pmc_width bits wide: sign extend it
+    int64_t pmc = readpmc(index - 1);
+    pmc <<= 64 - _page->pmc_width;
+    pmc >>= 64 - _page->pmc_width;
+    count = _page->offset + pmc;
+
+    __sync_synchronize();
+  } while (_page->lock != seq);
+
+  if (running == 0) {
+    return 0;
+  }
+  return enabled == running ? static_cast<double>(count) :
+                              static_cast<double>(count) * enabled / running;
+}
+
+double ThreadCounter::readSyscall(void) const {
+  uint64_t values[3];
+  if (_fd < 0 || ::read(_fd, values, sizeof(values)) != sizeof(values)
+      || values[2] == 0) {
+    return 0;
+  }
+  return static_cast<double>(values[0]) * values[1] / values[2];
+}
+
+}  // namespace unstickymem
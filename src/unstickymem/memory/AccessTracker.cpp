@@ -0,0 +1,285 @@
+#include <fcntl.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/memory/AccessTracker.hpp"
+#include "unstickymem/placement/PlacementEngine.hpp"
+
+namespace unstickymem {
+
+static const char *PAGEMAP = "/proc/self/pagemap";
+static const char *PAGE_IDLE_BITMAP = "/sys/kernel/mm/page_idle/bitmap";
+static const char *CLEAR_REFS = "/proc/self/clear_refs";
+
+// see Documentation/admin-guide/mm/pagemap.rst
+static const uint64_t PAGEMAP_PRESENT = 1ULL << 63;
+static const uint64_t PAGEMAP_SOFT_DIRTY = 1ULL << 55;
+static const uint64_t PAGEMAP_PFN = (1ULL << 55) - 1;
+
+// pagemap entries read at once
+static const size_t PAGEMAP_BATCH = 1 << 12;
+
+// the page frames of the present pages (0 for the others)
+static std::vector<uint64_t> present_frames(
+    const std::vector<uint64_t> &entries) {
+  std::vector<uint64_t> frames(entries.size(), 0);
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (entries[i] & PAGEMAP_PRESENT) {
+      frames[i] = entries[i] & PAGEMAP_PFN;
+    }
+  }
+  return frames;
+}
+
+// the (sorted) words of the idle bitmap that hold these frames
+static std::vector<uint64_t> bitmap_words(const std::vector<uint64_t> &frames) {
+  std::vector<uint64_t> words;
+  for (uint64_t frame : frames) {
+    if (frame != 0) {
+      words.push_back(frame / 64);
+    }
+  }
+  std::sort(words.begin(), words.end());
+  words.erase(std::unique(words.begin(), words.end()), words.end());
+  return words;
+}
+
+// the bitmap is read and written in 8-byte words: consecutive words are
+// transferred with a single call
+template<typename F>
+static void for_each_word_run(const std::vector<uint64_t> &words, F f) {
+  for (size_t first = 0; first < words.size();) {
+    size_t last = first + 1;
+    while (last < words.size() && words[last] == words[last - 1] + 1) {
+      last++;
+    }
+    f(first, last - first);
+    first = last;
+  }
+}
+
+AccessTracker::AccessTracker(size_t chunk_size)
+    : _chunk_size(std::max<size_t>(chunk_size & PAGE_MASK, PAGE_SIZE)) {
+}
+
+AccessTracker::~AccessTracker() {
+  if (_pagemap >= 0) {
+    close(_pagemap);
+  }
+  if (_bitmap >= 0) {
+    close(_bitmap);
+  }
+}
+
+bool AccessTracker::readPagemap(uintptr_t start, size_t pages,
+                                std::vector<uint64_t> *entries) const {
+  entries->resize(pages);
+  size_t bytes = pages * sizeof(uint64_t);
+  off_t offset = start / PAGE_SIZE * sizeof(uint64_t);
+  if (pread(_pagemap, entries->data(), bytes, offset)
+      != static_cast<ssize_t>(bytes)) {
+    LDEBUGF("could not read the pagemap of %p: %s",
+            reinterpret_cast<void*>(start), strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool AccessTracker::clearSoftDirty(void) const {
+  int fd = open(CLEAR_REFS, O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = write(fd, "4", 1) == 1;
+  close(fd);
+  return ok;
+}
+
+// checks that a page we just wrote to shows up as accessed
+bool AccessTracker::probe(AccessSource source) {
+  static volatile char page[1 << 16];  // holds at least one whole page
+  uintptr_t address = PAGE_ALIGN_UP(reinterpret_cast<uintptr_t>(page));
+  std::vector<uint64_t> entries;
+  page[address - reinterpret_cast<uintptr_t>(page)] = 1;
+  _source = source;
+  mark(address, PAGE_SIZE);
+  page[address - reinterpret_cast<uintptr_t>(page)] = 2;
+  bool ok = readPagemap(address, 1, &entries)
+      && (entries[0] & PAGEMAP_PRESENT);
+  if (ok && source == +AccessSource::IDLE_PAGES) {
+    // without CAP_SYS_ADMIN the page frames read as zero
+    ok = (entries[0] & PAGEMAP_PFN) != 0;
+  } else if (ok) {
+    ok = (entries[0] & PAGEMAP_SOFT_DIRTY) != 0;
+  }
+  collect(address, PAGE_SIZE);
+  ok = ok && heat(address) > 0;
+  reset();
+  _source = ok ? source : +AccessSource::NONE;
+  return ok;
+}
+
+bool AccessTracker::start(bool soft_dirty) {
+  _pagemap = open(PAGEMAP, O_RDONLY | O_CLOEXEC);
+  if (_pagemap < 0) {
+    LDEBUGF("could not open %s: %s", PAGEMAP, strerror(errno));
+    return false;
+  }
+  _bitmap = open(PAGE_IDLE_BITMAP, O_RDWR | O_CLOEXEC);
+  if (_bitmap >= 0 && probe(AccessSource::IDLE_PAGES)) {
+    return true;
+  }
+  LDEBUG("idle page tracking is not available");
+  if (!soft_dirty) {
+    return false;
+  }
+  if (probe(AccessSource::SOFT_DIRTY)) {
+    return true;
+  }
+  LDEBUG("soft-dirty bits are not available");
+  return false;
+}
+
+AccessSource AccessTracker::source(void) const {
+  return _source;
+}
+
+size_t AccessTracker::chunkSize(void) const {
+  return _chunk_size;
+}
+
+// writing a bit marks its page idle; zero bits leave the others alone
+void AccessTracker::mark(uintptr_t start, size_t length) {
+  if (_source == +AccessSource::SOFT_DIRTY) {
+    clearSoftDirty();
+    return;
+  }
+  if (_source != +AccessSource::IDLE_PAGES) {
+    return;
+  }
+  std::vector<uint64_t> entries;
+  start = PAGE_ALIGN_DOWN(start);
+  for (uintptr_t batch = start; batch < start + length;
+      batch += PAGEMAP_BATCH * PAGE_SIZE) {
+    size_t pages = std::min((start + length - batch + PAGE_SIZE - 1)
+                            / PAGE_SIZE, PAGEMAP_BATCH);
+    if (!readPagemap(batch, pages, &entries)) {
+      continue;
+    }
+    std::vector<uint64_t> frames = present_frames(entries);
+    std::vector<uint64_t> words = bitmap_words(frames);
+    std::vector<uint64_t> bits(words.size(), 0);
+    for (uint64_t frame : frames) {
+      if (frame != 0) {
+        size_t i = std::lower_bound(words.begin(), words.end(), frame / 64)
+            - words.begin();
+        bits[i] |= 1ULL << (frame % 64);
+      }
+    }
+    for_each_word_run(words, [this, &words, &bits](size_t i, size_t count) {
+      pwrite(_bitmap, &bits[i], count * sizeof(uint64_t),
+             words[i] * sizeof(uint64_t));
+    });
+  }
+}
+
+// a page is accessed if it is present and no longer idle (or soft-dirty).
+// pages faulted in during the window were never marked, so they count too
+void AccessTracker::collect(uintptr_t start, size_t length) {
+  if (_source == +AccessSource::NONE) {
+    return;
+  }
+  std::vector<uint64_t> entries;
+  start = PAGE_ALIGN_DOWN(start);
+  for (uintptr_t batch = start; batch < start + length;
+      batch += PAGEMAP_BATCH * PAGE_SIZE) {
+    size_t pages = std::min((start + length - batch + PAGE_SIZE - 1)
+                            / PAGE_SIZE, PAGEMAP_BATCH);
+    if (!readPagemap(batch, pages, &entries)) {
+      continue;
+    }
+    std::vector<uint64_t> frames = present_frames(entries);
+    std::vector<uint64_t> words, bits;
+    if (_source == +AccessSource::IDLE_PAGES) {
+      words = bitmap_words(frames);
+      bits.assign(words.size(), ~0ULL);
+      for_each_word_run(words, [this, &words, &bits](size_t i, size_t count) {
+        pread(_bitmap, &bits[i], count * sizeof(uint64_t),
+              words[i] * sizeof(uint64_t));
+      });
+    }
+
+    uintptr_t chunk = 0;
+    uint64_t accessed = 0;
+    for (size_t page = 0; page < pages; page++) {
+      uintptr_t address = batch + page * PAGE_SIZE;
+      if (address / _chunk_size * _chunk_size != chunk) {
+        add(chunk, accessed);
+        chunk = address / _chunk_size * _chunk_size;
+        accessed = 0;
+      }
+      if (_source == +AccessSource::SOFT_DIRTY) {
+        accessed += (entries[page] & PAGEMAP_PRESENT)
+            && (entries[page] & PAGEMAP_SOFT_DIRTY);
+      } else if (frames[page] != 0) {
+        size_t i = std::lower_bound(words.begin(), words.end(),
+                                    frames[page] / 64) - words.begin();
+        accessed += !((bits[i] >> (frames[page] % 64)) & 1);
+      }
+    }
+    add(chunk, accessed);
+  }
+}
+
+void AccessTracker::sample(const SegmentTree &segments, useconds_t window) {
+  if (_source == +AccessSource::NONE) {
+    usleep(window);
+    return;
+  }
+  if (_source == +AccessSource::SOFT_DIRTY) {
+    clearSoftDirty();
+  }
+  for (const MemorySegment &segment : segments) {
+    if (_source == +AccessSource::IDLE_PAGES
+        && segment.length() > PlacementEngine::MIN_SEGMENT_LENGTH) {
+      mark(reinterpret_cast<uintptr_t>(segment.pageAlignedStartAddress()),
+           segment.pageAlignedLength());
+    }
+  }
+  usleep(window);
+  for (const MemorySegment &segment : segments) {
+    if (segment.length() > PlacementEngine::MIN_SEGMENT_LENGTH) {
+      collect(reinterpret_cast<uintptr_t>(segment.pageAlignedStartAddress()),
+              segment.pageAlignedLength());
+    }
+  }
+}
+
+void AccessTracker::add(uintptr_t address, uint64_t accesses) {
+  if (accesses > 0) {
+    _heat[address / _chunk_size * _chunk_size] += accesses;
+  }
+}
+
+uint64_t AccessTracker::heat(uintptr_t address) const {
+  auto chunk = _heat.find(address / _chunk_size * _chunk_size);
+  return chunk == _heat.end() ? 0 : chunk->second;
+}
+
+bool AccessTracker::hasSamples(void) const {
+  return !_heat.empty();
+}
+
+size_t AccessTracker::hotChunks(void) const {
+  return _heat.size();
+}
+
+void AccessTracker::reset(void) {
+  _heat.clear();
+}
+
+}  // namespace unstickymem
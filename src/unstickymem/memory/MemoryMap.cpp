@@ -4,6 +4,7 @@
 #include <numeric>
 #include <iostream>
 
+#include "unstickymem/PagePlacement.hpp"
 #include "unstickymem/Runtime.hpp"
 #include "unstickymem/memory/MemoryMap.hpp"
 #include "unstickymem/Logger.hpp"
@@ -21,7 +22,9 @@ MemoryMap::MemoryMap() {
   /*Manager *segment_manager = _segment.get_segment_manager();
   _segments = _segment.construct < SegmentsList
       > ("unstickymem")(segment_manager);*/
-  _segments = new std::list<MemorySegment>();
+  bool found_stack = false;
+  bool found_text = false;
+  bool found_data = false;
 
   // open maps file
   FILE *maps = fopen("/proc/self/maps", "r");
@@ -34,33 +37,40 @@ MemoryMap::MemoryMap() {
     MemorySegment s(line);
     if (s.name() == "[heap]") {
       // found the heap!
-      _segments->emplace_back(s.startAddress(), s.endAddress(), "heap");
-      _heap = &_segments->back();
-      Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+      MemorySegment heap(s.startAddress(), s.endAddress(), "heap");
+      _segments.insert(heap);
+      _heap_start = heap.startAddress();
+      _heap_end = heap.endAddress();
+      Runtime::getInstance().getMode()->processSegmentAddition(heap);
     } else if (s.name() == "[stack]") {
       // found the stack!
-      _segments->emplace_back(s.startAddress(), s.endAddress(), "stack");
-      _stack = &_segments->back();
+      _segments.insert(
+          MemorySegment(s.startAddress(), s.endAddress(), "stack"));
+      found_stack = true;
     } else if (s.contains(&etext - 1)) {
       // found the text segment (read-only data)
-      _segments->emplace_back(s.startAddress(), s.endAddress(), "text");
-      _text = &_segments->back();
-      Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+      MemorySegment text(s.startAddress(), s.endAddress(), "text");
+      _segments.insert(text);
+      found_text = true;
+      Runtime::getInstance().getMode()->processSegmentAddition(text);
     } else if (s.contains(&edata - 1)) {
       // found the data segment (global variables)
-      _segments->emplace_back(s.startAddress(), s.endAddress(), "data");
-      _data = &_segments->back();
-      Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+      MemorySegment data(s.startAddress(), s.endAddress(), "data");
+      _segments.insert(data);
+      found_data = true;
+      Runtime::getInstance().getMode()->processSegmentAddition(data);
     } else if (s.name() == "") {
-      _segments->emplace_back(s.startAddress(), s.endAddress(), "anonymous");
-      Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+      MemorySegment anonymous(s.startAddress(), s.endAddress(), "anonymous");
+      _segments.insert(anonymous);
+      Runtime::getInstance().getMode()->processSegmentAddition(anonymous);
     }
   }
 
-  DIEIF(_heap == nullptr, "didnt find the heap!");
-  DIEIF(_stack == nullptr, "didnt find the stack!");
-  DIEIF(_text == nullptr, "didnt find the text segment!");
-  DIEIF(_data == nullptr, "didnt find the data segment!");
+  DIEIF(_heap_start == nullptr, "didnt find the heap!");
+  DIEIF(!found_stack, "didnt find the stack!");
+  DIEIF(!found_text, "didnt find the text segment!");
+  DIEIF(!found_data, "didnt find the data segment!");
+  publish();
 
   // cleanup
   WRAP(free)(line);
@@ -81,35 +91,61 @@ MemoryMap& MemoryMap::getInstance(void) {
   return *object;
 }
 
+bool MemoryMap::inHeap(void *addr) const {
+  return addr >= _heap_start && addr <= _heap_end.load();
+}
+
+// must be called with _segments_lock held
+// the placement threads may still be walking an older snapshot: they keep
+// their nodes alive, so writers never have to wait for them
+void MemoryMap::publish(void) {
+  std::atomic_store(&_snapshot,
+                    std::shared_ptr<const SegmentTree>(
+                        std::make_shared<SegmentTree>(_segments)));
+}
+
+std::shared_ptr<const SegmentTree> MemoryMap::snapshot(void) const {
+  return std::atomic_load(&_snapshot);
+}
+
 void MemoryMap::print(void) const {
-  for (auto &segment : *_segments) {
+  for (auto &segment : *snapshot()) {
     segment.print();
   }
 }
 
+// the heap is only refreshed on the tracking path and before placing pages:
+// small allocations grow it behind our back (see the malloc fast path)
 void MemoryMap::updateHeap(void) {
   void *addr = WRAP(sbrk)(0);
-  if (_heap->endAddress() != addr) {
-    _heap->endAddress(WRAP(sbrk)(0));
+  if (_heap_end.load() != addr) {
+    std::scoped_lock lock(_segments_lock);
+    _heap_end = addr;
+    _segments.resize(_heap_start, addr);
+    publish();
     //Runtime::getInstance().getMode()->processSegmentAddition(*_heap);
   }
 }
 
+size_t MemoryMap::size(void) const {
+  return snapshot()->size();
+}
+
 // iterators
-SegmentsList::iterator MemoryMap::begin() noexcept {
-  return _segments->begin();
+SegmentTree::const_iterator MemoryMap::begin() const noexcept {
+  return snapshot()->begin();
 }
 
-SegmentsList::iterator MemoryMap::end() noexcept {
-  return _segments->end();
+SegmentTree::const_iterator MemoryMap::end() const noexcept {
+  return SegmentTree::const_iterator();
 }
 
-SegmentsList::const_iterator MemoryMap::cbegin() const noexcept {
-  return _segments->cbegin();
+SegmentTree::const_iterator MemoryMap::cbegin() const noexcept {
+  return begin();
 }
 
-SegmentsList::const_iterator MemoryMap::cend() const noexcept {
-  return _segments->cend();
+SegmentTree::const_iterator MemoryMap::cend() const noexcept {
+  return end();
 }
 
 void *MemoryMap::handle_malloc(size_t size) {
@@ -124,10 +160,12 @@ void *MemoryMap::handle_malloc(size_t size) {
   updateHeap();
 
   // if it was not placed in the heap, means it is a new region!
-  if (!_heap->contains(result)) {
+  if (!inHeap(result)) {
     std::scoped_lock lock(_segments_lock);
-    _segments->emplace_back(start, end, "malloc");
-    Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+    MemorySegment segment(start, end, "malloc");
+    _segments.insert(segment);
+    publish();
+    Runtime::getInstance().getMode()->processSegmentAddition(segment);
   }
   return result;
 }
@@ -144,36 +182,37 @@ void* MemoryMap::handle_calloc(size_t nmemb, size_t size) {
   updateHeap();
 
   // if it was not placed in the heap, means it is a new region!
-  if (!_heap->contains(result)) {
+  if (!inHeap(result)) {
     std::scoped_lock lock(_segments_lock);
-    _segments->emplace_back(start, end, "calloc");
-    Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+    MemorySegment segment(start, end, "calloc");
+    _segments.insert(segment);
+    publish();
+    Runtime::getInstance().getMode()->processSegmentAddition(segment);
   }
   return result;
 }
 
 void* MemoryMap::handle_realloc(void *ptr, size_t size) {
   // check if object is in heap before realloc
-  bool was_in_heap = _heap->contains(ptr);
+  bool was_in_heap = inHeap(ptr);
 
   // do the realloc
   void *result = WRAP(realloc)(ptr, size);
 
   // check if object is in heap after realloc
   updateHeap();
-  bool is_in_heap = _heap->contains(result);
+  bool is_in_heap = inHeap(result);
 
   // determine if object before was outside the heap
   if (!was_in_heap) {
     std::scoped_lock lock(_segments_lock);
-    _segments->remove_if([ptr](const MemorySegment& s) {
-      if (s.contains(ptr)) {
-        std::shared_ptr<Mode> mode = Runtime::getInstance().getMode();
-        mode->processSegmentRemoval(s);
-        return true;
-      }
-      return false;
-    });
+    std::vector<MemorySegment> removed = _segments.extract(ptr);
+    if (!removed.empty()) {
+      publish();
+    }
+    for (auto &s : removed) {
+      Runtime::getInstance().getMode()->processSegmentRemoval(s);
+    }
   }
 
   if (!is_in_heap) {
@@ -183,8 +222,10 @@ void* MemoryMap::handle_realloc(void *ptr, size_t size) {
         + size - 1);
     // insert the new segment
     std::scoped_lock lock(_segments_lock);
-    _segments->emplace_back(start, end, "realloc");
-    Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+    MemorySegment segment(start, end, "realloc");
+    _segments.insert(segment);
+    publish();
+    Runtime::getInstance().getMode()->processSegmentAddition(segment);
   }
   return result;
 }
@@ -196,7 +237,7 @@ void* MemoryMap::handle_reallocarray(void *ptr, size_t nmemb, size_t size) {
 }
 
 void MemoryMap::handle_free(void *ptr) {
-  bool was_in_heap = _heap->contains(ptr);
+  bool was_in_heap = inHeap(ptr);
   WRAP(free)(ptr);
 
   // check where the segment was allocated
@@ -205,14 +246,13 @@ void MemoryMap::handle_free(void *ptr) {
   } else {
     // if not in heap, remove the mapped segment
     std::scoped_lock lock(_segments_lock);
-    _segments->remove_if([ptr](const MemorySegment& s) {
-      if (s.contains(ptr)) {
-        std::shared_ptr<Mode> mode = Runtime::getInstance().getMode();
-        mode->processSegmentRemoval(s);
-        return true;
-      }
-      return false;
-    });
+    std::vector<MemorySegment> removed = _segments.extract(ptr);
+    if (!removed.empty()) {
+      publish();
+    }
+    for (auto &s : removed) {
+      Runtime::getInstance().getMode()->processSegmentRemoval(s);
+    }
   }
 }
 
@@ -230,10 +270,12 @@ int MemoryMap::handle_posix_memalign(void **memptr, size_t alignment,
       - 1);
 
   // add the new region
-  if (!_heap->contains(*memptr)) {
+  if (!inHeap(*memptr)) {
     std::scoped_lock lock(_segments_lock);
-    _segments->emplace_back(start, end, "posix_memalign");
-    Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+    MemorySegment segment(start, end, "posix_memalign");
+    _segments.insert(segment);
+    publish();
+    Runtime::getInstance().getMode()->processSegmentAddition(segment);
   }
 
   return result;
@@ -250,26 +292,49 @@ void* MemoryMap::handle_mmap(void *addr, size_t length, int prot, int flags,
 
   // insert the new segment
   std::scoped_lock lock(_segments_lock);
-  _segments->emplace_back(start, end, "mmap");
-  Runtime::getInstance().getMode()->processSegmentAddition(_segments->back());
+  MemorySegment segment(start, end, "mmap");
+  _segments.insert(segment);
+  publish();
+  Runtime::getInstance().getMode()->processSegmentAddition(segment);
 
   // return the result
   return result;
 }
 
+// a segment unmapped in part is split: what is left mapped stays tracked,
+// and the mode is only told about the part that is gone
 int MemoryMap::handle_munmap(void *addr, size_t length) {
+  // unmap under the lock: otherwise a concurrent mmap may get the same
+  // addresses and have its new segment removed below
+  std::scoped_lock lock(_segments_lock);
   int result = WRAP(munmap)(addr, length);
+  if (result != 0) {
+    return result;
+  }
 
-  // remove the mapped region
-  std::scoped_lock lock(_segments_lock);
-  _segments->remove_if([addr](const MemorySegment& s) {
-    if (s.contains(addr)) {
-      std::shared_ptr<Mode> mode = Runtime::getInstance().getMode();
-      mode->processSegmentRemoval(s);
-      return true;
+  // the kernel unmaps whole pages
+  char *start = reinterpret_cast<char*>(addr);
+  char *last = start + PAGE_ALIGN_UP(length) - 1;
+  std::vector<MemorySegment> overlapping = _segments.extract(start, last);
+  std::vector<MemorySegment> removed;
+  for (auto &s : overlapping) {
+    char *s_start = reinterpret_cast<char*>(s.startAddress());
+    char *s_end = reinterpret_cast<char*>(s.endAddress());
+    if (s_start < start) {
+      _segments.insert(MemorySegment(s_start, start - 1, s.name()));
+    }
+    if (s_end > last) {
+      _segments.insert(MemorySegment(last + 1, s_end, s.name()));
     }
-    return false;
-  });
+    removed.emplace_back(std::max(s_start, start), std::min(s_end, last),
+                         s.name());
+  }
+  if (!removed.empty()) {
+    publish();
+  }
+  for (auto &s : removed) {
+    Runtime::getInstance().getMode()->processSegmentRemoval(s);
+  }
 
   return result;
 }
@@ -23,7 +23,7 @@ MemorySegment::MemorySegment(char *line) {
 
   // parse string
   DIEIF(
-      sscanf(line, "%lx-%lx %7s %lx %u:%u %lu %n%*[^\n]%n", &addr_start,
+      sscanf(line, "%lx-%lx %7s %lx %x:%x %lu %n%*[^\n]%n", &addr_start,
              &addr_end, perms_str, &offset, &deviceMajor, &deviceMinor, &inode,
              &name_start, &name_end) < 7,
       "FAILED TO PARSE");
@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <utility>
+
+#include "unstickymem/memory/SegmentTree.hpp"
+
+namespace unstickymem {
+
+SegmentTree::Node::Node(const MemorySegment &s, uint64_t i, NodePtr l,
+                        NodePtr r)
+    : segment(s),
+      id(i),
+      max_end(reinterpret_cast<uintptr_t>(s.endAddress())),
+      height(1 + std::max(SegmentTree::height(l), SegmentTree::height(r))),
+      left(std::move(l)),
+      right(std::move(r)) {
+  if (left) {
+    max_end = std::max(max_end, left->max_end);
+  }
+  if (right) {
+    max_end = std::max(max_end, right->max_end);
+  }
+}
+
+uintptr_t SegmentTree::Node::start() const {
+  return reinterpret_cast<uintptr_t>(segment.startAddress());
+}
+
+uintptr_t SegmentTree::Node::end() const {
+  return reinterpret_cast<uintptr_t>(segment.endAddress());
+}
+
+// iterators
+
+SegmentTree::const_iterator SegmentTree::begin() const noexcept {
+  return const_iterator(_root);
+}
+
+SegmentTree::const_iterator SegmentTree::end() const noexcept {
+  return const_iterator();
+}
+
+SegmentTree::const_iterator SegmentTree::cbegin() const noexcept {
+  return begin();
+}
+
+SegmentTree::const_iterator SegmentTree::cend() const noexcept {
+  return end();
+}
+
+size_t SegmentTree::size() const noexcept {
+  return _size;
+}
+
+bool SegmentTree::empty() const noexcept {
+  return _size == 0;
+}
+
+// public interface
+
+void SegmentTree::insert(const MemorySegment &segment) {
+  _root = insert(_root, segment, _next_id++);
+  _size++;
+}
+
+const MemorySegment* SegmentTree::find(void *addr) const {
+  uintptr_t a = reinterpret_cast<uintptr_t>(addr);
+  std::vector<const Node*> nodes;
+  overlapping(_root.get(), a, a, &nodes);
+  if (nodes.empty()) {
+    return nullptr;
+  }
+  return &nodes.front()->segment;
+}
+
+std::vector<MemorySegment> SegmentTree::containing(void *addr) const {
+  return overlapping(addr, addr);
+}
+
+std::vector<MemorySegment> SegmentTree::overlapping(void *start,
+                                                    void *end) const {
+  std::vector<const Node*> nodes;
+  overlapping(_root.get(), reinterpret_cast<uintptr_t>(start),
+              reinterpret_cast<uintptr_t>(end), &nodes);
+  std::vector<MemorySegment> result;
+  result.reserve(nodes.size());
+  for (const Node *node : nodes) {
+    result.push_back(node->segment);
+  }
+  return result;
+}
+
+std::vector<MemorySegment> SegmentTree::extract(void *addr) {
+  uintptr_t a = reinterpret_cast<uintptr_t>(addr);
+  return extractRange(a, a);
+}
+
+std::vector<MemorySegment> SegmentTree::extract(void *start, void *end) {
+  return extractRange(reinterpret_cast<uintptr_t>(start),
+                      reinterpret_cast<uintptr_t>(end));
+}
+
+bool SegmentTree::resize(void *start, void *end) {
+  NodePtr root = resize(_root, reinterpret_cast<uintptr_t>(start),
+                        reinterpret_cast<uintptr_t>(end));
+  if (root == _root) {
+    return false;
+  }
+  _root = std::move(root);
+  return true;
+}
+
+void SegmentTree::clear() {
+  _root.reset();
+  _size = 0;
+}
+
+// persistent AVL tree internals
+
+int SegmentTree::height(const NodePtr &node) {
+  return node ? node->height : 0;
+}
+
+SegmentTree::NodePtr SegmentTree::make(const MemorySegment &segment,
+                                       uint64_t id, NodePtr left,
+                                       NodePtr right) {
+  return std::make_shared<const Node>(segment, id, std::move(left),
+                                      std::move(right));
+}
+
+// builds a node from its parts, rotating if the subtrees are unbalanced
+SegmentTree::NodePtr SegmentTree::balance(const MemorySegment &segment,
+                                          uint64_t id, NodePtr left,
+                                          NodePtr right) {
+  if (height(left) > height(right) + 1) {
+    if (height(left->left) >= height(left->right)) {
+      return make(left->segment, left->id, left->left,
+                  make(segment, id, left->right, std::move(right)));
+    }
+    const NodePtr &pivot = left->right;
+    return make(pivot->segment, pivot->id,
+                make(left->segment, left->id, left->left, pivot->left),
+                make(segment, id, pivot->right, std::move(right)));
+  }
+  if (height(right) > height(left) + 1) {
+    if (height(right->right) >= height(right->left)) {
+      return make(right->segment, right->id,
+                  make(segment, id, std::move(left), right->left),
+                  right->right);
+    }
+    const NodePtr &pivot = right->left;
+    return make(pivot->segment, pivot->id,
+                make(segment, id, std::move(left), pivot->left),
+                make(right->segment, right->id, pivot->right, right->right));
+  }
+  return make(segment, id, std::move(left), std::move(right));
+}
+
+SegmentTree::NodePtr SegmentTree::insert(const NodePtr &root,
+                                         const MemorySegment &segment,
+                                         uint64_t id) {
+  if (root == nullptr) {
+    return make(segment, id, nullptr, nullptr);
+  }
+  // equal start addresses go right (ids are increasing)
+  if (segment.startAddress() < root->segment.startAddress()) {
+    return balance(root->segment, root->id, insert(root->left, segment, id),
+                   root->right);
+  }
+  return balance(root->segment, root->id, root->left,
+                 insert(root->right, segment, id));
+}
+
+SegmentTree::NodePtr SegmentTree::removeMin(const NodePtr &root,
+                                            NodePtr *min) {
+  if (root->left == nullptr) {
+    *min = root;
+    return root->right;
+  }
+  return balance(root->segment, root->id, removeMin(root->left, min),
+                 root->right);
+}
+
+SegmentTree::NodePtr SegmentTree::remove(const NodePtr &root, uintptr_t start,
+                                         uint64_t id) {
+  if (root == nullptr) {
+    return root;
+  }
+  if (start < root->start() || (start == root->start() && id < root->id)) {
+    return balance(root->segment, root->id, remove(root->left, start, id),
+                   root->right);
+  }
+  if (start > root->start() || id > root->id) {
+    return balance(root->segment, root->id, root->left,
+                   remove(root->right, start, id));
+  }
+  // found it: replace it by its successor
+  if (root->left == nullptr) {
+    return root->right;
+  }
+  if (root->right == nullptr) {
+    return root->left;
+  }
+  NodePtr successor;
+  NodePtr right = removeMin(root->right, &successor);
+  return balance(successor->segment, successor->id, root->left,
+                 std::move(right));
+}
+
+// returns the same root if no segment starts at `start`
+SegmentTree::NodePtr SegmentTree::resize(const NodePtr &root, uintptr_t start,
+                                         uintptr_t end) {
+  if (root == nullptr) {
+    return root;
+  }
+  if (start < root->start()) {
+    NodePtr left = resize(root->left, start, end);
+    return left == root->left ?
+        root : make(root->segment, root->id, std::move(left), root->right);
+  }
+  if (start > root->start()) {
+    NodePtr right = resize(root->right, start, end);
+    return right == root->right ?
+        root : make(root->segment, root->id, root->left, std::move(right));
+  }
+  MemorySegment segment = root->segment;
+  segment.endAddress(reinterpret_cast<void*>(end));
+  return make(segment, root->id, root->left, root->right);
+}
+
+void SegmentTree::overlapping(const Node *node, uintptr_t start, uintptr_t end,
+                              std::vector<const Node*> *result) {
+  // nothing in this subtree reaches the queried range
+  if (node == nullptr || node->max_end < start) {
+    return;
+  }
+  overlapping(node->left.get(), start, end, result);
+  // everything to the right starts after the queried range
+  if (node->start() > end) {
+    return;
+  }
+  if (node->end() >= start) {
+    result->push_back(node);
+  }
+  overlapping(node->right.get(), start, end, result);
+}
+
+std::vector<MemorySegment> SegmentTree::extractRange(uintptr_t start,
+                                                     uintptr_t end) {
+  std::vector<const Node*> nodes;
+  overlapping(_root.get(), start, end, &nodes);
+
+  // copy them out before removing (removal may free the nodes)
+  std::vector<MemorySegment> result;
+  std::vector<std::pair<uintptr_t, uint64_t>> keys;
+  result.reserve(nodes.size());
+  keys.reserve(nodes.size());
+  for (const Node *node : nodes) {
+    result.push_back(node->segment);
+    keys.emplace_back(node->start(), node->id);
+  }
+  for (auto &[key_start, key_id] : keys) {
+    _root = remove(_root, key_start, key_id);
+    _size--;
+  }
+  return result;
+}
+
+}  // namespace unstickymem
@@ -12,7 +12,9 @@
 #include "unstickymem/PerformanceCounters.hpp"
 #include "unstickymem/unstickymem.h"
 #include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Topology.hpp"
 #include "unstickymem/Logger.hpp"
+#include "unstickymem/memory/AccessTracker.hpp"
 #include "unstickymem/memory/MemoryMap.hpp"
 #include "unstickymem/mode/AdaptiveMode.hpp"
 
@@ -30,28 +32,58 @@ po::options_description AdaptiveMode::getOptions() {
       "UNSTICKYMEM_NUM_POLLS",
       po::value<unsigned int>(&_num_polls)->default_value(20),
       "How many measurements to make for each placement ratio")(
-      "UNSTICKYMEM_NUM_POLL_OUTLIERS",
-      po::value<unsigned int>(&_num_poll_outliers)->default_value(5),
-      "How many of the top-N and bottom-N measurements to discard")(
       "UNSTICKYMEM_POLL_SLEEP",
       po::value < useconds_t > (&_poll_sleep)->default_value(200000),
-      "Time (in microseconds) between measurements");
+      "Time (in microseconds) between measurements")(
+      "UNSTICKYMEM_POLL_PRECISION",
+      po::value<double>(&_poll_precision)->default_value(0.02),
+      "Stop measuring a ratio once the 95% confidence interval of its stall "
+      "rate is within this fraction of the mean (at most NUM_POLLS polls)")(
+      "UNSTICKYMEM_SIGNIFICANCE",
+      po::value<double>(&_significance)->default_value(0.05),
+      "Probability of wrongly deciding that a ratio is better or worse than "
+      "the best one so far")(
+      "UNSTICKYMEM_OBJECTIVE",
+      po::value < std::string > (&_objective)->default_value("stalls"),
+      "What to minimize: stalls (the stall rate), progress (the time per "
+      "operation reported by the application) or stalls_per_op")(
+      "UNSTICKYMEM_HOT_PAGES",
+      po::value<bool>(&_hot_pages)->default_value(true),
+      "Track which pages are accessed while waiting to start, and move the "
+      "hottest ones to the local node first")(
+      "UNSTICKYMEM_HOT_SOFT_DIRTY",
+      po::value<bool>(&_hot_soft_dirty)->default_value(false),
+      "Without idle page tracking, track the writes with the soft-dirty bits "
+      "(write-protects the whole process every window)")(
+      "UNSTICKYMEM_HOT_WINDOW",
+      po::value < useconds_t > (&_hot_window)->default_value(500000),
+      "Length (in microseconds) of each window sampling the page accesses");
   return mode_options;
 }
 
 void AdaptiveMode::printParameters() {
   LINFOF("UNSTICKYMEM_WAIT_START:         %lu", _wait_start);
   LINFOF("UNSTICKYMEM_NUM_POLLS:          %lu", _num_polls);
-  LINFOF("UNSTICKYMEM_NUM_POLL_OUTLIERS:  %lu", _num_poll_outliers);
   LINFOF("UNSTICKYMEM_POLL_SLEEP:         %lu", _poll_sleep);
+  LINFOF("UNSTICKYMEM_POLL_PRECISION:     %.3lf", _poll_precision);
+  LINFOF("UNSTICKYMEM_SIGNIFICANCE:       %.3lf", _significance);
+  LINFOF("UNSTICKYMEM_OBJECTIVE:          %s", _objective.c_str());
+  LINFOF("UNSTICKYMEM_HOT_PAGES:          %s", _hot_pages ? "yes" : "no");
+  LINFOF("UNSTICKYMEM_HOT_SOFT_DIRTY:     %s",
+         _hot_soft_dirty ? "yes" : "no");
+  LINFOF("UNSTICKYMEM_HOT_WINDOW:         %lu", _hot_window);
 }
 
 void AdaptiveMode::adaptiveThread() {
   // start with everything interleaved
-  double local_ratio = 1.0 / numa_num_configured_nodes();
-  double prev_stall_rate = std::numeric_limits<double>::infinity();
-  double best_stall_rate = std::numeric_limits<double>::infinity();
+  const Topology &topology = Topology::getInstance();
+  int num_nodes = topology.memoryNodes().size();
+  double local_ratio = 1.0 / num_nodes;  // the current placement
+  double best_ratio = -1;
+  RunningStats best;  // stall rate samples of the best ratio
   double stall_rate;
+  double budget = _num_polls * _poll_sleep / 1e6;
+  Objective objective = parse_objective(_objective);
 
   // pin thread to core zero
   // FIXME(dgureya): is this required when using likwid? - I don't think so!
@@ -61,49 +93,80 @@ void AdaptiveMode::adaptiveThread() {
   // DIEIF(sched_setaffinity(syscall(SYS_gettid), sizeof(mask), &mask) < 0,
   //		"could not set affinity for hw monitor thread");
 
-  get_stall_rate_v2();
-  sleep(_wait_start);
+  get_objective(objective);
+  MemoryMap &segments = MemoryMap::getInstance();
+
+  // rank the pages by how often they are accessed while we wait
+  AccessTracker tracker;
+  if (_hot_pages && _hot_window > 0 && tracker.start(_hot_soft_dirty)) {
+    LINFOF("sampling page accesses (%s)", tracker.source()._to_string());
+    for (uint64_t waited = 0; waited < _wait_start * 1000000ULL;
+        waited += _hot_window) {
+      segments.updateHeap();
+      tracker.sample(*segments.snapshot(), _hot_window);
+    }
+    LINFOF("%zu chunks of %zu KB accessed", tracker.hotChunks(),
+           tracker.chunkSize() >> 10);
+  } else {
+    if (_hot_pages) {
+      LWARN("cannot track page accesses: moving pages by address");
+    }
+    sleep(_wait_start);
+  }
+  const AccessTracker *hot = tracker.hasSamples() ? &tracker : nullptr;
 
   // dump mapping information
-  MemoryMap &segments = MemoryMap::getInstance();
   // segments.print();
 
   // slowly achieve awesomeness
-  for (uint64_t local_percentage = (100 / numa_num_configured_nodes() + 4) / 5
+  for (uint64_t local_percentage = (100 / num_nodes + 4) / 5
       * 5; local_percentage <= 100; local_percentage += ADAPTATION_STEP) {
     local_ratio = ((double) local_percentage) / 100;
     LINFOF("going to check a ratio of %3.1lf%%", local_ratio * 100);
-    place_all_pages_adaptive(segments, local_ratio);
+    place_all_pages_adaptive(topology, segments, local_ratio, hot);
     usleep(200000);
     unstickymem_log(local_ratio);
-    stall_rate = get_average_stall_rate(_num_polls, _poll_sleep,
-                                        _num_poll_outliers);
+
+    // the first ratio is the one to beat
+    if (best_ratio < 0) {
+      Estimate estimate = estimate_objective(objective, _poll_sleep,
+                                             _poll_precision, budget);
+      stall_rate = estimate.mean;
+      unstickymem_log(local_ratio, stall_rate);
+      LINFOF("Ratio: %1.2lf StallRate: %1.10lf", local_ratio, stall_rate);
+      best = estimate.stats;
+      best_ratio = local_ratio;
+      continue;
+    }
+
+    // sample until it is clearly better, worse or the same as the best
+    Comparison comparison = compare_objective(objective, best, _poll_sleep,
+                                              _significance, _poll_precision,
+                                              budget);
+    stall_rate = comparison.candidate.mean;
     //print stall_rate to a file for debugging!
     unstickymem_log(local_ratio, stall_rate);
 
-    LINFOF("Ratio: %1.2lf StallRate: %1.10lf (previous %1.10lf; best %1.10lf)",
-           local_ratio, stall_rate, prev_stall_rate, best_stall_rate);
-    /*std::string s = std::to_string(stall_rate);
-     s.replace(s.find("."), std::string(".").length(), ",");
-     fprintf(stderr, "%s\n", s.c_str());*/
-    // compute the minimum rate
-    best_stall_rate = std::min(best_stall_rate, stall_rate);
-    // check if we are getting worse
-    if (stall_rate > best_stall_rate * 1.001) {
-      // just make sure that its not something transient...!
-      LINFO("Hmm... Is this the best we can do?");
-      if (get_average_stall_rate(_num_polls * 2, _poll_sleep,
-                                 _num_poll_outliers * 2)) {
-        LINFO("I guess so!");
-        break;
-      }
+    LINFOF("Ratio: %1.2lf StallRate: %1.10lf (best %1.10lf at %1.2lf): %s",
+           local_ratio, stall_rate, best.mean(), best_ratio,
+           comparison.verdict._to_string());
+    if (comparison.verdict == +Verdict::BETTER) {
+      best = comparison.candidate.stats;
+      best_ratio = local_ratio;
+    } else if (comparison.verdict == +Verdict::WORSE) {
+      LINFO("We are getting worse: this is the best we can do");
+      break;
     }
-    prev_stall_rate = stall_rate;
+  }
+
+  // the last ratio checked may not be the best one
+  if (best_ratio != local_ratio) {
+    LINFOF("Going back to a ratio of %1.2lf", best_ratio);
+    place_all_pages_adaptive(topology, segments, best_ratio, hot);
   }
   LINFO("My work here is done! Enjoy the speedup");
-  LINFOF("Ratio: %1.2lf", local_ratio);
-  LINFOF("Stall Rate: %1.10lf", stall_rate);
-  LINFOF("Best Measured Stall Rate: %1.10lf", best_stall_rate);
+  LINFOF("Ratio: %1.2lf", best_ratio);
+  LINFOF("Best Measured Stall Rate: %1.10lf", best.mean());
 }
 
 void AdaptiveMode::start() {
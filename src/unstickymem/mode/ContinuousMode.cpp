@@ -0,0 +1,151 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <thread>
+
+#include <boost/program_options.hpp>
+
+#include "unstickymem/PerformanceCounters.hpp"
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/memory/MemoryMap.hpp"
+#include "unstickymem/mode/ContinuousMode.hpp"
+#include "unstickymem/placement/MigrationExecutor.hpp"
+#include "unstickymem/stats/ChangeDetector.hpp"
+
+namespace unstickymem {
+
+static Mode::Registrar<ContinuousMode> registrar(
+    ContinuousMode::name(), ContinuousMode::description());
+
+po::options_description ContinuousMode::getOptions() {
+  po::options_description mode_options = SearchMode::getOptions();
+  mode_options.add_options()(
+      "UNSTICKYMEM_MONITOR_PERIOD",
+      po::value < useconds_t > (&_monitor_period)->default_value(1000000),
+      "Time (in microseconds) between samples once tuned")(
+      "UNSTICKYMEM_CHANGE_DRIFT",
+      po::value<double>(&_change_drift)->default_value(0.05),
+      "Changes of the stall rate (relative to the tuned one) tolerated "
+      "without counting towards a phase change")(
+      "UNSTICKYMEM_CHANGE_THRESHOLD",
+      po::value<double>(&_change_threshold)->default_value(1.0),
+      "Accumulated relative change of the stall rate that is a phase change")(
+      "UNSTICKYMEM_RETUNE_HOLDOFF",
+      po::value<unsigned int>(&_holdoff)->default_value(30),
+      "Time (in seconds) to wait after tuning before watching for changes")(
+      "UNSTICKYMEM_BACKGROUND_MIGRATION",
+      po::value<bool>(&_background_migration)->default_value(false),
+      "Move to the tuned ratio in the background, paced by "
+      "UNSTICKYMEM_MIGRATION_BW, instead of at once");
+  return mode_options;
+}
+
+void ContinuousMode::printParameters() {
+  SearchMode::printParameters();
+  LINFOF("UNSTICKYMEM_MONITOR_PERIOD:     %lu", _monitor_period);
+  LINFOF("UNSTICKYMEM_CHANGE_DRIFT:       %.3lf", _change_drift);
+  LINFOF("UNSTICKYMEM_CHANGE_THRESHOLD:   %.3lf", _change_threshold);
+  LINFOF("UNSTICKYMEM_RETUNE_HOLDOFF:     %lu", _holdoff);
+  LINFOF("UNSTICKYMEM_BACKGROUND_MIGRATION: %s",
+         _background_migration ? "yes" : "no");
+}
+
+void ContinuousMode::waitForMigrations() {
+  MigrationExecutor &executor = MigrationExecutor::getInstance();
+  while (executor.pendingBytes() > 0) {
+    LDEBUGF("%zu bytes left to migrate", executor.pendingBytes());
+    usleep(_monitor_period);
+  }
+}
+
+// the detector sees the stall rate relative to the tuned one, so that the
+// drift and threshold do not depend on the workload
+bool ContinuousMode::waitForPhaseChange(double baseline) {
+  PageHinkley detector(_change_drift, _change_threshold);
+  get_stall_rate_v2();
+  while (!_stopping) {
+    usleep(_monitor_period);
+    double stall_rate = get_stall_rate_v2();
+    if (baseline > 0 && detector.add(stall_rate / baseline)) {
+      LINFOF("Phase change: stall rate %1.10lf, was %1.10lf", stall_rate,
+             baseline);
+      return true;
+    }
+  }
+  return false;
+}
+
+void ContinuousMode::tuningThread() {
+  get_stall_rate_v2();
+  sleep(_wait_start);
+
+  // the first time, like the search mode
+  double max_share = maxShare();
+  std::map<double, double> evaluations;
+  double best = _ratio = tune();
+
+  while (true) {
+    LINFOF("Tuned at a ratio of %.1lf, watching for phase changes", best);
+    sleep(_holdoff);
+    waitForMigrations();
+    Estimate baseline = estimate_stall_rate(_poll_sleep, _poll_precision,
+                                            _num_polls * _poll_sleep / 1e6);
+    if (!waitForPhaseChange(baseline.mean)) {
+      return;
+    }
+
+    // search again around the last optimum, which is measured again first:
+    // only move if clearly better there
+    evaluations.clear();
+    double current = evaluations[best] = evaluate(best);
+    double candidate_stall_rate;
+    double candidate = search(std::max(0.0, best - _window),
+                              std::min(max_share, best + _window),
+                              &evaluations, &candidate_stall_rate);
+    if (candidate_stall_rate < current * (1 - _poll_precision)) {
+      best = _ratio = candidate;
+    } else if (candidate != best) {
+      LINFOF("Not worth moving: staying at a ratio of %.1lf", best);
+      place_all_pages(Topology::getInstance(), MemoryMap::getInstance(), best,
+                      _background_migration);
+    }
+  }
+}
+
+double ContinuousMode::tunedRatio(void) const {
+  return _ratio;
+}
+
+void ContinuousMode::start() {
+  // use weighted interleave as a default!
+  MemoryMap &segments = MemoryMap::getInstance();
+  for (auto &segment : segments) {
+    if (segment.length() > (1UL << 14)) {
+      place_pages_weighted_initial(Topology::getInstance(), segment);
+    }
+  }
+
+  // a previous run found where to go
+  if (_warm_start) {
+    LINFOF("Starting at a ratio of %.1lf", _initial_ratio);
+    place_all_pages(Topology::getInstance(), segments, _initial_ratio);
+  }
+
+  _started = true;
+
+  // start tuning thread
+  std::thread tuningThread(&ContinuousMode::tuningThread, this);
+
+  // dont want for it to finish
+  tuningThread.detach();
+}
+
+// the tuning thread finishes once it is watching for phase changes again
+void ContinuousMode::stop() {
+  _stopping = true;
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,156 @@
+#include <cmath>
+#include <map>
+#include <thread>
+
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/memory/MemoryMap.hpp"
+#include "unstickymem/mode/PhaseMode.hpp"
+#include "unstickymem/stats/Search.hpp"
+
+namespace unstickymem {
+
+static Mode::Registrar<PhaseMode> registrar(PhaseMode::name(),
+                                            PhaseMode::description());
+
+bool PhaseMode::interrupted(void) const {
+  return _epoch != _tuning_epoch;
+}
+
+// measurements that straddle a phase change are worthless: give up on them
+// (without moving the pages) until the phase runs again
+double PhaseMode::evaluate(double share) {
+  if (interrupted()) {
+    return HUGE_VAL;
+  }
+  double stall_rate = SearchMode::evaluate(share);
+  return interrupted() ? HUGE_VAL : stall_rate;
+}
+
+bool PhaseMode::tunedRatio(const std::string &phase, double *ratio) {
+  std::lock_guard<std::mutex> lock(_lock);
+  auto tuned = _ratios.find(phase);
+  if (tuned == _ratios.end()) {
+    return false;
+  }
+  *ratio = tuned->second;
+  return true;
+}
+
+// one profile for the whole program does not tell much about each phase
+bool PhaseMode::warmStart(const Profile &profile, bool refine) {
+  return false;
+}
+
+// handles the phase changes in turn: tunes the new phases, and puts the
+// pages where the others (or the application outside of them) had them
+void PhaseMode::tuningThread() {
+  bool abandoned = false;  // the pages are where a search left them
+  while (true) {
+    std::string phase;
+    double ratio = 0;
+    bool tuned;
+    {
+      std::unique_lock<std::mutex> lock(_lock);
+      _phase_changed.wait(lock, [this]() {return _epoch != _tuning_epoch;});
+      phase = _phase;
+      _tuning_epoch = _epoch;
+      auto cached = _ratios.find(phase);
+      tuned = cached != _ratios.end();
+      ratio = tuned ? cached->second : 0;
+    }
+
+    if (phase.empty()) {
+      if (abandoned) {
+        LINFO("Back to the initial weights");
+        place_all_pages(Topology::getInstance(), MemoryMap::getInstance(), 0);
+        abandoned = false;
+      }
+    } else if (tuned) {
+      LINFOF("Phase %s: back to a ratio of %.1lf", phase.c_str(), ratio);
+      place_all_pages(Topology::getInstance(), MemoryMap::getInstance(),
+                      ratio);
+      abandoned = false;
+    } else {
+      abandoned = !tunePhase(phase);
+    }
+  }
+}
+
+bool PhaseMode::tunePhase(const std::string &phase) {
+  // like the search mode, starting with the placement it found
+  LINFOF("Tuning phase %s", phase.c_str());
+  std::map<double, double> &evaluations = _evaluations[phase];
+  if (evaluations.empty()) {
+    evaluations[0] = evaluate(0);
+  }
+  double best = golden_section_search(
+      [this](double share) { return evaluate(share); }, 0, maxShare(),
+      _tolerance, &evaluations);
+
+  std::unique_lock<std::mutex> lock(_lock);
+  if (interrupted()) {
+    for (auto e = evaluations.begin(); e != evaluations.end();) {
+      e = e->second == HUGE_VAL ? evaluations.erase(e) : std::next(e);
+    }
+    LINFOF("Phase %s ended before it was tuned (%zu ratios measured)",
+           phase.c_str(), evaluations.size());
+    return false;
+  }
+  double best_stall_rate = evaluations[best];
+  best = round(best * 10) / 10;
+  _ratios[phase] = best;
+  lock.unlock();
+
+  place_all_pages(Topology::getInstance(), MemoryMap::getInstance(), best);
+  LINFOF("Phase %s: Ratio: %.1lf StallRate: %1.10lf (%zu ratios measured)",
+         phase.c_str(), best, best_stall_rate, evaluations.size());
+  _evaluations.erase(phase);
+  return true;
+}
+
+void PhaseMode::start() {
+  // use weighted interleave as a default!
+  MemoryMap &segments = MemoryMap::getInstance();
+  for (auto &segment : segments) {
+    if (segment.length() > (1UL << 14)) {
+      place_pages_weighted_initial(Topology::getInstance(), segment);
+    }
+  }
+
+  _started = true;
+
+  // start tuning thread
+  std::thread tuningThread(&PhaseMode::tuningThread, this);
+
+  // dont want for it to finish
+  tuningThread.detach();
+}
+
+// the tuning thread moves the pages: the application only marks the phase
+void PhaseMode::processPhaseBegin(const std::string &phase) {
+  if (!_started) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_lock);
+    _phase = phase;
+    _epoch++;
+  }
+  _phase_changed.notify_one();
+}
+
+void PhaseMode::processPhaseEnd() {
+  if (!_started) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_lock);
+    _phase.clear();
+    _epoch++;
+  }
+  _phase_changed.notify_one();
+}
+
+}  // namespace unstickymem
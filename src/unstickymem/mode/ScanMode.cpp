@@ -13,6 +13,7 @@
 #include "unstickymem/unstickymem.h"
 #include "unstickymem/PerformanceCounters.hpp"
 #include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Topology.hpp"
 #include "unstickymem/memory/MemoryMap.hpp"
 #include "unstickymem/mode/ScanMode.hpp"
 #include "unstickymem/Logger.hpp"
@@ -74,13 +75,12 @@ void ScanMode::scannerThread() {
   // dump mapping information
   MemoryMap &segments = MemoryMap::getInstance();
   // segments.print();
-  //set sum_ww & sum_nww & initialize the weights!
-  get_sum_nww_ww(OPT_NUM_WORKERS_VALUE);
+  const Topology &topology = Topology::getInstance();
 
   int i;
-  for (i = 0; i <= sum_nww; i += ADAPTATION_STEP) {
+  for (i = 0; i <= topology.nonWorkerWeight(); i += ADAPTATION_STEP) {
     LINFOF("checking ratio %d", i);
-    place_all_pages(segments, i);
+    place_all_pages(topology, segments, i);
     sleep(1);
     unstickymem_log(i);
     stall_rate = get_average_stall_rate(_num_polls, _poll_sleep,
@@ -0,0 +1,169 @@
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <thread>
+
+#include <boost/program_options.hpp>
+
+#include "unstickymem/unstickymem.h"
+#include "unstickymem/PerformanceCounters.hpp"
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Runtime.hpp"
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/memory/MemoryMap.hpp"
+#include "unstickymem/mode/SearchMode.hpp"
+#include "unstickymem/stats/Search.hpp"
+
+namespace unstickymem {
+
+static Mode::Registrar<SearchMode> registrar(SearchMode::name(),
+                                             SearchMode::description());
+
+po::options_description SearchMode::getOptions() {
+  po::options_description mode_options("Search mode parameters");
+  mode_options.add_options()(
+      "UNSTICKYMEM_WAIT_START",
+      po::value<unsigned int>(&_wait_start)->default_value(2),
+      "Time (in seconds) to wait before starting the search")(
+      "UNSTICKYMEM_NUM_POLLS",
+      po::value<unsigned int>(&_num_polls)->default_value(20),
+      "How many measurements to make (at most) for each placement ratio")(
+      "UNSTICKYMEM_POLL_SLEEP",
+      po::value < useconds_t > (&_poll_sleep)->default_value(200000),
+      "Time (in microseconds) between measurements")(
+      "UNSTICKYMEM_POLL_PRECISION",
+      po::value<double>(&_poll_precision)->default_value(0.02),
+      "Stop measuring a ratio once the 95% confidence interval of its stall "
+      "rate is within this fraction of the mean")(
+      "UNSTICKYMEM_SEARCH_TOLERANCE",
+      po::value<double>(&_tolerance)->default_value(2),
+      "Stop searching once the optimum is bracketed within this many "
+      "percentage points")(
+      "UNSTICKYMEM_RETUNE_WINDOW",
+      po::value<double>(&_window)->default_value(20),
+      "How far (in percentage points) from a previous optimum to search "
+      "again");
+  return mode_options;
+}
+
+void SearchMode::printParameters() {
+  LINFOF("UNSTICKYMEM_WAIT_START:         %lu", _wait_start);
+  LINFOF("UNSTICKYMEM_NUM_POLLS:          %lu", _num_polls);
+  LINFOF("UNSTICKYMEM_POLL_SLEEP:         %lu", _poll_sleep);
+  LINFOF("UNSTICKYMEM_POLL_PRECISION:     %.3lf", _poll_precision);
+  LINFOF("UNSTICKYMEM_SEARCH_TOLERANCE:   %.1lf", _tolerance);
+  LINFOF("UNSTICKYMEM_RETUNE_WINDOW:      %.1lf", _window);
+}
+
+void SearchMode::processSegmentAddition(const MemorySegment& segment) {
+  if (!_started) {
+    return;
+  }
+  if (segment.length() > (1UL << 14)) {
+    place_pages_weighted_initial(Topology::getInstance(), segment);
+  }
+}
+
+double SearchMode::maxShare(void) {
+  return Topology::getInstance().nonWorkerWeight();
+}
+
+double SearchMode::evaluate(double share) {
+  // the weights have a resolution of 0.1%
+  share = round(share * 10) / 10;
+  LINFOF("Going to check a ratio of %.1lf", share);
+  place_all_pages(Topology::getInstance(), MemoryMap::getInstance(), share);
+  usleep(200000);
+  unstickymem_log(share);
+  double stall_rate = estimate_stall_rate(
+      _poll_sleep, _poll_precision, _num_polls * _poll_sleep / 1e6,
+      [this]() { return interrupted(); }).mean;
+  unstickymem_log(share, stall_rate);
+  LINFOF("Ratio: %.1lf StallRate: %1.10lf", share, stall_rate);
+  return stall_rate;
+}
+
+// the evaluations are keyed by the shares searched, not the rounded ones
+double SearchMode::search(double lo, double hi,
+                          std::map<double, double> *evaluations,
+                          double *stall_rate) {
+  double best = golden_section_search(
+      [this](double share) { return evaluate(share); }, lo, hi, _tolerance,
+      evaluations);
+  double best_stall_rate = evaluations->at(best);
+  if (stall_rate != nullptr) {
+    *stall_rate = best_stall_rate;
+  }
+  best = round(best * 10) / 10;
+  LINFOF("Going back to the best ratio, %.1lf", best);
+  place_all_pages(Topology::getInstance(), MemoryMap::getInstance(), best,
+                  _background_migration);
+  LINFOF("Ratio: %.1lf StallRate: %1.10lf (%zu ratios measured)", best,
+         best_stall_rate, evaluations->size());
+  Runtime::getInstance().saveProfile(best, best_stall_rate);
+  return best;
+}
+
+double SearchMode::tune() {
+  double max_share = maxShare();
+  std::map<double, double> evaluations;
+  if (!_warm_start) {
+    // the pages start at the initial weights: measure there first, so that
+    // the search only moves away if that is better
+    evaluations[0] = evaluate(0);
+    return search(0, max_share, &evaluations);
+  }
+  if (!_refine) {
+    return _initial_ratio;
+  }
+  evaluations[_initial_ratio] = evaluate(_initial_ratio);
+  return search(std::max(0.0, _initial_ratio - _window),
+                std::min(max_share, _initial_ratio + _window), &evaluations);
+}
+
+bool SearchMode::warmStart(const Profile &profile, bool refine) {
+  double max_share = maxShare();
+  _warm_start = true;
+  _refine = refine;
+  _initial_ratio = std::min(std::max(profile.ratio, 0.0), max_share);
+  return true;
+}
+
+void SearchMode::searchThread() {
+  get_stall_rate_v2();
+  sleep(_wait_start);
+  tune();
+  LINFO("My work here is done! Enjoy the speedup");
+}
+
+void SearchMode::start() {
+  // use weighted interleave as a default!
+  MemoryMap &segments = MemoryMap::getInstance();
+  for (auto &segment : segments) {
+    if (segment.length() > (1UL << 14)) {
+      place_pages_weighted_initial(Topology::getInstance(), segment);
+    }
+  }
+
+  // a previous run found where to go
+  if (_warm_start) {
+    LINFOF("Starting at a ratio of %.1lf", _initial_ratio);
+    place_all_pages(Topology::getInstance(), segments, _initial_ratio);
+  }
+
+  _started = true;
+  if (_warm_start && !_refine) {
+    return;
+  }
+
+  // start search thread
+  std::thread searchThread(&SearchMode::searchThread, this);
+
+  // dont want for it to finish
+  searchThread.detach();
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,54 @@
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/mode/UserfaultMode.hpp"
+#include "unstickymem/placement/PlacementPlan.hpp"
+#include "unstickymem/placement/UserfaultHandler.hpp"
+
+namespace unstickymem {
+
+static Mode::Registrar<UserfaultMode> registrar(UserfaultMode::name(),
+                                                UserfaultMode::description());
+
+void UserfaultMode::start() {
+  if (!UserfaultHandler::getInstance().start()) {
+    LWARN("placing new mappings with memory policies instead");
+  }
+  SearchMode::start();
+}
+
+// only what the program maps itself: the chunks malloc maps may share pages
+// with the allocator's own bookkeeping
+void UserfaultMode::processSegmentAddition(const MemorySegment& segment) {
+  if (!_started) {
+    return;
+  }
+  UserfaultHandler &handler = UserfaultHandler::getInstance();
+  if (handler.isRunning() && segment.name() == "mmap"
+      && segment.length() > (1ULL << 20)) {
+    const Topology &topology = Topology::getInstance();
+    PlacementPlan plan = plan_weighted(topology,
+                                       segment.pageAlignedStartAddress(),
+                                       segment.pageAlignedLength(),
+                                       topology.weights());
+    if (handler.registerPlan(plan)) {
+      return;
+    }
+  }
+  SearchMode::processSegmentAddition(segment);
+}
+
+// the placement binds the registered regions too, and the handler would
+// only allocate their pages under those policies, not by the plans
+double UserfaultMode::evaluate(double share) {
+  UserfaultHandler::getInstance().unregisterAll();
+  return SearchMode::evaluate(share);
+}
+
+void UserfaultMode::processSegmentRemoval(const MemorySegment& segment) {
+  UserfaultHandler::getInstance().unregister(
+      reinterpret_cast<uintptr_t>(segment.pageAlignedStartAddress()),
+      segment.pageAlignedLength());
+}
+
+}  // namespace unstickymem
@@ -5,6 +5,8 @@
 #include <numa.h>
 #include <numaif.h>
 
+#include <algorithm>
+#include <cmath>
 #include <thread>
 
 #include <boost/program_options.hpp>
@@ -12,6 +14,8 @@
 #include "unstickymem/unstickymem.h"
 #include "unstickymem/PerformanceCounters.hpp"
 #include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Runtime.hpp"
+#include "unstickymem/Topology.hpp"
 #include "unstickymem/Logger.hpp"
 #include "unstickymem/memory/MemoryMap.hpp"
 #include "unstickymem/mode/WeightedAdaptiveMode.hpp"
@@ -30,20 +34,31 @@ po::options_description WeightedAdaptiveMode::getOptions() {
       "UNSTICKYMEM_NUM_POLLS",
       po::value<unsigned int>(&_num_polls)->default_value(20),
       "How many measurements to make for each placement ratio")(
-      "UNSTICKYMEM_NUM_POLL_OUTLIERS",
-      po::value<unsigned int>(&_num_poll_outliers)->default_value(5),
-      "How many of the top-N and bottom-N measurements to discard")(
       "UNSTICKYMEM_POLL_SLEEP",
       po::value < useconds_t > (&_poll_sleep)->default_value(200000),
-      "Time (in microseconds) between measurements");
+      "Time (in microseconds) between measurements")(
+      "UNSTICKYMEM_POLL_PRECISION",
+      po::value<double>(&_poll_precision)->default_value(0.02),
+      "Stop measuring a ratio once the 95% confidence interval of its stall "
+      "rate is within this fraction of the mean (at most NUM_POLLS polls)")(
+      "UNSTICKYMEM_SIGNIFICANCE",
+      po::value<double>(&_significance)->default_value(0.05),
+      "Probability of wrongly deciding that a ratio is better or worse than "
+      "the best one so far")(
+      "UNSTICKYMEM_OBJECTIVE",
+      po::value < std::string > (&_objective)->default_value("stalls"),
+      "What to minimize: stalls (the stall rate), progress (the time per "
+      "operation reported by the application) or stalls_per_op");
   return mode_options;
 }
 
 void WeightedAdaptiveMode::printParameters() {
   LINFOF("UNSTICKYMEM_WAIT_START:         %lu", _wait_start);
   LINFOF("UNSTICKYMEM_NUM_POLLS:          %lu", _num_polls);
-  LINFOF("UNSTICKYMEM_NUM_POLL_OUTLIERS:  %lu", _num_poll_outliers);
   LINFOF("UNSTICKYMEM_POLL_SLEEP:         %lu", _poll_sleep);
+  LINFOF("UNSTICKYMEM_POLL_PRECISION:     %.3lf", _poll_precision);
+  LINFOF("UNSTICKYMEM_SIGNIFICANCE:       %.3lf", _significance);
+  LINFOF("UNSTICKYMEM_OBJECTIVE:          %s", _objective.c_str());
 }
 
 void WeightedAdaptiveMode::processSegmentAddition(
@@ -53,57 +68,90 @@ void WeightedAdaptiveMode::processSegmentAddition(
   }
   if (segment.length() > (1UL << 14)) {
     // segment.print();
-    place_pages_weighted_initial(segment);
+    place_pages_weighted_initial(Topology::getInstance(), segment);
   }
 }
 
 void WeightedAdaptiveMode::adaptiveThread() {
-  int local_ratio;
-  double prev_stall_rate = std::numeric_limits<double>::infinity();
-  double best_stall_rate = std::numeric_limits<double>::infinity();
-  double stall_rate;
-
-  get_stall_rate_v2();
+  int ratio = -1;  // the current placement
+  int best_ratio = -1;
+  RunningStats best;  // stall rate samples of the best ratio
+  double stall_rate = 0;
+  double budget = _num_polls * _poll_sleep / 1e6;
+  Objective objective = parse_objective(_objective);
+
+  get_objective(objective);
   sleep(_wait_start);
 
   // dump mapping information
   MemoryMap &segments = MemoryMap::getInstance();
   //segments.print();
+  const Topology &topology = Topology::getInstance();
 
   // slowly achieve awesomeness - asymmetric weights version!
-  int i;
-  for (i = 10; i <= sum_nww; i += ADAPTATION_STEP) {
+  // (from where a previous run ended, if there was one)
+  for (int i = _warm_start ? _initial_ratio : 10;
+      i <= topology.nonWorkerWeight(); i += ADAPTATION_STEP) {
     LINFOF("Going to check a ratio of %d", i);
-    place_all_pages(segments, i);
+    place_all_pages(topology, segments, i);
+    ratio = i;
     usleep(200000);
     //sleep(1);
     unstickymem_log(i);
-    stall_rate = get_average_stall_rate(_num_polls, _poll_sleep,
-                                        _num_poll_outliers);
+
+    // the first ratio is the one to beat
+    if (best_ratio < 0) {
+      Estimate estimate = estimate_objective(objective, _poll_sleep,
+                                             _poll_precision, budget);
+      stall_rate = estimate.mean;
+      unstickymem_log(i, stall_rate);
+      LINFOF("Ratio: %d StallRate: %1.10lf", i, stall_rate);
+      best = estimate.stats;
+      best_ratio = i;
+      continue;
+    }
+
+    // sample until it is clearly better, worse or the same as the best
+    Comparison comparison = compare_objective(objective, best, _poll_sleep,
+                                              _significance, _poll_precision,
+                                              budget);
+    stall_rate = comparison.candidate.mean;
     //print stall_rate to a file for debugging!
     unstickymem_log(i, stall_rate);
-    LINFOF("Ratio: %d StallRate: %1.10lf (previous %1.10lf; best %1.10lf)", i,
-           stall_rate, prev_stall_rate, best_stall_rate);
-
-    // compute the minimum rate
-    best_stall_rate = std::min(best_stall_rate, stall_rate);
-    // check if we are geting worse
-    if (stall_rate > best_stall_rate * 1.001) {
-      // just make sure that its not something transient...!
-      LINFO("Hmm... Is this the best we can do?");
-      if (get_average_stall_rate(_num_polls * 2, _poll_sleep,
-                                 _num_poll_outliers * 2)) {
-        LINFO("I guess so!");
-        break;
-      }
+    LINFOF("Ratio: %d StallRate: %1.10lf (best %1.10lf at %d): %s", i,
+           stall_rate, best.mean(), best_ratio,
+           comparison.verdict._to_string());
+
+    if (comparison.verdict == +Verdict::BETTER) {
+      best = comparison.candidate.stats;
+      best_ratio = i;
+    } else if (comparison.verdict == +Verdict::WORSE) {
+      LINFO("We are getting worse: this is the best we can do");
+      break;
     }
-    prev_stall_rate = stall_rate;
-    local_ratio = i;
+  }
+
+  // the last ratio checked may not be the best one
+  if (best_ratio != ratio) {
+    LINFOF("Going back to ratio %d", best_ratio);
+    place_all_pages(topology, segments, best_ratio);
   }
   LINFO("My work here is done! Enjoy the speedup");
-  LINFOF("Ratio: %d", local_ratio);
-  LINFOF("Stall Rate: %1.10lf", stall_rate);
-  LINFOF("Best Measured Stall Rate: %1.10lf", best_stall_rate);
+  LINFOF("Ratio: %d", best_ratio);
+  LINFOF("Best Measured Stall Rate: %1.10lf", best.mean());
+  if (best_ratio >= 0) {
+    Runtime::getInstance().saveProfile(best_ratio, best.mean());
+  }
+}
+
+bool WeightedAdaptiveMode::warmStart(const Profile &profile, bool refine) {
+  _warm_start = true;
+  _refine = refine;
+  _initial_ratio = std::min(std::max(static_cast<int>(round(profile.ratio)),
+                                     0),
+                            static_cast<int>(
+                                Topology::getInstance().nonWorkerWeight()));
+  return true;
 }
 
 void WeightedAdaptiveMode::start() {
@@ -117,11 +165,20 @@ void WeightedAdaptiveMode::start() {
   for (auto &segment : segments) {
     if (segment.length() > (1UL << 14)) {
      // segment.print();
-      place_pages_weighted_initial(segment);
+      place_pages_weighted_initial(Topology::getInstance(), segment);
     }
   }
 
+  // a previous run found where to go
+  if (_warm_start) {
+    LINFOF("Starting at a ratio of %d", _initial_ratio);
+    place_all_pages(Topology::getInstance(), segments, _initial_ratio);
+  }
+
   _started = true;
+  if (_warm_start && !_refine) {
+    return;
+  }
 
   // start adaptive thread
   std::thread adaptiveThread(&WeightedAdaptiveMode::adaptiveThread, this);
@@ -0,0 +1,284 @@
+#include <sched.h>
+#include <sys/mman.h>
+#include <numa.h>
+#include <numaif.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "unstickymem/placement/MigrationExecutor.hpp"
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Runtime.hpp"
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+double MigrationExecutor::Statistics::pagesPerSecond(void) const {
+  return seconds > 0 ? bytes / PAGE_SIZE / seconds : 0;
+}
+
+MigrationExecutor& MigrationExecutor::getInstance(void) {
+  static MigrationExecutor *object = nullptr;
+  if (!object) {
+    LDEBUG("Creating MigrationExecutor singleton object");
+    void *buf = WRAP(mmap)(nullptr, sizeof(MigrationExecutor),
+                           PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                           -1, 0);
+    DIEIF(buf == MAP_FAILED, "error allocating space for migration executor");
+    object = new (buf) MigrationExecutor();
+  }
+  return *object;
+}
+
+MigrationExecutor::MigrationExecutor()
+    : _bandwidth(Runtime::getInstance().getMigrationBandwidth()) {
+  startWorkers();
+}
+
+// spread the workers through the nodes we are allowed to run on
+void MigrationExecutor::startWorkers(void) {
+  std::vector<int> nodes = Topology::getInstance().cpuNodes();
+  DIEIF(nodes.empty(), "no NUMA node to run the migration threads on");
+
+  size_t num_workers = Runtime::getInstance().getMigrationThreads();
+  if (num_workers == 0) {
+    num_workers = nodes.size();
+  }
+
+  for (size_t i = 0; i < num_workers; i++) {
+    _workers.emplace_back(new Worker());
+    Worker *worker = _workers.back().get();
+    worker->node = nodes[i % nodes.size()];
+  }
+  // only start them once all queues exist: they steal from each other
+  for (auto &worker : _workers) {
+    worker->thread = std::thread(&MigrationExecutor::work, this,
+                                 worker.get());
+    worker->thread.detach();
+  }
+  LDEBUGF("started %zu migration threads on %zu nodes", _workers.size(),
+          nodes.size());
+}
+
+// workers sleep between plans: chunks are only queued when a plan starts,
+// so a worker that finds nothing it can take is done with the current one
+void MigrationExecutor::work(Worker *worker) {
+  DIEIF(numa_run_on_node(worker->node) != 0,
+        "could not pin migration thread");
+  uint64_t seen = 0;
+  Task task;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(_lock);
+      _work_available.wait(lock, [&]() {return _generation != seen;});
+      seen = _generation;
+    }
+    while (next(worker, worker->node, &task)) {
+    }
+  }
+}
+
+// takes (and executes) one chunk: from our own queue first, then stealing.
+// workers take any chunk, moving to the node of MPOL_LOCAL ones, so every
+// chunk gets done even without a worker on its node. waiting threads only
+// help with the chunks they can run where they are
+bool MigrationExecutor::next(Worker *worker, int node, Task *task) {
+  auto eligible = [worker, node](const Task &t) {
+    return worker != nullptr || t.node == -1 || t.node == node;
+  };
+
+  if (worker != nullptr) {
+    std::unique_lock<std::mutex> lock(worker->lock);
+    auto it = std::find_if(worker->tasks.begin(), worker->tasks.end(),
+                           eligible);
+    if (it != worker->tasks.end()) {
+      *task = *it;
+      worker->tasks.erase(it);
+      lock.unlock();
+      execute(*task, node, false);
+      return true;
+    }
+  }
+
+  for (auto &victim : _workers) {
+    if (victim.get() == worker) {
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(victim->lock);
+    auto it = std::find_if(victim->tasks.rbegin(), victim->tasks.rend(),
+                           eligible);
+    if (it != victim->tasks.rend()) {
+      *task = *it;
+      victim->tasks.erase(std::next(it).base());
+      lock.unlock();
+      execute(*task, node, true);
+      return true;
+    }
+  }
+  return false;
+}
+
+// `node` is the node of the calling thread
+void MigrationExecutor::execute(const Task &task, int node, bool stolen) {
+  // MPOL_LOCAL pages go to the node running the migration
+  bool moved = task.node != -1 && task.node != node;
+  if (moved) {
+    DIEIFF(numa_run_on_node(task.node) != 0,
+           "could not move migration thread to node %d", task.node);
+  }
+
+  // only resident pages are copied: the others just get a policy
+  if (_bandwidth.getRate() != 0) {
+    _bandwidth.acquire(plan_length(plan_resident({ task.range })));
+  }
+  size_t syscalls = 1;
+  if (task.backend == +MigrationBackend::MOVE_PAGES) {
+    syscalls = move_plan_pages(PlacementPlan { task.range }, task.flags,
+                               moved ? task.node : node);
+  } else {
+    apply_plan(PlacementPlan { task.range }, task.flags);
+  }
+
+  if (moved) {
+    DIEIF(numa_run_on_node(node) != 0, "could not pin migration thread");
+  }
+  _pending_bytes -= task.range.length;
+  std::scoped_lock lock(_lock);
+  _batch.syscalls += syscalls;
+  _batch.bytes += task.range.length;
+  _batch.chunks++;
+  _batch.steals += stolen ? 1 : 0;
+  if (--_pending == 0) {
+    _work_done.notify_all();
+  }
+}
+
+// when capped, chunks are a fraction of a second worth of bandwidth, so the
+// migrations are paced smoothly
+size_t MigrationExecutor::chunkLength(void) {
+  size_t rate = _bandwidth.getRate();
+  if (rate == 0) {
+    return CHUNK_LENGTH;
+  }
+  return std::clamp<size_t>(PAGE_ALIGN_DOWN(rate / 20), PAGE_SIZE,
+                            CHUNK_LENGTH);
+}
+
+void MigrationExecutor::submit(const PlacementPlan &plan, unsigned flags,
+                               MigrationBackend backend) {
+  int my_node = numa_node_of_cpu(sched_getcpu());
+  size_t chunk_length = chunkLength();
+
+  // split the plan in chunks and queue them where they are going
+  std::vector<std::vector<Task>> queues(_workers.size());
+  size_t next_worker = 0;
+  size_t num_tasks = 0;
+  size_t num_bytes = 0;
+  for (const PlacementRange &range : plan) {
+    int node = -1;
+    int preferred = -1;
+    if (range.mode == MPOL_LOCAL) {
+      node = preferred = my_node;
+    } else if (range.nodemask != 0
+        && (range.nodemask & (range.nodemask - 1)) == 0) {
+      preferred = __builtin_ctzl(range.nodemask);
+    }
+    for (size_t offset = 0; offset < range.length; offset += chunk_length) {
+      PlacementRange chunk = range;
+      chunk.start += offset;
+      chunk.length = std::min(chunk_length, range.length - offset);
+
+      // round-robin, skipping workers of other nodes if we have a preference
+      size_t w = next_worker;
+      for (size_t i = 0; i < _workers.size(); i++) {
+        size_t candidate = (next_worker + i) % _workers.size();
+        if (preferred == -1 || _workers[candidate]->node == preferred) {
+          w = candidate;
+          break;
+        }
+      }
+      next_worker = (w + 1) % _workers.size();
+      queues[w].push_back({ chunk, flags, node, backend });
+      num_tasks++;
+      num_bytes += chunk.length;
+    }
+  }
+  if (num_tasks == 0) {
+    return;
+  }
+
+  {
+    std::scoped_lock lock(_lock);
+    // statistics cover everything submitted until the executor is idle
+    if (_pending == 0) {
+      _batch = Statistics();
+      _batch_start = std::chrono::steady_clock::now();
+    }
+    for (size_t w = 0; w < _workers.size(); w++) {
+      std::scoped_lock worker_lock(_workers[w]->lock);
+      _workers[w]->tasks.insert(_workers[w]->tasks.end(), queues[w].begin(),
+                                queues[w].end());
+    }
+    _pending += num_tasks;
+    _pending_bytes += num_bytes;
+    _generation++;
+  }
+  _work_available.notify_all();
+}
+
+MigrationExecutor::Statistics MigrationExecutor::wait(void) {
+  // we might be on another node than when submitting: the workers take care
+  // of the MPOL_LOCAL chunks we can not run here
+  int my_node = numa_node_of_cpu(sched_getcpu());
+  Task task;
+  while (next(nullptr, my_node, &task)) {
+  }
+
+  std::unique_lock<std::mutex> lock(_lock);
+  _work_done.wait(lock, [this]() {return _pending == 0;});
+  if (_batch.chunks > 0) {
+    _batch.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - _batch_start).count();
+    _last = _batch;
+    _batch = Statistics();
+    LDEBUGF("migrated %zu pages in %.3lfs (%.0lf pages/s, %zu chunks, "
+            "%zu stolen, %zu syscalls)", _last.bytes / PAGE_SIZE,
+            _last.seconds, _last.pagesPerSecond(), _last.chunks, _last.steals,
+            _last.syscalls);
+  }
+  return _last;
+}
+
+MigrationExecutor::Statistics MigrationExecutor::run(const PlacementPlan &plan,
+                                                     unsigned flags,
+                                                     MigrationBackend backend) {
+  if (plan.empty()) {
+    return Statistics();
+  }
+  submit(plan, flags, backend);
+  return wait();
+}
+
+size_t MigrationExecutor::pendingBytes(void) const {
+  return _pending_bytes.load();
+}
+
+size_t MigrationExecutor::getBandwidth(void) {
+  return _bandwidth.getRate();
+}
+
+void MigrationExecutor::setBandwidth(size_t bytes_per_second) {
+  _bandwidth.setRate(bytes_per_second);
+}
+
+size_t MigrationExecutor::numWorkers(void) const {
+  return _workers.size();
+}
+
+MigrationExecutor::Statistics MigrationExecutor::lastRun(void) const {
+  return _last;
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,91 @@
+#include <sys/mman.h>
+#include <numaif.h>
+
+#include <utility>
+
+#include "unstickymem/placement/PlacementEngine.hpp"
+#include "unstickymem/placement/MigrationExecutor.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+PlacementEngine& PlacementEngine::getInstance(void) {
+  static PlacementEngine *object = nullptr;
+  if (!object) {
+    LDEBUG("Creating PlacementEngine singleton object");
+    void *buf = WRAP(mmap)(nullptr, sizeof(PlacementEngine),
+                           PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                           -1, 0);
+    DIEIF(buf == MAP_FAILED, "error allocating space for placement engine");
+    object = new (buf) PlacementEngine();
+  }
+  return *object;
+}
+
+// only touched by the placement threads: the allocating threads never wait
+// for this lock (segments that disappear are simply not carried over)
+void PlacementEngine::placeAll(const SegmentTree &segments,
+                               const Planner &target, const Planner &initial,
+                               MigrationBackend backend, bool background) {
+  std::scoped_lock lock(_lock);
+  std::map<uint64_t, PlacementPlan> layouts;
+  PlacementPlan changes;
+  size_t planned = 0;
+
+  for (auto it = segments.begin(); it != segments.end(); ++it) {
+    if (it->length() <= MIN_SEGMENT_LENGTH) {
+      continue;
+    }
+    void *addr = it->pageAlignedStartAddress();
+    unsigned long len = it->pageAlignedLength();
+    PlacementPlan plan = target(addr, len);
+
+    // what the segment looks like now
+    PlacementPlan current;
+    auto previous = _layouts.find(it.id());
+    if (previous != _layouts.end()) {
+      current = std::move(previous->second);
+    } else if (initial) {
+      current = initial(addr, len);
+    }
+
+    PlacementPlan difference = plan_difference(current, plan);
+    changes.insert(changes.end(), difference.begin(), difference.end());
+    planned += plan_length(plan);
+    layouts.emplace(it.id(), std::move(plan));
+  }
+
+  _layouts = std::move(layouts);
+  _bytes_planned = planned;
+
+  // migrate all segments at once, in parallel
+  MigrationExecutor &executor = MigrationExecutor::getInstance();
+  if (background) {
+    executor.submit(changes, MPOL_MF_MOVE | MPOL_MF_STRICT, backend);
+    _bytes_moved = plan_length(changes);
+    LDEBUGF("placement pass: queued %zu of %zu bytes", _bytes_moved,
+            _bytes_planned);
+    return;
+  }
+  MigrationExecutor::Statistics statistics = executor.run(
+      changes, MPOL_MF_MOVE | MPOL_MF_STRICT, backend);
+  _bytes_moved = statistics.bytes;
+  LDEBUGF("placement pass: rebound %zu of %zu bytes (%.0lf pages/s)",
+          _bytes_moved, _bytes_planned, statistics.pagesPerSecond());
+}
+
+void PlacementEngine::reset(void) {
+  std::scoped_lock lock(_lock);
+  _layouts.clear();
+}
+
+size_t PlacementEngine::bytesPlanned(void) const {
+  return _bytes_planned;
+}
+
+size_t PlacementEngine::bytesMoved(void) const {
+  return _bytes_moved;
+}
+
+}  // namespace unstickymem
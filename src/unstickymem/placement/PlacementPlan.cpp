@@ -0,0 +1,488 @@
+#include <numaif.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <numeric>
+
+#include "unstickymem/memory/AccessTracker.hpp"
+#include "unstickymem/placement/PlacementPlan.hpp"
+#include "unstickymem/placement/WeightedInterleave.hpp"
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+static const unsigned long MAX_NODEMASK_BITS = MAX_PLAN_NODES;
+
+// placement walks a snapshot of the segments: a range may be unmapped while
+// it is being placed, which is not an error (there is nothing left to place)
+static bool unmapped(int error) {
+  return error == ENOMEM || error == EFAULT;
+}
+
+// pages moved by each move_pages call
+static const size_t MOVE_PAGES_BATCH = 4096;
+
+// pages checked by each mincore call
+static const size_t MINCORE_BATCH = 1 << 16;
+
+bool PlacementRange::samePolicyAs(const PlacementRange &other) const {
+  if (mode != other.mode) {
+    return false;
+  }
+  if (mode == MPOL_WEIGHTED_INTERLEAVE && weights != other.weights) {
+    return false;
+  }
+  return mode == MPOL_LOCAL || nodemask == other.nodemask;
+}
+
+PlacementPlan plan_interleave_all(const Topology &topology, void *addr,
+                                  unsigned long len) {
+  PlacementPlan plan;
+  if (len > 0) {
+    plan.push_back({ reinterpret_cast<uintptr_t>(addr), len, MPOL_INTERLEAVE,
+        topology.memoryMask() });
+  }
+  return plan;
+}
+
+PlacementPlan plan_local_ratio(const Topology &topology, void *addr,
+                               unsigned long len, double r,
+                               const AccessTracker *tracker) {
+  // compute the ratios to input to `mbind`
+  int num_nodes = topology.memoryNodes().size();
+  double local_ratio =
+      num_nodes > 1 ? r - (1.0 - r) / (num_nodes - 1) : 1.0;
+  double interleave_ratio = 1.0 - local_ratio;
+
+  // compute the lengths of the interleaved and local segments
+  unsigned long interleave_len = interleave_ratio * len;
+  interleave_len &= PAGE_MASK;
+  unsigned long local_len = (len - interleave_len) & PAGE_MASK;
+
+  // validate input
+  DIEIF(r < 0.0 || r > 1.0, "specified ratio must be between 0 and 1!");
+  DIEIF(local_ratio < 0.0 || local_ratio > 1.0, "bad local_ratio calculation");
+  DIEIF(interleave_ratio < 0.0 || interleave_ratio > 1.0,
+        "bad interleave_ratio calculation");
+
+  return plan_local_bytes(topology, addr, interleave_len + local_len,
+                          local_len, tracker);
+}
+
+// the local part of each chunk is at its tail: equally hot chunks (e.g.
+// without samples) leave the same layout as picking the tail of the region
+PlacementPlan plan_local_bytes(const Topology &topology, void *addr,
+                               unsigned long len, unsigned long local_len,
+                               const AccessTracker *tracker) {
+  uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+  if (tracker == nullptr || !tracker->hasSamples()) {
+    PlacementPlan plan = plan_interleave_all(topology, addr,
+                                             len - local_len);
+    if (local_len > 0) {
+      plan.push_back({ start + len - local_len, local_len, MPOL_LOCAL, 0 });
+    }
+    return plan;
+  }
+
+  // the chunks of the region, hottest (then highest) first
+  struct Chunk {
+    uintptr_t start;
+    size_t length;
+    size_t local;
+  };
+  size_t chunk_size = tracker->chunkSize();
+  std::vector<Chunk> chunks;
+  for (uintptr_t chunk = start; chunk < start + len;) {
+    uintptr_t next = std::min<uintptr_t>(
+        start + len, (chunk / chunk_size + 1) * chunk_size);
+    chunks.push_back({ chunk, next - chunk, 0 });
+    chunk = next;
+  }
+  std::vector<size_t> order(chunks.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&chunks, tracker](size_t a, size_t b) {
+                     uint64_t heat_a = tracker->heat(chunks[a].start);
+                     uint64_t heat_b = tracker->heat(chunks[b].start);
+                     return heat_a != heat_b ? heat_a > heat_b : a > b;
+                   });
+  for (size_t i : order) {
+    chunks[i].local = std::min(chunks[i].length, local_len);
+    local_len -= chunks[i].local;
+  }
+
+  // adjacent ranges with the same policy are merged
+  PlacementPlan plan;
+  auto append = [&plan, &topology](uintptr_t from, size_t length, int mode) {
+    if (length == 0) {
+      return;
+    }
+    if (!plan.empty() && plan.back().end() == from
+        && plan.back().mode == mode) {
+      plan.back().length += length;
+    } else {
+      plan.push_back({ from, length, mode,
+          mode == MPOL_LOCAL ? 0 : topology.memoryMask() });
+    }
+  };
+  for (const Chunk &chunk : chunks) {
+    append(chunk.start, chunk.length - chunk.local, MPOL_INTERLEAVE);
+    append(chunk.start + chunk.length - chunk.local, chunk.local, MPOL_LOCAL);
+  }
+  return plan;
+}
+
+PlacementPlan plan_weighted(const Topology &topology, void *addr,
+                            unsigned long len,
+                            const std::vector<double> &weights) {
+  if (weighted_interleave_supported(topology)) {
+    PlacementPlan plan = plan_weighted_interleave(topology, addr, len,
+                                                  weights);
+    if (plan.empty() || weighted_interleave_compatible(
+            plan.front().weights.data(), plan.front().nodemask)) {
+      return plan;
+    }
+  }
+  return plan_weighted_slices(topology, addr, len, weights);
+}
+
+static double node_weight(const std::vector<double> &weights, int node) {
+  return node < static_cast<int>(weights.size()) ? weights[node] : 0;
+}
+
+// slices the region in consecutive ranges, each interleaved over the nodes
+// that still have weight left to receive (lightest nodes drop out first)
+PlacementPlan plan_weighted_slices(const Topology &topology, void *addr,
+                                   unsigned long len,
+                                   const std::vector<double> &weights) {
+  PlacementPlan plan;
+  uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+
+  std::vector<int> nodes = topology.memoryNodes();
+  std::stable_sort(nodes.begin(), nodes.end(), [&weights](int a, int b) {
+    return node_weight(weights, a) < node_weight(weights, b);
+  });
+
+  // nodes that can still receive pages
+  unsigned long node_set = topology.memoryMask();
+
+  double w = 0;  // weight already allocated among the remaining nodes
+  int a = nodes.size();  // number of nodes which can still receive pages
+
+  size_t total_size = 0;  // total size interleaved so far
+  for (size_t i = 0; i < nodes.size() && total_size < len; i++) {
+    // b = size that remains to allocate in the next node with smallest beta
+    double b = node_weight(weights, nodes[i]) - w;
+    size_t my_size = a * (b / 100) * len;
+
+    // round up to multiple of the page size
+    my_size = std::min<size_t>(PAGE_ALIGN_UP(my_size), len - total_size);
+
+    // only interleave if memory is in the region
+    if (my_size != 0) {
+      plan.push_back({ start, my_size, MPOL_INTERLEAVE, node_set });
+    }
+
+    total_size += my_size;
+    start += my_size;
+    a--;
+    w = node_weight(weights, nodes[i]);
+    node_set &= ~(1UL << nodes[i]);
+  }
+  return plan;
+}
+
+// the kernel weights are small integers: use the rounded percentages,
+// divided by their common divisor (so 50/50 becomes 1/1)
+PlacementPlan plan_weighted_interleave(const Topology &topology, void *addr,
+                                       unsigned long len,
+                                       const std::vector<double> &weights) {
+  PlacementPlan plan;
+  if (len == 0) {
+    return plan;
+  }
+  PlacementRange range = { reinterpret_cast<uintptr_t>(addr), len,
+      MPOL_WEIGHTED_INTERLEAVE, 0 };
+  int divisor = 0;
+  for (int node : topology.memoryNodes()) {
+    int weight = std::lround(node_weight(weights, node));
+    if (weight <= 0) {
+      continue;
+    }
+    range.nodemask |= 1UL << node;
+    range.weights[node] = weight;
+    divisor = std::gcd(divisor, weight);
+  }
+  DIEIF(range.nodemask == 0, "no node has weight to interleave on");
+  for (uint8_t &weight : range.weights) {
+    weight /= divisor;
+  }
+  plan.push_back(range);
+  return plan;
+}
+
+PlacementPlan plan_difference(const PlacementPlan &from,
+                              const PlacementPlan &to) {
+  PlacementPlan difference;
+  auto old_range = from.begin();
+
+  for (const PlacementRange &range : to) {
+    uintptr_t position = range.start;
+    while (position < range.end()) {
+      // skip old ranges that end before this position
+      while (old_range != from.end() && old_range->end() <= position) {
+        old_range++;
+      }
+
+      // find the extent of [position, next) with a single old policy
+      uintptr_t next = range.end();
+      bool changed = true;
+      if (old_range != from.end() && old_range->start <= position) {
+        next = std::min(next, old_range->end());
+        changed = !old_range->samePolicyAs(range);
+      } else if (old_range != from.end()) {
+        // not covered by the old layout up to the start of the next range
+        next = std::min(next, old_range->start);
+      }
+
+      if (changed) {
+        // extend the previous range if it is contiguous
+        if (!difference.empty() && difference.back().end() == position
+            && difference.back().samePolicyAs(range)) {
+          difference.back().length += next - position;
+        } else {
+          PlacementRange changed_range = range;
+          changed_range.start = position;
+          changed_range.length = next - position;
+          difference.push_back(changed_range);
+        }
+      }
+      position = next;
+    }
+  }
+  return difference;
+}
+
+size_t plan_length(const PlacementPlan &plan) {
+  size_t length = 0;
+  for (const PlacementRange &range : plan) {
+    length += range.length;
+  }
+  return length;
+}
+
+// if residency cannot be checked (e.g. a hole in the range), the whole batch
+// is taken as resident
+PlacementPlan plan_resident(const PlacementPlan &plan) {
+  PlacementPlan resident;
+  std::vector<unsigned char> residency;
+  for (const PlacementRange &range : plan) {
+    for (uintptr_t batch = range.start; batch < range.end();
+        batch += MINCORE_BATCH * PAGE_SIZE) {
+      size_t length = std::min(range.end() - batch,
+                               MINCORE_BATCH * PAGE_SIZE);
+      residency.resize(length / PAGE_SIZE);
+      if (mincore(reinterpret_cast<void*>(batch), length,
+                  residency.data()) != 0) {
+        std::fill(residency.begin(), residency.end(), 1);
+      }
+
+      // runs of resident pages, with the policy of the range
+      for (size_t i = 0; i < residency.size(); i++) {
+        if (!(residency[i] & 1)) {
+          continue;
+        }
+        uintptr_t page = batch + i * PAGE_SIZE;
+        if (!resident.empty() && resident.back().end() == page
+            && resident.back().samePolicyAs(range)) {
+          resident.back().length += PAGE_SIZE;
+        } else {
+          PlacementRange run = range;
+          run.start = page;
+          run.length = PAGE_SIZE;
+          resident.push_back(run);
+        }
+      }
+    }
+  }
+  return resident;
+}
+
+// the same proportions, with slices of plain interleaving
+static PlacementPlan weighted_as_slices(const PlacementRange &range) {
+  unsigned total = 0;
+  for (uint8_t weight : range.weights) {
+    total += weight;
+  }
+  std::vector<double> weights(MAX_PLAN_NODES);
+  for (int node = 0; node < MAX_PLAN_NODES; node++) {
+    weights[node] = 100.0 * range.weights[node] / total;
+  }
+  return plan_weighted_slices(Topology::getInstance(),
+                              reinterpret_cast<void*>(range.start),
+                              range.length, weights);
+}
+
+// pages already on one of the nodes of a weighted interleaved range are not
+// moved by mbind: the resident ones are moved explicitly (unless there is
+// only one node)
+static void apply_weighted_interleave(const PlacementRange &range,
+                                      unsigned flags) {
+  if (!weighted_interleave_program(range.weights.data(), range.nodemask)) {
+    LDEBUG("could not set the weighted interleave weights: slicing instead");
+    apply_plan(weighted_as_slices(range), flags);
+    return;
+  }
+  bool single_node = __builtin_popcountl(range.nodemask) == 1;
+  unsigned mbind_flags = single_node ? flags : 0;
+  LTRACEF("mbind(%p, %zu, MPOL_WEIGHTED_INTERLEAVE, 0x%lx, %lu, %u)",
+          range.start, range.length, range.nodemask, MAX_NODEMASK_BITS + 1,
+          mbind_flags);
+  if (WRAP(mbind)(reinterpret_cast<void*>(range.start), range.length,
+                  range.mode, &range.nodemask, MAX_NODEMASK_BITS + 1,
+                  mbind_flags) != 0) {
+    DIEIF(!unmapped(errno), "mbind weighted interleave failed");
+    LDEBUGF("[%p:%p] was unmapped while being placed", range.start,
+            range.end());
+    return;
+  }
+  if (!single_node && (flags & (MPOL_MF_MOVE | MPOL_MF_MOVE_ALL))) {
+    PlacementPlan resident = plan_resident(PlacementPlan { range });
+    if (!resident.empty()) {
+      move_plan_pages(resident, flags, -1);
+    }
+  }
+}
+
+void apply_plan(const PlacementPlan &plan, unsigned flags) {
+  for (const PlacementRange &range : plan) {
+    if (range.mode == MPOL_WEIGHTED_INTERLEAVE) {
+      apply_weighted_interleave(range, flags);
+      continue;
+    }
+    LTRACEF("mbind(%p, %zu, %d, 0x%lx, %lu, %u)", range.start, range.length,
+            range.mode, range.nodemask, MAX_NODEMASK_BITS + 1, flags);
+    if (WRAP(mbind)(reinterpret_cast<void*>(range.start), range.length,
+                    range.mode, &range.nodemask, MAX_NODEMASK_BITS + 1,
+                    flags) != 0) {
+      DIEIF(!unmapped(errno), "mbind failed");
+      LDEBUGF("[%p:%p] was unmapped while being placed", range.start,
+              range.end());
+    }
+  }
+}
+
+// without MPOL_MF_MOVE, mbind neither walks the pages nor drains the LRU
+// caches of every CPU (which is most of its cost on fresh mappings)
+size_t apply_plan_lazily(const PlacementPlan &plan) {
+  apply_plan(plan, 0);
+  PlacementPlan resident = plan_resident(plan);
+  if (!resident.empty()) {
+    move_plan_pages(resident, MPOL_MF_MOVE, -1);
+  }
+  return plan_length(resident);
+}
+
+// interleaved pages are spread by page number, like the kernel does
+static int page_node(const PlacementRange &range,
+                     const std::vector<int> &targets, uintptr_t page) {
+  if (range.mode == MPOL_INTERLEAVE) {
+    return targets[(page / PAGE_SIZE) % targets.size()];
+  } else if (range.mode == MPOL_WEIGHTED_INTERLEAVE) {
+    return weighted_interleave_node(range, page);
+  }
+  return targets[0];
+}
+
+static std::vector<int> range_nodes(const PlacementRange &range,
+                                    int local_node) {
+  std::vector<int> targets;
+  if (range.mode == MPOL_LOCAL) {
+    targets.push_back(local_node);
+  } else {
+    for (unsigned long n = 0; n < MAX_NODEMASK_BITS; n++) {
+      if (range.nodemask & (1UL << n)) {
+        targets.push_back(n);
+      }
+    }
+  }
+  return targets;
+}
+
+// the same, without allocating (it runs in the userfaultfd handler)
+int plan_page_node(const PlacementRange &range, uintptr_t page,
+                   int local_node) {
+  if (range.mode == MPOL_LOCAL) {
+    return local_node;
+  }
+  if (range.mode == MPOL_WEIGHTED_INTERLEAVE) {
+    return weighted_interleave_node(range, page);
+  }
+  int nodes = __builtin_popcountl(range.nodemask);
+  if (nodes == 0) {
+    return -1;
+  }
+  int k = range.mode == MPOL_INTERLEAVE ? (page / PAGE_SIZE) % nodes : 0;
+  unsigned long mask = range.nodemask;
+  for (; k > 0; k--) {
+    mask &= mask - 1;  // drop the lowest node
+  }
+  return __builtin_ctzl(mask);
+}
+
+size_t move_plan_pages(const PlacementPlan &plan, unsigned flags,
+                       int local_node) {
+  std::vector<void*> pages;
+  std::vector<int> nodes;
+  std::vector<int> status;
+  size_t calls = 0;
+
+  auto flush = [&]() {
+    if (pages.empty()) {
+      return;
+    }
+    status.resize(pages.size());
+    // unmapped pages only get an error status
+    if (move_pages(0, pages.size(), pages.data(), nodes.data(), status.data(),
+                   flags & (MPOL_MF_MOVE | MPOL_MF_MOVE_ALL)) < 0) {
+      DIEIF(!unmapped(errno), "move_pages failed");
+      LDEBUGF("[%p:%p] was unmapped while its pages were moved", pages[0],
+              pages.back());
+    }
+    calls++;
+    pages.clear();
+    nodes.clear();
+  };
+
+  for (const PlacementRange &range : plan) {
+    // without a node to call local, MPOL_LOCAL pages stay where they are:
+    // their policy already places the pages faulted in later
+    if (range.mode == MPOL_LOCAL && local_node < 0) {
+      LTRACEF("no local node to move [%p:%p] to", range.start, range.end());
+      continue;
+    }
+
+    // candidate nodes of this range
+    std::vector<int> targets = range_nodes(range, local_node);
+    if (targets.empty()) {
+      LWARNF("no node to move [%p:%p] to", range.start, range.end());
+      continue;
+    }
+
+    for (uintptr_t page = range.start; page < range.end(); page += PAGE_SIZE) {
+      pages.push_back(reinterpret_cast<void*>(page));
+      nodes.push_back(page_node(range, targets, page));
+      if (pages.size() == MOVE_PAGES_BATCH) {
+        flush();
+      }
+    }
+  }
+  flush();
+  return calls;
+}
+
+}  // namespace unstickymem
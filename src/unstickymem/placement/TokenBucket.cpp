@@ -0,0 +1,46 @@
+#include <algorithm>
+#include <thread>
+
+#include "unstickymem/placement/TokenBucket.hpp"
+
+namespace unstickymem {
+
+TokenBucket::TokenBucket(size_t rate)
+    : _rate(rate) {
+}
+
+size_t TokenBucket::getRate(void) {
+  std::scoped_lock lock(_lock);
+  return _rate;
+}
+
+void TokenBucket::setRate(size_t bytes_per_second) {
+  std::scoped_lock lock(_lock);
+  _rate = bytes_per_second;
+  _tokens = 0;
+  _last = Clock::now();
+}
+
+void TokenBucket::acquire(size_t bytes) {
+  double debt;
+  {
+    std::scoped_lock lock(_lock);
+    if (_rate == 0) {
+      return;
+    }
+    // refill since the last acquisition
+    Clock::time_point now = Clock::now();
+    double elapsed = std::chrono::duration<double>(now - _last).count();
+    _last = now;
+    _tokens = std::min(_tokens + elapsed * _rate, _rate / 10.0);
+
+    _tokens -= bytes;
+    debt = -_tokens / _rate;
+  }
+  // sleep without the lock: the next callers queue up behind our debt
+  if (debt > 0) {
+    std::this_thread::sleep_for(std::chrono::duration<double>(debt));
+  }
+}
+
+}  // namespace unstickymem
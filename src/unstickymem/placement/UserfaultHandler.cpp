@@ -0,0 +1,250 @@
+#include <fcntl.h>
+#include <numaif.h>
+#include <poll.h>
+#include <unistd.h>
+#include <linux/userfaultfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include "unstickymem/placement/UserfaultHandler.hpp"
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Logger.hpp"
+#include "unstickymem/wrap.hpp"
+
+namespace unstickymem {
+
+// fault messages read at once
+static const size_t USERFAULT_BATCH = 64;
+
+double UserfaultHandler::Statistics::faultsPerSecond(void) const {
+  return seconds > 0 ? faults / seconds : 0;
+}
+
+UserfaultHandler& UserfaultHandler::getInstance(void) {
+  static UserfaultHandler *object = nullptr;
+  if (!object) {
+    LDEBUG("Creating UserfaultHandler singleton object");
+    void *buf = WRAP(mmap)(nullptr, sizeof(UserfaultHandler),
+                           PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                           -1, 0);
+    DIEIF(buf == MAP_FAILED, "error allocating space for userfault handler");
+    object = new (buf) UserfaultHandler();
+  }
+  return *object;
+}
+
+// the faults of the kernel too: with UFFD_USER_MODE_ONLY, a system call
+// touching a missing page of a registered region (e.g. a read() into it)
+// fails with EFAULT. that takes privileges with vm.unprivileged_userfaultfd=0
+bool UserfaultHandler::start(void) {
+  std::scoped_lock lock(_lock);
+  if (_fd >= 0) {
+    return true;
+  }
+  int fd = syscall(SYS_userfaultfd, O_CLOEXEC);
+  if (fd < 0) {
+    LWARNF("userfaultfd is not available: %s", strerror(errno));
+    return false;
+  }
+  struct uffdio_api api = { };
+  api.api = UFFD_API;
+  if (ioctl(fd, UFFDIO_API, &api) != 0) {
+    LWARNF("userfaultfd API handshake failed: %s", strerror(errno));
+    close(fd);
+    return false;
+  }
+
+  _zero_page = WRAP(mmap)(nullptr, PAGE_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  DIEIF(_zero_page == MAP_FAILED, "could not allocate the userfault page");
+  _fd = fd;
+  std::thread(&UserfaultHandler::handleFaults, this).detach();
+  LINFO("placing pages on first touch with userfaultfd");
+  return true;
+}
+
+bool UserfaultHandler::isRunning(void) const {
+  return _fd >= 0;
+}
+
+bool UserfaultHandler::registerPlan(const PlacementPlan &plan) {
+  if (_fd < 0 || plan.empty()) {
+    return false;
+  }
+  uintptr_t start = plan.front().start;
+  struct uffdio_register reg = { };
+  reg.range.start = start;
+  reg.range.len = plan.back().end() - start;
+  reg.mode = UFFDIO_REGISTER_MODE_MISSING;
+
+  // the plan must be in place before the first fault comes in. nothing is
+  // allocated or freed under the lock: that could fault on a registered page
+  std::map<uintptr_t, PlacementPlan> entry = { { start, plan } };
+  int error;
+  {
+    std::scoped_lock lock(_lock);
+    _plans.insert(entry.extract(start));
+    if (ioctl(_fd, UFFDIO_REGISTER, &reg) == 0) {
+      return true;
+    }
+    error = errno;
+    entry.insert(_plans.extract(start));
+  }
+  LDEBUGF("could not register [%p:%p] with userfaultfd: %s",
+          reinterpret_cast<void*>(start),
+          reinterpret_cast<void*>(plan.back().end()), strerror(error));
+  return false;
+}
+
+// the ranges of the plan within [start, end)
+static PlacementPlan clip_plan(const PlacementPlan &plan, uintptr_t start,
+                               uintptr_t end) {
+  PlacementPlan clipped;
+  for (const PlacementRange &range : plan) {
+    uintptr_t lo = std::max(range.start, start);
+    uintptr_t hi = std::min(range.end(), end);
+    if (lo < hi) {
+      PlacementRange piece = range;
+      piece.start = lo;
+      piece.length = hi - lo;
+      clipped.push_back(piece);
+    }
+  }
+  return clipped;
+}
+
+// the kernel forgets the registration of the pages that are unmapped. the
+// plans overlapping the range are taken out, trimmed (outside of the lock)
+// and put back: their pages touched meanwhile are counted as misplaced
+void UserfaultHandler::unregister(uintptr_t start, size_t length) {
+  uintptr_t end = start + length;
+  std::map<uintptr_t, PlacementPlan> removed;
+  {
+    std::scoped_lock lock(_lock);
+    auto plan = _plans.lower_bound(start);
+    if (plan != _plans.begin()) {
+      auto previous = std::prev(plan);
+      if (previous->second.back().end() > start) {
+        plan = previous;
+      }
+    }
+    while (plan != _plans.end() && plan->first < end) {
+      removed.insert(_plans.extract(plan++));
+    }
+  }
+
+  std::map<uintptr_t, PlacementPlan> kept;
+  for (const auto &plan : removed) {
+    uintptr_t plan_start = plan.first;
+    uintptr_t plan_end = plan.second.back().end();
+    for (PlacementPlan piece : { clip_plan(plan.second, plan_start, start),
+                                 clip_plan(plan.second, end, plan_end) }) {
+      if (!piece.empty()) {
+        uintptr_t piece_start = piece.front().start;
+        kept.emplace(piece_start, std::move(piece));
+      }
+    }
+  }
+  if (kept.empty()) {
+    return;
+  }
+  std::scoped_lock lock(_lock);
+  _plans.merge(kept);
+}
+
+// their pages are then allocated by the kernel, under the regions' policies
+void UserfaultHandler::unregisterAll(void) {
+  std::map<uintptr_t, PlacementPlan> removed;
+  {
+    std::scoped_lock lock(_lock);
+    removed.swap(_plans);
+  }
+  for (const auto &plan : removed) {
+    struct uffdio_range range = { };
+    range.start = plan.first;
+    range.len = plan.second.back().end() - plan.first;
+    ioctl(_fd, UFFDIO_UNREGISTER, &range);
+  }
+}
+
+UserfaultHandler::Statistics UserfaultHandler::statistics(void) const {
+  Statistics statistics;
+  statistics.faults = _faults;
+  statistics.misplaced = _misplaced;
+  statistics.seconds = _nanoseconds / 1e9;
+  return statistics;
+}
+
+int UserfaultHandler::pageNode(uintptr_t page) {
+  std::scoped_lock lock(_lock);
+  auto plan = _plans.upper_bound(page);
+  if (plan == _plans.begin()) {
+    return -1;
+  }
+  --plan;
+  for (const PlacementRange &range : plan->second) {
+    if (page >= range.start && page < range.end()) {
+      return plan_page_node(range, page, -1);
+    }
+  }
+  return -1;
+}
+
+// pages outside of any plan are still filled in, or the thread that touched
+// them would wait forever
+void UserfaultHandler::resolve(uintptr_t address) {
+  uintptr_t page = address & PAGE_MASK;
+  int node = pageNode(page);
+  if (node < 0) {
+    _misplaced++;
+  } else if (node != _bound_node) {
+    unsigned long nodemask = 1UL << node;
+    if (set_mempolicy(MPOL_BIND, &nodemask, sizeof(nodemask) * 8) == 0) {
+      _bound_node = node;
+    }
+  }
+
+  struct uffdio_copy copy = { };
+  copy.dst = page;
+  copy.src = reinterpret_cast<uintptr_t>(_zero_page);
+  copy.len = PAGE_SIZE;
+  // EEXIST: another fault on the same page was resolved first
+  if (ioctl(_fd, UFFDIO_COPY, &copy) != 0 && errno != EEXIST) {
+    struct uffdio_range range = { page, static_cast<uint64_t>(PAGE_SIZE) };
+    ioctl(_fd, UFFDIO_WAKE, &range);
+  }
+}
+
+void UserfaultHandler::handleFaults(void) {
+  struct uffd_msg messages[USERFAULT_BATCH];
+  struct pollfd pfd = { _fd, POLLIN, 0 };
+  while (true) {
+    if (poll(&pfd, 1, -1) < 0) {
+      continue;
+    }
+    ssize_t bytes = read(_fd, messages, sizeof(messages));
+    if (bytes <= 0) {
+      continue;
+    }
+    auto start = std::chrono::steady_clock::now();
+    size_t count = bytes / sizeof(struct uffd_msg);
+    for (size_t i = 0; i < count; i++) {
+      if (messages[i].event == UFFD_EVENT_PAGEFAULT) {
+        _faults++;  // before the faulting thread is woken up
+        resolve(messages[i].arg.pagefault.address);
+      }
+    }
+    _nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count();
+  }
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,187 @@
+#include <unistd.h>
+#include <numaif.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <mutex>
+
+#include "unstickymem/placement/WeightedInterleave.hpp"
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Logger.hpp"
+
+namespace unstickymem {
+
+static const char WEIGHTS_PATH[] = "/sys/kernel/mm/mempolicy/weighted_interleave";
+
+// serializes the updates of the kernel weights
+static std::mutex weights_lock;
+
+// set by the library constructor: only constant-initialized globals
+static bool writes_allowed = false;
+
+static bool probed = false;
+static bool supported = false;
+
+// the weights this process relies on (0 for the nodes it does not use yet):
+// the kernel weights are read at fault time, so every weighted range of the
+// process must share them
+static uint8_t claimed_weights[MAX_PLAN_NODES];
+// the weights before we changed them, put back at exit (-1 if unchanged)
+static int original_weights[MAX_PLAN_NODES];
+
+static void node_weight_path(char *buf, size_t size, int node) {
+  snprintf(buf, size, "%s/node%d", WEIGHTS_PATH, node);
+}
+
+static int read_node_weight(int node) {
+  char path[256];
+  node_weight_path(path, sizeof(path), node);
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    return -1;
+  }
+  int weight = -1;
+  if (fscanf(f, "%d", &weight) != 1) {
+    weight = -1;
+  }
+  fclose(f);
+  return weight;
+}
+
+static bool write_node_weight(int node, int weight) {
+  char path[256];
+  node_weight_path(path, sizeof(path), node);
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    return false;
+  }
+  bool ok = fprintf(f, "%d", weight) > 0;
+  ok = (fclose(f) == 0) && ok;
+  return ok;
+}
+
+// only the weights that are still ours: another process may have set them
+// since
+static void restore_weights(void) {
+  std::scoped_lock lock(weights_lock);
+  for (int node = 0; node < MAX_PLAN_NODES; node++) {
+    if (original_weights[node] >= 0
+        && read_node_weight(node) == claimed_weights[node]) {
+      LDEBUGF("restoring weighted interleave weight of node %d to %d", node,
+              original_weights[node]);
+      write_node_weight(node, original_weights[node]);
+    }
+  }
+}
+
+void weighted_interleave_allow_writes(bool allowed) {
+  std::scoped_lock lock(weights_lock);
+  writes_allowed = allowed;
+  probed = false;
+}
+
+// read-only: every node we may allocate from needs a weight we could write
+static bool probe(const Topology &topology) {
+  if (!probed) {
+    std::fill(std::begin(original_weights), std::end(original_weights), -1);
+    supported = writes_allowed;
+    for (int node : topology.memoryNodes()) {
+      char path[256];
+      node_weight_path(path, sizeof(path), node);
+      if (node >= MAX_PLAN_NODES || access(path, W_OK) != 0) {
+        supported = false;
+      }
+    }
+    if (supported) {
+      atexit(restore_weights);
+    }
+    probed = true;
+    LDEBUGF("native weighted interleave %s",
+            supported ? "available" :
+            writes_allowed ? "not available (slicing regions)" :
+                             "not enabled (slicing regions)");
+  }
+  return supported;
+}
+
+bool weighted_interleave_supported(const Topology &topology) {
+  std::scoped_lock lock(weights_lock);
+  return probe(topology);
+}
+
+// ranges placed before rely on the weights we set
+static bool conflicts(const uint8_t weights[], unsigned long nodemask) {
+  for (int node = 0; node < MAX_PLAN_NODES; node++) {
+    if ((nodemask & (1UL << node)) && weights[node] != 0
+        && claimed_weights[node] != 0
+        && claimed_weights[node] != weights[node]) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool weighted_interleave_compatible(const uint8_t weights[],
+                                    unsigned long nodemask) {
+  std::scoped_lock lock(weights_lock);
+  return !conflicts(weights, nodemask);
+}
+
+bool weighted_interleave_program(const uint8_t weights[],
+                                 unsigned long nodemask) {
+  std::scoped_lock lock(weights_lock);
+  if (!probe(Topology::getInstance()) || conflicts(weights, nodemask)) {
+    return false;
+  }
+  for (int node = 0; node < MAX_PLAN_NODES; node++) {
+    if (!(nodemask & (1UL << node)) || weights[node] == 0
+        || claimed_weights[node] != 0) {
+      continue;
+    }
+    int current = read_node_weight(node);
+    if (current != weights[node]) {
+      LDEBUGF("setting weighted interleave weight of node %d to %d", node,
+              weights[node]);
+      if (!write_node_weight(node, weights[node])) {
+        // from now on, plans slice the regions instead
+        LWARNF("could not set the weighted interleave weight of node %d",
+               node);
+        supported = false;
+        return false;
+      }
+      original_weights[node] = current;
+    }
+    claimed_weights[node] = weights[node];
+  }
+  return true;
+}
+
+// mirrors the kernel: pages are handed out in runs of `weight` pages per
+// node, going through the nodes in order
+int weighted_interleave_node(const PlacementRange &range, uintptr_t page) {
+  unsigned total = 0;
+  for (int node = 0; node < static_cast<int>(sizeof(range.nodemask) * 8);
+      node++) {
+    if (range.nodemask & (1UL << node)) {
+      total += range.weights[node];
+    }
+  }
+  DIEIF(total == 0, "weighted interleave range without weights");
+
+  unsigned target = (page / PAGE_SIZE) % total;
+  for (int node = 0; node < static_cast<int>(sizeof(range.nodemask) * 8);
+      node++) {
+    if (!(range.nodemask & (1UL << node))) {
+      continue;
+    }
+    if (target < range.weights[node]) {
+      return node;
+    }
+    target -= range.weights[node];
+  }
+  return -1;
+}
+
+}  // namespace unstickymem
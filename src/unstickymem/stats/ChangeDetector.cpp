@@ -0,0 +1,41 @@
+#include <algorithm>
+
+#include "unstickymem/stats/ChangeDetector.hpp"
+
+namespace unstickymem {
+
+PageHinkley::PageHinkley(double drift, double threshold)
+    : _drift(drift),
+      _threshold(threshold) {
+}
+
+bool PageHinkley::add(double x) {
+  _count++;
+  _mean += (x - _mean) / _count;
+
+  _up += x - _mean - _drift;
+  _min_up = std::min(_min_up, _up);
+  _down += x - _mean + _drift;
+  _max_down = std::max(_max_down, _down);
+
+  return _up - _min_up > _threshold || _max_down - _down > _threshold;
+}
+
+void PageHinkley::reset(void) {
+  _count = 0;
+  _mean = 0;
+  _up = 0;
+  _min_up = 0;
+  _down = 0;
+  _max_down = 0;
+}
+
+size_t PageHinkley::count(void) const {
+  return _count;
+}
+
+double PageHinkley::mean(void) const {
+  return _mean;
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include "unstickymem/stats/Estimators.hpp"
+
+namespace unstickymem {
+
+void RunningStats::add(double x) {
+  _count++;
+  double delta = x - _mean;
+  _mean += delta / _count;
+  _m2 += delta * (x - _mean);
+}
+
+void RunningStats::clear(void) {
+  _count = 0;
+  _mean = 0;
+  _m2 = 0;
+}
+
+size_t RunningStats::count(void) const {
+  return _count;
+}
+
+double RunningStats::mean(void) const {
+  return _mean;
+}
+
+double RunningStats::variance(void) const {
+  return _count < 2 ? 0 : _m2 / (_count - 1);
+}
+
+double RunningStats::stddev(void) const {
+  return sqrt(variance());
+}
+
+double RunningStats::halfWidth(double confidence) const {
+  if (_count < 2) {
+    return std::numeric_limits<double>::infinity();
+  }
+  return student_t_quantile((1 + confidence) / 2, _count - 1) * stddev()
+      / sqrt(_count);
+}
+
+Ewma::Ewma(double alpha)
+    : _alpha(alpha) {
+}
+
+void Ewma::add(double x) {
+  if (_empty) {
+    _mean = x;
+    _variance = 0;
+    _empty = false;
+    return;
+  }
+  double delta = x - _mean;
+  _mean += _alpha * delta;
+  _variance = (1 - _alpha) * (_variance + _alpha * delta * delta);
+}
+
+void Ewma::clear(void) {
+  _mean = 0;
+  _variance = 0;
+  _empty = true;
+}
+
+bool Ewma::empty(void) const {
+  return _empty;
+}
+
+double Ewma::mean(void) const {
+  return _mean;
+}
+
+double Ewma::variance(void) const {
+  return _variance;
+}
+
+WindowedStats::WindowedStats(size_t size)
+    : _samples(size) {
+}
+
+void WindowedStats::add(double x) {
+  _samples[_next] = x;
+  _next = (_next + 1) % _samples.size();
+  _count = std::min(_count + 1, _samples.size());
+}
+
+void WindowedStats::clear(void) {
+  _next = 0;
+  _count = 0;
+}
+
+size_t WindowedStats::count(void) const {
+  return _count;
+}
+
+bool WindowedStats::full(void) const {
+  return _count == _samples.size();
+}
+
+// the samples in the window, sorted (the oldest are the first _count ones
+// when the buffer has not wrapped yet)
+std::vector<double> WindowedStats::sorted(void) const {
+  std::vector<double> samples(_samples.begin(), _samples.begin() + _count);
+  std::sort(samples.begin(), samples.end());
+  return samples;
+}
+
+double WindowedStats::mean(void) const {
+  if (_count == 0) {
+    return 0;
+  }
+  return std::accumulate(_samples.begin(), _samples.begin() + _count, 0.0)
+      / _count;
+}
+
+static double sorted_median(const std::vector<double> &samples) {
+  size_t n = samples.size();
+  if (n == 0) {
+    return 0;
+  }
+  return n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+}
+
+double WindowedStats::median(void) const {
+  return sorted_median(sorted());
+}
+
+// 1.4826 makes the MAD of normally distributed samples their stddev
+double WindowedStats::mad(void) const {
+  std::vector<double> samples = sorted();
+  double median = sorted_median(samples);
+  for (double &sample : samples) {
+    sample = fabs(sample - median);
+  }
+  std::sort(samples.begin(), samples.end());
+  return 1.4826 * sorted_median(samples);
+}
+
+double WindowedStats::trimmedMean(double fraction) const {
+  std::vector<double> samples = sorted();
+  size_t trim = samples.size() * fraction;
+  if (samples.size() <= 2 * trim) {
+    return sorted_median(samples);
+  }
+  return std::accumulate(samples.begin() + trim, samples.end() - trim, 0.0)
+      / (samples.size() - 2 * trim);
+}
+
+Estimate estimate(const std::function<double()> &sample, useconds_t period,
+                  double relative_precision, double budget, size_t min_samples,
+                  double confidence) {
+  return sample_until(sample, period, budget, min_samples,
+                      [&](const RunningStats &stats) {
+                        return stats.halfWidth(confidence)
+                            <= relative_precision * fabs(stats.mean());
+                      }, confidence);
+}
+
+Estimate sample_until(const std::function<double()> &sample,
+                      useconds_t period, double budget, size_t min_samples,
+                      const std::function<bool(const RunningStats&)> &done,
+                      double confidence) {
+  auto start = std::chrono::steady_clock::now();
+  WindowedStats recent(OUTLIER_WINDOW);
+  Estimate result = { 0, 0, 0, 0, 0, false, RunningStats() };
+  RunningStats &stats = result.stats;
+
+  while (true) {
+    double x = sample();
+
+    // the window keeps the outliers too: if the signal moved for good, the
+    // median follows it and the new level stops being discarded
+    double mad = recent.mad();
+    if (recent.count() >= min_samples && mad > 0
+        && fabs(x - recent.median()) > OUTLIER_MADS * mad) {
+      result.outliers++;
+    } else {
+      stats.add(x);
+    }
+    recent.add(x);
+
+    result.seconds = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - start).count();
+    if (stats.count() >= min_samples && done(stats)) {
+      result.converged = true;
+      break;
+    }
+    if (result.seconds + period / 1e6 > budget) {
+      break;
+    }
+    usleep(period);
+  }
+
+  result.mean = stats.mean();
+  result.half_width = stats.halfWidth(confidence);
+  result.samples = stats.count();
+  return result;
+}
+
+// Acklam's rational approximation (relative error below 1.2e-9)
+double normal_quantile(double p) {
+  static const double a[] = { -3.969683028665376e+01, 2.209460984245205e+02,
+      -2.759285104469687e+02, 1.383577518672690e+02, -3.066479806614716e+01,
+      2.506628277459239e+00 };
+  static const double b[] = { -5.447609879822406e+01, 1.615858368580409e+02,
+      -1.556989798598866e+02, 6.680131188771972e+01, -1.328068155288572e+01 };
+  static const double c[] = { -7.784894002430293e-03, -3.223964580411365e-01,
+      -2.400758277161838e+00, -2.549732539343734e+00, 4.374664141464968e+00,
+      2.938163982698783e+00 };
+  static const double d[] = { 7.784695709041462e-03, 3.224671290700398e-01,
+      2.445134137142996e+00, 3.754408661907416e+00 };
+  static const double p_low = 0.02425;
+
+  if (p <= 0) {
+    return -std::numeric_limits<double>::infinity();
+  }
+  if (p >= 1) {
+    return std::numeric_limits<double>::infinity();
+  }
+  if (p < p_low || p > 1 - p_low) {
+    double q = sqrt(-2 * log(p < p_low ? p : 1 - p));
+    double x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q
+        + c[5]) / ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+    return p < p_low ? x : -x;
+  }
+  double q = p - 0.5;
+  double r = q * q;
+  return (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5])
+      * q / (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+}
+
+// exact for 1 and 2 degrees of freedom, Cornish-Fisher expansion otherwise
+// (within 0.2% of the tables from 3 degrees of freedom at p = 0.975)
+double student_t_quantile(double p, double df) {
+  if (df <= 1) {
+    return tan(M_PI * (p - 0.5));
+  }
+  if (df <= 2) {
+    return (2 * p - 1) / sqrt(2 * p * (1 - p));
+  }
+  double z = normal_quantile(p);
+  double z2 = z * z;
+  double z3 = z2 * z, z5 = z3 * z2, z7 = z5 * z2, z9 = z7 * z2;
+  return z + (z3 + z) / (4 * df)
+      + (5 * z5 + 16 * z3 + 3 * z) / (96 * df * df)
+      + (3 * z7 + 19 * z5 + 17 * z3 - 15 * z) / (384 * df * df * df)
+      + (79 * z9 + 776 * z7 + 1482 * z5 - 1920 * z3 - 945 * z)
+      / (92160 * df * df * df * df);
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,57 @@
+#include <algorithm>
+#include <cmath>
+
+#include "unstickymem/stats/HypothesisTest.hpp"
+
+namespace unstickymem {
+
+Verdict welch_test(const RunningStats &candidate,
+                   const RunningStats &reference, double alpha,
+                   double equivalence) {
+  if (candidate.count() < 2 || reference.count() < 2) {
+    return Verdict::INCONCLUSIVE;
+  }
+  double v1 = candidate.variance() / candidate.count();
+  double v2 = reference.variance() / reference.count();
+  double difference = candidate.mean() - reference.mean();
+  double margin = equivalence * fabs(reference.mean());
+
+  // identical samples (e.g. no counters): no variance to test with
+  if (v1 + v2 == 0) {
+    return fabs(difference) <= margin ? Verdict::SAME :
+           difference < 0 ? Verdict::BETTER : Verdict::WORSE;
+  }
+
+  // Welch-Satterthwaite degrees of freedom
+  double df = (v1 + v2) * (v1 + v2)
+      / (v1 * v1 / (candidate.count() - 1)
+          + v2 * v2 / (reference.count() - 1));
+  double half_width = student_t_quantile(1 - alpha / 2, df) * sqrt(v1 + v2);
+
+  if (difference + half_width < 0) {
+    return Verdict::BETTER;
+  }
+  if (difference - half_width > 0) {
+    return Verdict::WORSE;
+  }
+  if (fabs(difference) + half_width <= margin) {
+    return Verdict::SAME;
+  }
+  return Verdict::INCONCLUSIVE;
+}
+
+Comparison compare(const std::function<double()> &sample, useconds_t period,
+                   const RunningStats &reference, double alpha,
+                   double equivalence, double budget, size_t min_samples) {
+  size_t tests = std::max(1.0, budget / std::max(period / 1e6, 1e-3));
+  double test_alpha = alpha / tests;
+  Verdict verdict = Verdict::INCONCLUSIVE;
+  Estimate candidate = sample_until(sample, period, budget, min_samples,
+                                    [&](const RunningStats &stats) {
+    verdict = welch_test(stats, reference, test_alpha, equivalence);
+    return verdict != +Verdict::INCONCLUSIVE;
+  });
+  return { verdict, candidate };
+}
+
+}  // namespace unstickymem
@@ -0,0 +1,47 @@
+#include <algorithm>
+
+#include "unstickymem/stats/Search.hpp"
+
+namespace unstickymem {
+
+double golden_section_search(const std::function<double(double)> &f,
+                             double lo, double hi, double tolerance,
+                             std::map<double, double> *evaluations) {
+  std::map<double, double> local;
+  std::map<double, double> &seen = evaluations ? *evaluations : local;
+  auto evaluate = [&](double x) {
+    auto it = seen.find(x);
+    return it != seen.end() ? it->second : (seen[x] = f(x));
+  };
+
+  double c = hi - (hi - lo) * GOLDEN_RATIO_CONJUGATE;
+  double d = lo + (hi - lo) * GOLDEN_RATIO_CONJUGATE;
+  double fc = evaluate(c);
+  double fd = evaluate(d);
+  while (hi - lo > tolerance) {
+    if (fc < fd) {
+      // the minimum is in [lo, d]: the old c is the new d
+      hi = d;
+      d = c;
+      fd = fc;
+      c = hi - (hi - lo) * GOLDEN_RATIO_CONJUGATE;
+      fc = evaluate(c);
+    } else {
+      // the minimum is in [c, hi]: the old d is the new c
+      lo = c;
+      c = d;
+      fc = fd;
+      d = lo + (hi - lo) * GOLDEN_RATIO_CONJUGATE;
+      fd = evaluate(d);
+    }
+  }
+
+  // the best point evaluated (including any given beforehand)
+  return std::min_element(seen.begin(), seen.end(),
+                          [](const std::pair<const double, double> &a,
+                             const std::pair<const double, double> &b) {
+                            return a.second < b.second;
+                          })->first;
+}
+
+}  // namespace unstickymem
@@ -1,5 +1,6 @@
 #include <unistd.h>
 #include <dlfcn.h>
+#include <malloc.h>
 #include <sys/types.h>
 #include <sys/syscall.h>
 
@@ -15,41 +16,95 @@
 #include <boost/interprocess/shared_memory_object.hpp>
 
 #include "unstickymem/unstickymem.h"
+#include "unstickymem/Calibration.hpp"
 #include "unstickymem/PerformanceCounters.hpp"
 #include "unstickymem/PagePlacement.hpp"
 #include "unstickymem/Logger.hpp"
 #include "unstickymem/wrap.hpp"
 #include "unstickymem/Runtime.hpp"
+#include "unstickymem/Topology.hpp"
 #include "unstickymem/memory/MemoryMap.hpp"
 #include "unstickymem/mode/Mode.hpp"
 
-// hold the nodes information ids and weights
-RECORD nodes_info[MAX_NODES];
-// sum of worker nodes weights
-double sum_ww = 0;
-// sum of non-worker nodes weights
-double sum_nww = 0;
-// number of workers
-static bool OPT_NUM_WORKERS = false;
-int OPT_NUM_WORKERS_VALUE = 1;
-
 namespace unstickymem {
 
 static bool is_initialized = false;
 thread_local static bool inside_unstickymem = false;
+// allocations below this size are served by the real allocator right away
+static size_t alloc_threshold = 0;
 Runtime *runtime;
 MemoryMap *memory;
 
+// these are set by the library constructor, which may run before the
+// dynamic initializers of this file: only constant-initialized globals
+
+// node weights from a file instead of calibrating them
+static const char *weights_file = nullptr;
+// where the calibrated weights are cached ("" to always calibrate)
+static const char *calibration_cache = nullptr;
+// where the stall counts come from (perf, likwid, none or auto)
+static const char *counter_backend = "auto";
+
+// worker nodes: an explicit list, or the first N nodes we can run on
 void read_config(void) {
-  OPT_NUM_WORKERS = std::getenv("UNSTICKYMEM_WORKERS") != nullptr;
-  if (OPT_NUM_WORKERS) {
-    OPT_NUM_WORKERS_VALUE = std::stoi(std::getenv("UNSTICKYMEM_WORKERS"));
+  Topology &topology = Topology::getInstance();
+  if (std::getenv("UNSTICKYMEM_WORKER_NODES") != nullptr) {
+    topology.setWorkerNodes(
+        Topology::parseNodeList(std::getenv("UNSTICKYMEM_WORKER_NODES")));
+  } else if (std::getenv("UNSTICKYMEM_WORKERS") != nullptr) {
+    size_t num_workers = std::stoul(std::getenv("UNSTICKYMEM_WORKERS"));
+    std::vector<int> nodes = topology.cpuNodes();
+    DIEIF(num_workers == 0 || num_workers > nodes.size(),
+          "UNSTICKYMEM_WORKERS must be between 1 and the number of nodes");
+    nodes.resize(num_workers);
+    topology.setWorkerNodes(nodes);
+  }
+  weights_file = std::getenv("UNSTICKYMEM_WEIGHTS");
+  calibration_cache = std::getenv("UNSTICKYMEM_CALIBRATION_CACHE");
+  if (std::getenv("UNSTICKYMEM_COUNTERS") != nullptr) {
+    counter_backend = std::getenv("UNSTICKYMEM_COUNTERS");
   }
 }
 
 void print_config(void) {
-  LINFOF("num_workers: %s",
-         OPT_NUM_WORKERS ? std::to_string(OPT_NUM_WORKERS_VALUE).c_str() : "no");
+  std::string workers;
+  for (int node : Topology::getInstance().workerNodes()) {
+    workers += (workers.empty() ? "" : ",") + std::to_string(node);
+  }
+  LINFOF("worker nodes: %s", workers.c_str());
+  LINFOF("weights: %s", weights_file ? weights_file : "calibrated");
+  LINFOF("calibration cache: %s", calibration_cache ?
+      (*calibration_cache ? calibration_cache : "none") : "default");
+  LINFOF("counters: %s", counter_backend);
+}
+
+// weights from the given file, or proportional to the node bandwidths
+static void initialize_weights(void) {
+  Topology &topology = Topology::getInstance();
+  if (weights_file == nullptr) {
+    topology.setWeights(calibrated_weights(
+        topology, calibration_cache ? calibration_cache :
+                                      default_calibration_cache()));
+  } else {
+    topology.setWeights(read_weights(weights_file));
+  }
+  LINFO("weights initialized!");
+
+  double sum_ww = topology.workerWeight();
+  double sum_nww = topology.nonWorkerWeight();
+  if ((int) round((sum_nww + sum_ww)) != 100) {
+    LDEBUGF(
+        "Sum of WW and NWW must be equal to 100! WW=%.2f\tNWW=%.2f\tSUM=%.2f\n",
+        sum_ww, sum_nww, sum_nww + sum_ww);
+    exit(-1);
+  } else {
+    LDEBUGF("WW = %.2f\tNWW = %.2f\n", sum_ww, sum_nww);
+  }
+  if (sum_nww <= 0) {
+    LWARN("no weight outside the worker nodes: the weighted modes have no "
+          "pages to move (set UNSTICKYMEM_WORKER_NODES)");
+  }
+  topology.print();
 }
 
 // library initialization
@@ -59,20 +114,30 @@ __attribute__((constructor)) void libunstickymem_initialize(void) {
   // initialize pointers to wrapped functions
   unstickymem::init_real_functions();
 
-  // initialize likwid
-  initialize_likwid();
-
   // parse and display the configuration
   read_config();
   print_config();
 
-  //set sum_ww & sum_nww & initialize the weights!
-  get_sum_nww_ww(OPT_NUM_WORKERS_VALUE);
+  // start the performance counters
+  initialize_counters(counter_backend);
+
+  // select the mode
+  runtime = &Runtime::getInstance();
+  alloc_threshold = runtime->getAllocThreshold();
+
+  // initialize the weights of the worker and non-worker nodes (calibrating
+  // takes a while: only if the mode needs them)
+  if (runtime->getMode()->usesWeights()) {
+    initialize_weights();
+  } else {
+    LINFO("the mode does not use the node weights: not initializing them");
+    Topology::getInstance().print();
+  }
 
   // set default memory policy to interleaved
   LDEBUG("Setting default memory policy to interleaved");
-   set_mempolicy(MPOL_INTERLEAVE, numa_get_mems_allowed()->maskp,
-   numa_get_mems_allowed()->size + 1);
+  unsigned long memory_mask = Topology::getInstance().memoryMask();
+  set_mempolicy(MPOL_INTERLEAVE, &memory_mask, sizeof(memory_mask) * 8 + 1);
 
   // remove the previous unstickymem library segment (if exists)
   // boost::interprocess::shared_memory_object::remove("unstickymem");
@@ -80,7 +145,9 @@ __attribute__((constructor)) void libunstickymem_initialize(void) {
   memory = &MemoryMap::getInstance();
 
   // start the runtime
-  runtime = &Runtime::getInstance();
+  if (runtime->getAutostart()) {
+    runtime->startSelectedMode();
+  }
 
   is_initialized = true;
   LDEBUG("Initialized");
@@ -91,7 +158,10 @@ __attribute((destructor)) void libunstickymem_finalize(void) {
   // cleanup shared memory object
   // boost::interprocess::shared_memory_object::remove("unstickymem");
 
-  // stop all the counters
+  // stop the threads of the mode, then all the counters
+  if (runtime != nullptr) {
+    runtime->getMode()->stop();
+  }
   stop_all_counters();
   LINFO("Finalized");
 }
@@ -102,16 +172,6 @@ __attribute((destructor)) void libunstickymem_finalize(void) {
 extern "C" {
 #endif
 
-int check_sum(RECORD n_i[MAX_NODES]) {
-  double sum = 0;
-  int i = 0;
-
-  for (i = 0; i < MAX_NODES; i++) {
-    sum += n_i[i].weight;
-  }
-  return std::lround(sum);
-}
-
 void unstickymem_nop(void) {
   LDEBUG("unstickymem NO-OP!");
 }
@@ -125,150 +185,50 @@ void unstickymem_print_memory(void) {
   unstickymem::memory->print();
 }
 
-void read_weights(char filename[]) {
-  FILE * fp;
-  char * line = NULL;
-  size_t len = 0;
-  ssize_t read;
-
-  const char s[2] = " ";
-  char *token;
-
-  int retcode;
-  // First sort the file if not sorted
-  char cmdbuf[256];
-  snprintf(cmdbuf, sizeof(cmdbuf), "sort -n -o %s %s", filename, filename);
-  retcode = system(cmdbuf);
-  if (retcode == -1) {
-    printf("Unable to sort the weights!");
-    exit (EXIT_FAILURE);
-  }
-
-  int j = 0;
-
-  fp = fopen(filename, "r");
-  if (fp == NULL) {
-    printf("Weights have not been provided!\n");
-    exit (EXIT_FAILURE);
-  }
-
-  while ((read = getline(&line, &len, fp)) != -1) {
-    char *strtok_saveptr;
-    // printf("Retrieved line of length %zu :\n", read);
-    // printf("%s", line);
-
-    // get the first token
-    token = strtok_r(line, s, &strtok_saveptr);
-    nodes_info[j].weight = atof(token);
-    // printf(" %s\n", token);
-
-    // get the second token
-    token = strtok_r(NULL, s, &strtok_saveptr);
-    nodes_info[j].id = atoi(token);
-    // printf(" %s\n", token);
-    j++;
-  }
-
-  /* int i;
-   printf("Initial Weights:\t");
-   for (i = 0; i < MAX_NODES; i++) {
-   printf("id: %d w: %.1f\t", nodes_info[i].id, nodes_info[i].weight);
-   }
-   printf("\n");*/
+void unstickymem_report_progress(uint64_t ops) {
+  unstickymem::report_progress(ops);
+}
 
-  fclose(fp);
-  if (line)
-    free(line);
+void unstickymem_iteration_done(void) {
+  unstickymem::iteration_done();
+}
 
-  LINFO("weights initialized!");
+void unstickymem_phase_begin(const char *name) {
+  LDEBUGF("Beginning phase %s", name);
+  unstickymem::runtime->getMode()->processPhaseBegin(name);
+}
 
-  return;
+void unstickymem_phase_end(void) {
+  LDEBUG("Ending phase");
+  unstickymem::runtime->getMode()->processPhaseEnd();
 }
 
-void get_sum_nww_ww(int num_workers) {
-  int i;
-
-  if (num_workers == 1) {
-    //workers: 0
-    char weights[] = "/home/dgureya/devs/unstickymem/config/weights_1w.txt";
-    read_weights(weights);
-    //printf("Worker Nodes:\t");
-    LDEBUG("Worker Nodes: 0");
-    for (i = 0; i < MAX_NODES; i++) {
-      if (nodes_info[i].id == 0) {
-        //printf("nodes_info[%d].id=%d", i, nodes_info[i].id);
-        sum_ww += nodes_info[i].weight;
-      } else {
-        sum_nww += nodes_info[i].weight;
-      }
-    }
-  } else if (num_workers == 2) {
-    //workers: 0,1
-    char weights[] = "/home/dgureya/devs/unstickymem/config/weights_2w.txt";
-    read_weights(weights);
-    //printf("Worker Nodes:\t");
-    LDEBUG("Worker Nodes: 0,1");
-    for (i = 0; i < MAX_NODES; i++) {
-      if (nodes_info[i].id == 0 || nodes_info[i].id == 1) {
-        //printf("nodes_info[%d].id=%d\t", i, nodes_info[i].id);
-        sum_ww += nodes_info[i].weight;
-      } else {
-        sum_nww += nodes_info[i].weight;
-      }
-    }
-  } else if (num_workers == 3) {
-    //workers: 1,2,3
-    char weights[] = "/home/dgureya/devs/unstickymem/config/weights_3w.txt";
-    read_weights(weights);
-    //printf("Worker Nodes:\t");
-    LDEBUG("Worker Nodes: 1,2,3");
-    for (i = 0; i < MAX_NODES; i++) {
-      if (nodes_info[i].id == 1 || nodes_info[i].id == 2
-          || nodes_info[i].id == 3) {
-        //printf("nodes_info[%d].id=%d\t", i, nodes_info[i].id);
-        sum_ww += nodes_info[i].weight;
-      } else {
-        sum_nww += nodes_info[i].weight;
-      }
-    }
-  } else if (num_workers == 4) {
-    //workers: 0,1,2,3
-    char weights[] = "/home/dgureya/devs/unstickymem/config/weights_4w.txt";
-    read_weights(weights);
-    //printf("Worker Nodes:\t");
-    LDEBUG("Worker Nodes: 0,1,2,3");
-    for (i = 0; i < MAX_NODES; i++) {
-      if (nodes_info[i].id == 0 || nodes_info[i].id == 1
-          || nodes_info[i].id == 2 || nodes_info[i].id == 3) {
-        //printf("nodes_info[%d].id=%d\t", i, nodes_info[i].id);
-        sum_ww += nodes_info[i].weight;
-      } else {
-        sum_nww += nodes_info[i].weight;
-      }
-    }
-  } else {
-    LDEBUGF("Sorry, %d workers is not supported at the moment!", num_workers);
-    exit (EXIT_FAILURE);
-  }
+// Wrapped functions
 
-  if ((int) round((sum_nww + sum_ww)) != 100) {
-    LDEBUGF(
-        "Sum of WW and NWW must be equal to 100! WW=%.2f\tNWW=%.2f\tSUM=%.2f\n",
-        sum_ww, sum_nww, sum_nww + sum_ww);
-    exit(-1);
-  } else {
-    LDEBUGF("WW = %.2f\tNWW = %.2f\n", sum_ww, sum_nww);
-  }
+// the real function: resolved by init_real_functions, or looked up until then
+// (dlsym must not run under a failing dlopen, it clobbers the pending error)
+#define REAL(x) (WRAP(x) != nullptr ? WRAP(x) : \
+    (__typeof__(WRAP(x))) dlsym(RTLD_NEXT, #x))
 
-  return;
+// small requests are carved out of an existing arena and never create a new
+// mapping, so they can skip the segment bookkeeping (and its syscalls)
+static inline bool is_small_allocation(size_t size) {
+  return size < unstickymem::alloc_threshold;
 }
 
-// Wrapped functions
+static inline bool is_small_object(void *ptr) {
+  return malloc_usable_size(ptr) < unstickymem::alloc_threshold;
+}
 
 void *malloc(size_t size) {
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
-    return ((void* (*)(size_t)) dlsym(RTLD_NEXT, "malloc"))(size);
+    return REAL(malloc)(size);
+  }
+
+  // fast path: does not need tracking
+  if (is_small_allocation(size)) {
+    return WRAP(malloc)(size);
   }
 
   // handle the function ourselves
@@ -300,12 +260,18 @@ void *calloc(size_t nmemb, size_t size) {
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
     inside_dlsym = true;
-    void *result = ((void* (*)(size_t, size_t)) dlsym(RTLD_NEXT, "calloc"))(
-        nmemb, size);
+    void *result = REAL(calloc)(nmemb, size);
     inside_dlsym = false;
     return result;
   }
 
+  // fast path: does not need tracking
+  size_t total_size;
+  if (!__builtin_mul_overflow(nmemb, size, &total_size)
+      && is_small_allocation(total_size)) {
+    return WRAP(calloc)(nmemb, size);
+  }
+
   // handle the function ourselves
   unstickymem::inside_unstickymem = true;
   void *result = unstickymem::memory->handle_calloc(nmemb, size);
@@ -317,7 +283,12 @@ void *calloc(size_t nmemb, size_t size) {
 void *realloc(void *ptr, size_t size) {
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
-    return ((void *(*)(void*, size_t)) dlsym(RTLD_NEXT, "realloc"))(ptr, size);
+    return REAL(realloc)(ptr, size);
+  }
+
+  // fast path: neither the old nor the new object need tracking
+  if (is_small_allocation(size) && is_small_object(ptr)) {
+    return WRAP(realloc)(ptr, size);
   }
 
   // handle the function ourselves
@@ -331,9 +302,16 @@ void *realloc(void *ptr, size_t size) {
 void *reallocarray(void *ptr, size_t nmemb, size_t size) {
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
-    return ((void *(*)(void*, size_t, size_t)) dlsym(RTLD_NEXT, "reallocarray"))(
-        ptr, nmemb, size);
+    return REAL(reallocarray)(ptr, nmemb, size);
   }
+
+  // fast path: neither the old nor the new object need tracking
+  size_t total_size;
+  if (!__builtin_mul_overflow(nmemb, size, &total_size)
+      && is_small_allocation(total_size) && is_small_object(ptr)) {
+    return WRAP(reallocarray)(ptr, nmemb, size);
+  }
+
   // handle the function ourselves
   unstickymem::inside_unstickymem = true;
   void *result = unstickymem::memory->handle_reallocarray(ptr, nmemb, size);
@@ -350,8 +328,14 @@ void free(void *ptr) {
   }
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
-    return ((void (*)(void*)) dlsym(RTLD_NEXT, "free"))(ptr);
+    return REAL(free)(ptr);
+  }
+
+  // fast path: object was never tracked
+  if (is_small_object(ptr)) {
+    return WRAP(free)(ptr);
   }
+
   // handle the function ourselves
   unstickymem::inside_unstickymem = true;
   unstickymem::memory->handle_free(ptr);
@@ -362,9 +346,15 @@ void free(void *ptr) {
 int posix_memalign(void **memptr, size_t alignment, size_t size) {
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
-    return ((int (*)(void**, size_t, size_t)) dlsym(RTLD_NEXT, "posix_memalign"))(
-        memptr, alignment, size);
+    return REAL(posix_memalign)(memptr, alignment, size);
+  }
+
+  // fast path: does not need tracking (worst case pads the size by alignment)
+  if (alignment < unstickymem::alloc_threshold
+      && is_small_allocation(size + alignment)) {
+    return WRAP(posix_memalign)(memptr, alignment, size);
   }
+
   // handle the function ourselves
   unstickymem::inside_unstickymem = true;
   int result = unstickymem::memory->handle_posix_memalign(memptr, alignment,
@@ -378,9 +368,7 @@ void *mmap(void *addr, size_t length, int prot, int flags, int fd,
            off_t offset) {
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
-    return ((void *(*)(void*, size_t, int, int, int, off_t)) dlsym(RTLD_NEXT,
-                                                                   "mmap"))(
-        addr, length, prot, flags, fd, offset);
+    return REAL(mmap)(addr, length, prot, flags, fd, offset);
   }
   // handle the function ourselves
   unstickymem::inside_unstickymem = true;
@@ -396,7 +384,7 @@ void *mmap(void *addr, size_t length, int prot, int flags, int fd,
 int munmap(void *addr, size_t length) {
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
-    return ((int (*)(void*, size_t)) dlsym(RTLD_NEXT, "munmap"))(addr, length);
+    return REAL(munmap)(addr, length);
   }
   // handle the function ourselves
   unstickymem::inside_unstickymem = true;
@@ -415,7 +403,7 @@ void *mremap(void *old_address, size_t old_size, size_t new_size, int flags,
 int brk(void *addr) {
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
-    return ((int (*)(void*)) dlsym(RTLD_NEXT, "brk"))(addr);
+    return REAL(brk)(addr);
   }
   // handle the function ourselves
   unstickymem::inside_unstickymem = true;
@@ -428,7 +416,7 @@ int brk(void *addr) {
 void *sbrk(intptr_t increment) {
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
-    return ((void *(*)(intptr_t)) dlsym(RTLD_NEXT, "sbrk"))(increment);
+    return REAL(sbrk)(increment);
   }
   // handle the function ourselves
   unstickymem::inside_unstickymem = true;
@@ -443,9 +431,7 @@ long mbind(void *addr, unsigned long len, int mode,
            unsigned flags) {
   // dont do anything fancy if library is not initialized
   if (!unstickymem::is_initialized || unstickymem::inside_unstickymem) {
-    return ((long (*)(void*, unsigned long, int, const unsigned long*,
-                      unsigned long, unsigned)) dlsym(RTLD_NEXT, "mbind"))(
-        addr, len, mode, nodemask, maxnode, flags);
+    return REAL(mbind)(addr, len, mode, nodemask, maxnode, flags);
   }
   // handle the function ourselves
   unstickymem::inside_unstickymem = true;
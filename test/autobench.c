@@ -134,7 +134,7 @@ unsigned long time_diff(struct timeval* start, struct timeval* stop) {
   return 1000000 * sec_res + usec_res;
 }
 
-static pid_t gettid(void) {
+static pid_t get_tid(void) {
   return syscall(__NR_gettid);
 }
 
@@ -166,7 +166,7 @@ void * doWork(void *pdata) {
   int tid;
   
   /** Set thread affinity **/
-  tid = gettid();
+  tid = get_tid();
   set_affinity(tid, tn->assigned_core);
   
   /**
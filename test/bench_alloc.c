@@ -0,0 +1,102 @@
+/*
+ * Measures the per-call cost of small malloc/calloc/realloc/free calls.
+ *
+ * This program does not link against unstickymem. Run it twice to see the
+ * overhead introduced by the library's interposers:
+ *   ./bench_alloc
+ *   LD_PRELOAD=/path/to/libunstickymem.so ./bench_alloc
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#define BATCH      1024
+#define ITERATIONS 4096
+
+static void *ptrs[BATCH];
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char *name, size_t size, uint64_t elapsed) {
+  double calls = (double) BATCH * ITERATIONS;
+  printf("%-8s %8zu bytes %10.2f ns/call\n", name, size, elapsed / calls);
+}
+
+static void bench_malloc_free(size_t size) {
+  uint64_t t_malloc = 0, t_free = 0;
+  for (int it = 0; it < ITERATIONS; it++) {
+    uint64_t start = now_ns();
+    for (int i = 0; i < BATCH; i++) {
+      ptrs[i] = malloc(size);
+    }
+    uint64_t middle = now_ns();
+    for (int i = 0; i < BATCH; i++) {
+      free(ptrs[i]);
+    }
+    t_malloc += middle - start;
+    t_free += now_ns() - middle;
+  }
+  report("malloc", size, t_malloc);
+  report("free", size, t_free);
+}
+
+static void bench_calloc(size_t size) {
+  uint64_t elapsed = 0;
+  for (int it = 0; it < ITERATIONS; it++) {
+    uint64_t start = now_ns();
+    for (int i = 0; i < BATCH; i++) {
+      ptrs[i] = calloc(1, size);
+    }
+    elapsed += now_ns() - start;
+    for (int i = 0; i < BATCH; i++) {
+      free(ptrs[i]);
+    }
+  }
+  report("calloc", size, elapsed);
+}
+
+static void bench_realloc(size_t size) {
+  uint64_t elapsed = 0;
+  for (int it = 0; it < ITERATIONS; it++) {
+    for (int i = 0; i < BATCH; i++) {
+      ptrs[i] = malloc(size);
+    }
+    uint64_t start = now_ns();
+    for (int i = 0; i < BATCH; i++) {
+      ptrs[i] = realloc(ptrs[i], size * 2);
+    }
+    elapsed += now_ns() - start;
+    for (int i = 0; i < BATCH; i++) {
+      free(ptrs[i]);
+    }
+  }
+  report("realloc", size, elapsed);
+}
+
+int main(int argc, char *argv[]) {
+  const size_t sizes[] = { 16, 64, 256, 1024, 4096, 16384 };
+  const size_t num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+
+  printf("%s (%s)\n", argv[0],
+         getenv("LD_PRELOAD") ? getenv("LD_PRELOAD") : "no preload");
+
+  for (size_t i = 0; i < num_sizes; i++) {
+    bench_malloc_free(sizes[i]);
+  }
+  for (size_t i = 0; i < num_sizes; i++) {
+    bench_calloc(sizes[i]);
+  }
+  for (size_t i = 0; i < num_sizes; i++) {
+    bench_realloc(sizes[i]);
+  }
+
+  return 0;
+}
@@ -0,0 +1,83 @@
+/*
+ * Compares the cost of a stall counter sample on each read path.
+ *
+ * - rdpmc: a ThreadCounter read from user space (perf mmap page)
+ * - read(2): the same counter, read through the syscall
+ * - perf: the perf backend, one read(2) per worker CPU
+ * - likwid: the LIKWID backend (stops, reads and restarts the counters)
+ *
+ * Where the CPU exposes no stall event (e.g. in a VM) task-clock is counted
+ * instead, which is never read with rdpmc.
+ *
+ * usage: bench_counters [samples, default 100000]
+ */
+
+#include <linux/perf_event.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/counters/LikwidBackend.hpp"
+#include "unstickymem/counters/PerfEventBackend.hpp"
+#include "unstickymem/counters/ThreadCounter.hpp"
+
+using unstickymem::LikwidBackend;
+using unstickymem::PerfEventBackend;
+using unstickymem::ThreadCounter;
+using unstickymem::Topology;
+
+static volatile double sink;
+
+static void bench(const char *name, size_t samples,
+                  const std::function<double()> &sample) {
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < samples; i++) {
+    sink = sample();
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  printf("%10s %14.1lf\n", name, elapsed.count() / samples);
+}
+
+int main(int argc, char *argv[]) {
+  size_t samples = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+  const Topology &topology = Topology::getInstance();
+
+  std::vector<PerfEventBackend::Event> events = PerfEventBackend::stallEvents();
+  events.push_back({ "task-clock", PERF_TYPE_SOFTWARE,
+      PERF_COUNT_SW_TASK_CLOCK });
+
+  printf("%10s %14s\n", "path", "ns/sample");
+  ThreadCounter counter(events);
+  if (counter.isOpen()) {
+    if (counter.userspaceReads()) {
+      bench("rdpmc", samples, [&]() { return counter.read(); });
+    } else {
+      printf("%10s %14s\n", "rdpmc", "unavailable");
+    }
+    bench("read(2)", samples, [&]() { return counter.readSyscall(); });
+  }
+
+  PerfEventBackend perf(events);
+  if (perf.start(topology)) {
+    bench("perf", samples, [&]() { return perf.readStalls(); });
+    perf.stop();
+  } else {
+    printf("%10s %14s\n", "perf", "unavailable");
+  }
+
+  // LIKWID is much slower: fewer samples
+  LikwidBackend likwid;
+  if (likwid.start(topology)) {
+    bench("likwid", samples / 100 + 1, [&]() { return likwid.readStalls(); });
+    likwid.stop();
+  } else {
+    printf("%10s %14s\n", "likwid", "unavailable");
+  }
+
+  return 0;
+}
@@ -0,0 +1,55 @@
+/*
+ * Compares the page migration backends on force_uniform_interleave.
+ *
+ * For each backend, maps and touches a fresh region, interleaves it through
+ * all nodes and reports the syscalls made, the number of mappings (VMAs) the
+ * region ends up split in and the migration throughput.
+ *
+ * usage: bench_migration [region size in MB, default 512]
+ */
+
+#include <sys/mman.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/placement/MigrationExecutor.hpp"
+#include "vmas.h"
+
+using unstickymem::MigrationBackend;
+using unstickymem::MigrationExecutor;
+
+int main(int argc, char *argv[]) {
+  size_t size = (argc > 1 ? strtoul(argv[1], NULL, 10) : 512) << 20;
+  MigrationExecutor &executor = MigrationExecutor::getInstance();
+  const unstickymem::Topology &topology = unstickymem::Topology::getInstance();
+
+  printf("%12s %10s %12s %12s %14s\n", "backend", "syscalls", "VMAs before",
+         "VMAs after", "pages/s");
+  for (MigrationBackend backend : MigrationBackend::_values()) {
+    char *region = reinterpret_cast<char*>(mmap(NULL, size,
+                                                PROT_READ | PROT_WRITE,
+                                                MAP_PRIVATE | MAP_ANONYMOUS,
+                                                -1, 0));
+    if (region == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+    }
+    memset(region, 1, size);
+    uintptr_t start = reinterpret_cast<uintptr_t>(region);
+
+    size_t vmas_before = count_vmas(start, start + size);
+    unstickymem::force_uniform_interleave(topology, region, size, backend);
+    MigrationExecutor::Statistics statistics = executor.lastRun();
+    size_t vmas_after = count_vmas(start, start + size);
+
+    printf("%12s %10zu %12zu %12zu %14.0lf\n", backend._to_string(),
+           statistics.syscalls, vmas_before, vmas_after,
+           statistics.pagesPerSecond());
+    munmap(region, size);
+  }
+  return 0;
+}
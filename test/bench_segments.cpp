@@ -0,0 +1,108 @@
+/*
+ * Scaling benchmark for the segment index used by the MemoryMap.
+ *
+ * For 10 up to 1M live segments, measures the cost of inserting, looking up
+ * (stabbing and overlap queries) and removing segments, and compares lookups
+ * against a linear scan of a std::list (what the MemoryMap used to do).
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <list>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "unstickymem/memory/SegmentTree.hpp"
+
+using unstickymem::MemorySegment;
+using unstickymem::SegmentTree;
+using Clock = std::chrono::steady_clock;
+
+static const uintptr_t BASE = 0x100000000000;
+static const uintptr_t SEGMENT_STRIDE = 1 << 22;  // 4MB apart
+static const uintptr_t SEGMENT_LENGTH = 1 << 21;  // 2MB long
+static const size_t NUM_LOOKUPS = 100000;
+static const size_t NUM_LIST_LOOKUPS = 1000;
+
+static void* address(uintptr_t a) {
+  return reinterpret_cast<void*>(a);
+}
+
+static double ns_per_op(Clock::time_point start, size_t ops) {
+  std::chrono::duration<double, std::nano> elapsed = Clock::now() - start;
+  return elapsed.count() / ops;
+}
+
+int main() {
+  std::mt19937_64 rng(42);
+
+  printf("%10s %12s %12s %12s %12s %12s\n", "segments", "insert(ns)",
+         "find(ns)", "overlap(ns)", "remove(ns)", "list(ns)");
+
+  for (size_t n = 10; n <= 1000000; n *= 10) {
+    // random insertion order
+    std::vector<uintptr_t> starts(n);
+    for (size_t i = 0; i < n; i++) {
+      starts[i] = BASE + i * SEGMENT_STRIDE;
+    }
+    std::shuffle(starts.begin(), starts.end(), rng);
+    std::uniform_int_distribution<size_t> pick(0, n - 1);
+
+    // insert
+    SegmentTree tree;
+    auto start = Clock::now();
+    for (uintptr_t s : starts) {
+      tree.insert(MemorySegment(address(s), address(s + SEGMENT_LENGTH - 1),
+                                "bench"));
+    }
+    double insert_ns = ns_per_op(start, n);
+
+    // stabbing queries
+    size_t found = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < NUM_LOOKUPS; i++) {
+      found += tree.find(address(starts[pick(rng)] + 42)) != nullptr;
+    }
+    double find_ns = ns_per_op(start, NUM_LOOKUPS);
+
+    // overlap queries spanning a few segments
+    start = Clock::now();
+    for (size_t i = 0; i < NUM_LOOKUPS; i++) {
+      uintptr_t s = starts[pick(rng)];
+      found += tree.overlapping(address(s), address(s + 3 * SEGMENT_STRIDE))
+          .size();
+    }
+    double overlap_ns = ns_per_op(start, NUM_LOOKUPS);
+
+    // same lookups on a list
+    std::list<MemorySegment> list(tree.begin(), tree.end());
+    start = Clock::now();
+    for (size_t i = 0; i < NUM_LIST_LOOKUPS; i++) {
+      void *a = address(starts[pick(rng)] + 42);
+      found += std::find_if(list.begin(), list.end(),
+                            [a](const MemorySegment &s) {
+                              return s.contains(a);
+                            }) != list.end();
+    }
+    double list_ns = ns_per_op(start, NUM_LIST_LOOKUPS);
+
+    // remove everything
+    std::shuffle(starts.begin(), starts.end(), rng);
+    start = Clock::now();
+    for (uintptr_t s : starts) {
+      found += tree.extract(address(s)).size();
+    }
+    double remove_ns = ns_per_op(start, n);
+
+    printf("%10zu %12.1f %12.1f %12.1f %12.1f %12.1f\n", n, insert_ns, find_ns,
+           overlap_ns, remove_ns, list_ns);
+    if (!tree.empty() || found == 0) {
+      fprintf(stderr, "unexpected tree state\n");
+      return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Compares three ways of placing the pages of a fresh region by a weighted
+ * plan (uniform weights over the memory nodes):
+ *
+ *   mbind      the plan's memory policies, set before the pages are touched
+ *   move       the pages touched first, then migrated by the plan
+ *   userfault  the pages placed exactly as they are first touched, by the
+ *              userfaultfd handler
+ *
+ * For each, reports the first-touch latency (average and 99th percentile),
+ * the pages placed per second (touch and migration), and the share of the
+ * pages that ended up on the node the plan gives them.
+ *
+ * usage: bench_userfault [region size in MB, default 256]
+ */
+
+#include <numaif.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/placement/UserfaultHandler.hpp"
+
+using unstickymem::PlacementPlan;
+using unstickymem::Topology;
+using unstickymem::UserfaultHandler;
+using Clock = std::chrono::steady_clock;
+
+enum Variant { MBIND, MOVE, USERFAULT };
+
+// share of the pages of the region on the node the plan gives them
+static double placed_share(const PlacementPlan &plan, char *region,
+                           size_t pages, size_t page_size) {
+  std::vector<void*> addresses(pages);
+  std::vector<int> status(pages);
+  for (size_t i = 0; i < pages; i++) {
+    addresses[i] = region + i * page_size;
+  }
+  if (move_pages(0, pages, addresses.data(), NULL, status.data(), 0) != 0) {
+    return 0;
+  }
+  size_t placed = 0;
+  for (const auto &range : plan) {
+    for (uintptr_t page = range.start; page < range.end();
+         page += page_size) {
+      size_t i = (page - reinterpret_cast<uintptr_t>(region)) / page_size;
+      placed += status[i] == unstickymem::plan_page_node(range, page, 0);
+    }
+  }
+  return static_cast<double>(placed) / pages;
+}
+
+int main(int argc, char *argv[]) {
+  size_t size = (argc > 1 ? strtoul(argv[1], NULL, 10) : 256) << 20;
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t pages = size / page_size;
+  const Topology &topology = Topology::getInstance();
+  std::vector<double> weights(topology.numNodes(), 0.0);
+  std::vector<int> nodes = topology.memoryNodes();
+  for (int node : nodes) {
+    weights[node] = 100.0 / nodes.size();
+  }
+  bool userfault = UserfaultHandler::getInstance().start();
+  std::vector<double> latencies(pages);
+
+  struct {
+    const char *name;
+    Variant variant;
+    bool available;
+  } variants[] = {
+      { "mbind", MBIND, true },
+      { "move", MOVE, true },
+      { "userfault", USERFAULT, userfault } };
+
+  printf("%10s %10s %10s %12s %8s\n", "variant", "avg(us)", "p99(us)",
+         "pages/s", "placed");
+  for (auto &variant : variants) {
+    if (!variant.available) {
+      printf("%10s not available\n", variant.name);
+      continue;
+    }
+    char *region = reinterpret_cast<char*>(mmap(NULL, size,
+                                                PROT_READ | PROT_WRITE,
+                                                MAP_PRIVATE | MAP_ANONYMOUS,
+                                                -1, 0));
+    if (region == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+    }
+    PlacementPlan plan = unstickymem::plan_weighted(topology, region, size,
+                                                    weights);
+
+    auto start = Clock::now();
+    if (variant.variant == MBIND) {
+      unstickymem::apply_plan(plan, 0);
+    } else if (variant.variant == USERFAULT
+        && !UserfaultHandler::getInstance().registerPlan(plan)) {
+      printf("%10s could not register the region\n", variant.name);
+      munmap(region, size);
+      continue;
+    }
+    for (size_t i = 0; i < pages; i++) {
+      auto touch = Clock::now();
+      region[i * page_size] = 1;
+      latencies[i] = std::chrono::duration<double, std::micro>(
+          Clock::now() - touch).count();
+    }
+    if (variant.variant == MOVE) {
+      unstickymem::apply_plan(plan, MPOL_MF_MOVE);
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start)
+        .count();
+
+    double average = 0;
+    for (double latency : latencies) {
+      average += latency / pages;
+    }
+    std::nth_element(latencies.begin(), latencies.begin() + pages * 99 / 100,
+                     latencies.end());
+    printf("%10s %10.2lf %10.2lf %12.0lf %7.1lf%%\n", variant.name, average,
+           latencies[pages * 99 / 100], pages / seconds,
+           100 * placed_share(plan, region, pages, page_size));
+
+    if (variant.variant == USERFAULT) {
+      UserfaultHandler::getInstance().unregister(
+          reinterpret_cast<uintptr_t>(region), size);
+    }
+    munmap(region, size);
+  }
+  if (userfault) {
+    UserfaultHandler::Statistics stats =
+        UserfaultHandler::getInstance().statistics();
+    printf("userfaultfd: %lu faults (%lu misplaced), %.0lf faults/s\n",
+           stats.faults, stats.misplaced, stats.faultsPerSecond());
+  }
+  return 0;
+}
@@ -0,0 +1,105 @@
+/*
+ * Compares weighted interleaving by slicing a region (one MPOL_INTERLEAVE
+ * range per node, over a shrinking set of nodes) with the kernel's native
+ * MPOL_WEIGHTED_INTERLEAVE (Linux 6.9+, root, UNSTICKYMEM_NATIVE_WEIGHTS=1).
+ *
+ * For each, places a fresh region with uniform weights and then re-weights
+ * it (node k gets a weight proportional to k+1), reporting the number of
+ * mappings (VMAs) the region ends up in and how long each step took. The
+ * process keeps the first native weights it sets: with several nodes, the
+ * native re-weighting is sliced.
+ *
+ * usage: bench_weighted [region size in MB, default 512]
+ */
+
+#include <sys/mman.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/placement/MigrationExecutor.hpp"
+#include "unstickymem/placement/WeightedInterleave.hpp"
+#include "vmas.h"
+
+using unstickymem::PlacementPlan;
+using unstickymem::Topology;
+using Clock = std::chrono::steady_clock;
+
+typedef PlacementPlan (*Planner)(const Topology&, void*, unsigned long,
+                                 const std::vector<double>&);
+
+// weights (in %) of the memory nodes, by node id
+static std::vector<double> make_weights(const Topology &topology,
+                                        bool skewed) {
+  std::vector<int> nodes = topology.memoryNodes();
+  std::vector<double> weights(topology.numNodes(), 0.0);
+  double total = 0;
+  for (size_t i = 0; i < nodes.size(); i++) {
+    total += skewed ? i + 1 : 1;
+  }
+  for (size_t i = 0; i < nodes.size(); i++) {
+    weights[nodes[i]] = (skewed ? i + 1 : 1) * 100 / total;
+  }
+  return weights;
+}
+
+static double place(const Topology &topology, void *region, size_t size,
+                    Planner planner, const std::vector<double> &weights) {
+  auto start = Clock::now();
+  unstickymem::MigrationExecutor::getInstance().run(
+      planner(topology, region, size, weights),
+      MPOL_MF_MOVE | MPOL_MF_STRICT);
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char *argv[]) {
+  size_t size = (argc > 1 ? strtoul(argv[1], NULL, 10) : 512) << 20;
+  const Topology &topology = Topology::getInstance();
+  std::vector<double> uniform = make_weights(topology, false);
+  std::vector<double> skewed = make_weights(topology, true);
+
+  struct {
+    const char *name;
+    Planner planner;
+    bool available;
+  } variants[] = {
+      { "slices", unstickymem::plan_weighted_slices, true },
+      { "native", unstickymem::plan_weighted_interleave,
+        unstickymem::weighted_interleave_supported(topology) } };
+
+  printf("%8s %8s %12s %8s %12s\n", "variant", "VMAs", "place(s)", "VMAs",
+         "reweight(s)");
+  for (auto &variant : variants) {
+    if (!variant.available) {
+      printf("%8s not available\n", variant.name);
+      continue;
+    }
+    char *region = reinterpret_cast<char*>(mmap(NULL, size,
+                                                PROT_READ | PROT_WRITE,
+                                                MAP_PRIVATE | MAP_ANONYMOUS,
+                                                -1, 0));
+    if (region == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+    }
+    memset(region, 1, size);
+    uintptr_t start = reinterpret_cast<uintptr_t>(region);
+
+    double place_time = place(topology, region, size, variant.planner,
+                              uniform);
+    size_t place_vmas = count_vmas(start, start + size);
+    double reweight_time = place(topology, region, size, variant.planner,
+                                 skewed);
+    size_t reweight_vmas = count_vmas(start, start + size);
+
+    printf("%8s %8zu %12.3lf %8zu %12.3lf\n", variant.name, place_vmas,
+           place_time, reweight_vmas, reweight_time);
+    munmap(region, size);
+  }
+  return 0;
+}
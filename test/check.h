@@ -0,0 +1,22 @@
+/*
+ * Checks for the test programs: a failed CHECK prints where it failed and
+ * counts an error. Tests end by printing the number of errors, and exit
+ * with a non-zero status if there were any.
+ */
+
+#ifndef TEST_CHECK_H_
+#define TEST_CHECK_H_
+
+#include <stdio.h>
+
+static size_t errors = 0;
+
+#define CHECK(cond)                                          \
+  do {                                                       \
+    if (!(cond)) {                                           \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      errors++;                                              \
+    }                                                        \
+  } while (0)
+
+#endif  // TEST_CHECK_H_
@@ -0,0 +1,114 @@
+/*
+ * Checks that the access tracker ranks the chunks of a region by how many
+ * of their pages were accessed in a window, and that the local pages of an
+ * adaptive placement are the hottest chunks (or the tail, without samples).
+ * The soft-dirty bits are only used if asked for.
+ */
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdint>
+
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/memory/AccessTracker.hpp"
+#include "unstickymem/placement/PlacementPlan.hpp"
+#include "check.h"
+
+using unstickymem::AccessTracker;
+using unstickymem::PlacementPlan;
+using unstickymem::Topology;
+
+int main() {
+  const Topology &topology = Topology::getInstance();
+  const size_t page = sysconf(_SC_PAGESIZE);
+  const size_t chunk = 64 * page;
+  const size_t length = 8 * chunk;
+
+  // a region of 8 chunks, all of it resident, in small pages (a huge page
+  // would be accessed as a whole)
+  char *region = static_cast<char*>(mmap(nullptr, length + chunk,
+                                         PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  CHECK(region != MAP_FAILED);
+  uintptr_t start = (reinterpret_cast<uintptr_t>(region) + chunk - 1)
+      / chunk * chunk;
+  char *aligned = reinterpret_cast<char*>(start);
+  madvise(aligned, length, MADV_NOHUGEPAGE);
+  for (size_t offset = 0; offset < length; offset += page) {
+    aligned[offset] = 1;
+  }
+
+  // without samples, the local pages are the tail of the region
+  AccessTracker tracker(chunk);
+  PlacementPlan plan = unstickymem::plan_local_bytes(topology, aligned,
+                                                     length, 2 * chunk,
+                                                     &tracker);
+  CHECK(plan.size() == 2);
+  CHECK(plan.back().mode == MPOL_LOCAL
+        && plan.back().start == start + 6 * chunk);
+
+  // chunk 1 is the hottest, then chunk 4
+  tracker.add(start + chunk, 64);
+  tracker.add(start + 4 * chunk + 5 * page, 8);
+  CHECK(tracker.heat(start + chunk + page) == 64);
+  CHECK(tracker.heat(start) == 0);
+  CHECK(tracker.hotChunks() == 2);
+
+  // the two hottest chunks go local, in address order
+  plan = unstickymem::plan_local_bytes(topology, aligned, length, 2 * chunk,
+                                       &tracker);
+  CHECK(plan.size() == 5);
+  CHECK(unstickymem::plan_length(plan) == length);
+  CHECK(plan[1].mode == MPOL_LOCAL && plan[1].start == start + chunk
+        && plan[1].length == chunk);
+  CHECK(plan[3].mode == MPOL_LOCAL && plan[3].start == start + 4 * chunk
+        && plan[3].length == chunk);
+
+  // a chunk and a half: the hottest one, then the tail of the next
+  plan = unstickymem::plan_local_bytes(topology, aligned, length,
+                                       chunk + chunk / 2, &tracker);
+  CHECK(plan.size() == 5);
+  CHECK(plan[3].mode == MPOL_LOCAL
+        && plan[3].start == start + 4 * chunk + chunk / 2);
+
+  // a larger share keeps the pages that were already local
+  PlacementPlan smaller = unstickymem::plan_local_bytes(topology, aligned,
+                                                        length, chunk,
+                                                        &tracker);
+  CHECK(unstickymem::plan_length(
+      unstickymem::plan_difference(smaller, plan)) == chunk / 2);
+
+  // the soft-dirty bits are only used if asked for
+  {
+    AccessTracker cautious;
+    cautious.start();
+    CHECK(cautious.source() != +unstickymem::AccessSource::SOFT_DIRTY);
+  }
+
+  // one window: every page of chunk 2, a few of chunk 6
+  tracker.reset();
+  if (tracker.start(true)) {
+    printf("tracking page accesses with %s\n",
+           tracker.source()._to_string());
+    tracker.mark(start, length);
+    for (size_t offset = 0; offset < chunk; offset += page) {
+      aligned[2 * chunk + offset] = 2;
+    }
+    for (size_t offset = 0; offset < 8 * page; offset += page) {
+      aligned[6 * chunk + offset] = 2;
+    }
+    tracker.collect(start, length);
+    CHECK(tracker.heat(start + 2 * chunk) == 64);
+    CHECK(tracker.heat(start + 6 * chunk) == 8);
+    CHECK(tracker.hotChunks() == 2);
+  } else {
+    printf("page accesses cannot be tracked here\n");
+  }
+
+  munmap(region, length + chunk);
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
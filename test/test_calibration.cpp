@@ -0,0 +1,66 @@
+/*
+ * Checks the node weights calibration: weights follow the measured
+ * bandwidths and are cached, so the second start does not calibrate.
+ */
+
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "unstickymem/Calibration.hpp"
+#include "unstickymem/Topology.hpp"
+#include "check.h"
+
+using unstickymem::Topology;
+
+static double sum(const std::vector<double> &weights) {
+  double total = 0;
+  for (double weight : weights) {
+    total += weight;
+  }
+  return total;
+}
+
+int main() {
+  const Topology &topology = Topology::getInstance();
+
+  // weights are proportional to the bandwidth and always sum to 100
+  std::vector<double> weights = unstickymem::bandwidth_weights({ 1, 3 });
+  CHECK(weights[0] == 25 && weights[1] == 75);
+  weights = unstickymem::bandwidth_weights({ 0, 2e9, 2e9 });
+  CHECK(weights[0] == 0 && weights[1] == 50 && weights[2] == 50);
+  weights = unstickymem::bandwidth_weights({ 1, 1, 1 });
+  CHECK(std::fabs(sum(weights) - 100) < 1e-9);
+
+  // the calibration measures every node we can place memory on
+  std::vector<double> bandwidth = unstickymem::measure_node_bandwidth(topology);
+  for (int node : topology.memoryNodes()) {
+    CHECK(bandwidth[node] > 0);
+  }
+
+  // the first start calibrates and caches, the next one reads the cache
+  char cache[] = "/tmp/unstickymem-calibration-XXXXXX";
+  CHECK(mkdtemp(cache) != NULL);
+  std::string cache_dir = std::string(cache) + "/nested";
+  std::string filename = cache_dir + "/weights-"
+      + unstickymem::calibration_key(topology) + ".txt";
+  weights = unstickymem::calibrated_weights(topology, cache_dir);
+  CHECK(std::lround(sum(weights)) == 100);
+  CHECK(access(filename.c_str(), R_OK) == 0);
+
+  std::vector<double> cached = { 30.5, 0, 69.5 };
+  CHECK(unstickymem::write_weights(filename, cached, "test"));
+  CHECK(unstickymem::calibrated_weights(topology, cache_dir) == cached);
+  CHECK(unstickymem::read_weights(filename) == cached);
+
+  unlink(filename.c_str());
+  rmdir(cache_dir.c_str());
+  rmdir(cache);
+
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
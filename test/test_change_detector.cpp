@@ -0,0 +1,60 @@
+/*
+ * Checks the Page-Hinkley change detector: a noisy but stable signal, or a
+ * single outlier, is not a change; a step up or down is, within a few
+ * samples.
+ */
+
+#include <cstdio>
+#include <random>
+
+#include "unstickymem/stats/ChangeDetector.hpp"
+#include "check.h"
+
+using unstickymem::PageHinkley;
+
+// feeds `n` samples around `mean`, returns after how many a change was seen
+// (0 if none was)
+static size_t feed(PageHinkley *detector, std::mt19937 *rng, double mean,
+                   size_t n) {
+  std::normal_distribution<double> noise(0, 0.02);
+  for (size_t i = 1; i <= n; i++) {
+    if (detector->add(mean + noise(*rng))) {
+      return i;
+    }
+  }
+  return 0;
+}
+
+int main() {
+  std::mt19937 rng(42);
+
+  // stable: nothing in a long while
+  PageHinkley detector(0.05, 1.0);
+  CHECK(feed(&detector, &rng, 1.0, 1000) == 0);
+  CHECK(detector.mean() > 0.99 && detector.mean() < 1.01);
+
+  // a single outlier is not a change
+  CHECK(!detector.add(1.5));
+  CHECK(feed(&detector, &rng, 1.0, 100) == 0);
+
+  // a step up of 50% is seen within a few samples
+  size_t after = feed(&detector, &rng, 1.5, 100);
+  printf("step up seen after %zu samples\n", after);
+  CHECK(after > 0 && after <= 5);
+
+  // and so is a step down
+  detector.reset();
+  CHECK(detector.count() == 0);
+  CHECK(feed(&detector, &rng, 1.0, 100) == 0);
+  after = feed(&detector, &rng, 0.5, 100);
+  printf("step down seen after %zu samples\n", after);
+  CHECK(after > 0 && after <= 5);
+
+  // a change within the drift is not
+  detector.reset();
+  feed(&detector, &rng, 1.0, 100);
+  CHECK(feed(&detector, &rng, 1.03, 1000) == 0);
+
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
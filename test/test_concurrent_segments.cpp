@@ -0,0 +1,169 @@
+/*
+ * Stress test for the MemoryMap snapshots.
+ *
+ * Application threads mmap/munmap concurrently while another thread keeps
+ * walking snapshots of the MemoryMap, like the placement threads do.
+ * Every snapshot must be consistent (sorted, with the advertised size),
+ * every mapping must be visible as soon as mmap returns, and the walks must
+ * never hold up the allocating threads.
+ *
+ * Also checks that unmapping the middle of a mapping leaves both of its
+ * ends tracked, and that placing the pages of a snapshot survives its
+ * segments being unmapped in the meantime.
+ */
+
+#include <sys/mman.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/memory/MemoryMap.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static const int NUM_WRITERS = 4;
+static const int NUM_ITERATIONS = 20000;
+static const size_t MAPPING_SIZE = 64 * 4096;
+// large enough to be placed
+static const size_t PLACED_SIZE = 4 << 20;
+static const int NUM_PLACED = 200;
+
+int main() {
+  unstickymem::MemoryMap &memory = unstickymem::MemoryMap::getInstance();
+  std::atomic<bool> done(false);
+  std::atomic<size_t> errors(0);
+  std::vector<double> max_latency_us(NUM_WRITERS, 0.0);
+  size_t walks = 0;
+  size_t walked_segments = 0;
+
+  // a hole in the middle of a mapping splits its segment
+  char *region = static_cast<char*>(mmap(nullptr, 16 * 4096,
+                                         PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  munmap(region + 6 * 4096, 4 * 4096);
+  std::shared_ptr<const unstickymem::SegmentTree> split = memory.snapshot();
+  auto before = split->find(region);
+  auto hole = split->find(region + 8 * 4096);
+  auto after = split->find(region + 12 * 4096);
+  if (before == nullptr || before->endAddress() != region + 6 * 4096 - 1
+      || hole != nullptr || after == nullptr
+      || after->startAddress() != region + 10 * 4096
+      || after->endAddress() != region + 16 * 4096 - 1) {
+    printf("partial munmap: segments not split\n");
+    errors++;
+  }
+  munmap(region, 16 * 4096);
+  split = memory.snapshot();
+  if (split->find(region) != nullptr
+      || split->find(region + 12 * 4096) != nullptr) {
+    printf("munmap: segments left behind\n");
+    errors++;
+  }
+
+  // keeps iterating over snapshots, like place_all_pages
+  std::thread reader([&]() {
+    while (!done) {
+      std::shared_ptr<const unstickymem::SegmentTree> snapshot = memory
+          .snapshot();
+      size_t count = 0;
+      uintptr_t previous = 0;
+      for (auto &segment : *snapshot) {
+        uintptr_t start = reinterpret_cast<uintptr_t>(segment.startAddress());
+        if (start < previous || segment.endAddress() < segment.startAddress()) {
+          errors++;
+        }
+        previous = start;
+        count++;
+      }
+      if (count != snapshot->size()) {
+        errors++;
+      }
+      walks++;
+      walked_segments += count;
+    }
+  });
+
+  std::vector<std::thread> writers;
+  for (int w = 0; w < NUM_WRITERS; w++) {
+    writers.emplace_back([&, w]() {
+      std::vector<void*> mapped;
+      for (int i = 0; i < NUM_ITERATIONS; i++) {
+        auto start = Clock::now();
+        void *p = mmap(nullptr, MAPPING_SIZE, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        std::chrono::duration<double, std::micro> elapsed = Clock::now()
+            - start;
+        max_latency_us[w] = std::max(max_latency_us[w], elapsed.count());
+        if (p == MAP_FAILED || memory.snapshot()->find(p) == nullptr) {
+          errors++;
+          continue;
+        }
+        mapped.push_back(p);
+        // keep a few hundred mappings alive, release them in bulk
+        if (mapped.size() == 256) {
+          for (void *m : mapped) {
+            munmap(m, MAPPING_SIZE);
+          }
+          mapped.clear();
+        }
+      }
+      for (void *m : mapped) {
+        munmap(m, MAPPING_SIZE);
+      }
+    });
+  }
+
+  for (auto &writer : writers) {
+    writer.join();
+  }
+  done = true;
+  reader.join();
+
+  // placement passes over segments that are being unmapped
+  done = false;
+  size_t passes = 0;
+  std::thread placer([&]() {
+    while (!done) {
+      unstickymem::place_all_pages_adaptive(passes % 2 ? 0.5 : 1.0);
+      passes++;
+    }
+  });
+  writers.clear();
+  for (int w = 0; w < NUM_WRITERS; w++) {
+    writers.emplace_back([&]() {
+      for (int i = 0; i < NUM_PLACED; i++) {
+        char *p = static_cast<char*>(mmap(nullptr, PLACED_SIZE,
+                                          PROT_READ | PROT_WRITE,
+                                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (p == MAP_FAILED) {
+          errors++;
+          continue;
+        }
+        for (size_t offset = 0; offset < PLACED_SIZE; offset += 64 * 4096) {
+          p[offset] = 1;
+        }
+        munmap(p, PLACED_SIZE);
+      }
+    });
+  }
+  for (auto &writer : writers) {
+    writer.join();
+  }
+  done = true;
+  placer.join();
+  printf("%zu placement passes while unmapping\n", passes);
+
+  printf("%zu snapshot walks (%.1f segments on average)\n", walks,
+         walks ? static_cast<double>(walked_segments) / walks : 0.0);
+  for (int w = 0; w < NUM_WRITERS; w++) {
+    printf("writer %d: worst mmap latency %.1f us\n", w, max_latency_us[w]);
+  }
+  printf("%zu errors\n", errors.load());
+  return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,88 @@
+/*
+ * Drives the tuning thread of the continuous mode with a fake objective:
+ * after a phase change it moves to the new optimum if that is clearly
+ * better, and stays where it is if the gain is within the precision. Once
+ * the mode is stopped, it no longer watches for phase changes.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "unstickymem/mode/ContinuousMode.hpp"
+#include "check.h"
+
+using unstickymem::ContinuousMode;
+
+// the stall rate is lowest at the optimum of the current phase. every phase
+// change is detected right away, until the phases run out
+class FakeContinuousMode : public ContinuousMode {
+ public:
+  std::vector<double> optima;  // of each phase
+  std::vector<double> ratios;  // tuned to, at the end of each phase
+  size_t phase = 0;
+
+  explicit FakeContinuousMode(const std::vector<double> &phase_optima)
+      : optima(phase_optima) {
+    _wait_start = 0;
+    _num_polls = 1;
+    _poll_sleep = 1000;
+    _poll_precision = 0.02;
+    _tolerance = 1;
+    _window = 20;
+    _monitor_period = 1000;
+    _change_drift = 0.05;
+    _change_threshold = 1;
+    _holdoff = 0;
+  }
+
+ protected:
+  double maxShare(void) {
+    return 100;
+  }
+
+  double evaluate(double share) {
+    share = round(share * 10) / 10;
+    return 1 + fabs(share - optima[phase]) / 100;
+  }
+
+  bool waitForPhaseChange(double baseline) {
+    ratios.push_back(tunedRatio());
+    return ++phase < optima.size();
+  }
+};
+
+// the real phase change detector, with a short monitor period
+class StoppableContinuousMode : public ContinuousMode {
+ public:
+  StoppableContinuousMode() {
+    _monitor_period = 1000;
+    _change_drift = 0.05;
+    _change_threshold = 1;
+  }
+
+  using ContinuousMode::waitForPhaseChange;
+};
+
+int main() {
+  FakeContinuousMode mode({ 30, 50, 50.5 });
+  mode.tuningThread();
+  CHECK(mode.ratios.size() == 3);
+  if (mode.ratios.size() == 3) {
+    printf("tuned at %.1lf, %.1lf, %.1lf\n", mode.ratios[0], mode.ratios[1],
+           mode.ratios[2]);
+    // found the optimum, then followed it
+    CHECK(fabs(mode.ratios[0] - 30) <= 1);
+    CHECK(fabs(mode.ratios[1] - 50) <= 1);
+    // less than 2% better: not worth moving
+    CHECK(mode.ratios[2] == mode.ratios[1]);
+  }
+
+  // a stopped mode stops watching for phase changes
+  StoppableContinuousMode stoppable;
+  stoppable.stop();
+  CHECK(!stoppable.waitForPhaseChange(1));
+
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,125 @@
+/*
+ * Checks the counter backends: falling back when a backend cannot start,
+ * and the perf_event_open backend following threads created after it was
+ * opened on every worker CPU, with a per-node breakdown (with a software
+ * event, so it also runs where there is no PMU).
+ */
+
+#include <linux/perf_event.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/counters/CounterBackend.hpp"
+#include "unstickymem/counters/EventTable.hpp"
+#include "unstickymem/counters/PerfEventBackend.hpp"
+#include "unstickymem/counters/SoftwareBackend.hpp"
+#include "unstickymem/counters/ThreadCounter.hpp"
+#include "check.h"
+
+using unstickymem::CounterBackend;
+using unstickymem::CounterMetric;
+using unstickymem::CpuModel;
+using unstickymem::PerfEventBackend;
+using unstickymem::SoftwareBackend;
+using unstickymem::ThreadCounter;
+using unstickymem::Topology;
+
+static void spin(double seconds) {
+  auto start = std::chrono::steady_clock::now();
+  while (std::chrono::duration<double>(std::chrono::steady_clock::now()
+      - start).count() < seconds) {
+  }
+}
+
+int main() {
+  const Topology &topology = Topology::getInstance();
+  std::string selected;
+
+  // the event table: the model's own events first, then the generic ones
+  CpuModel skylake = { "GenuineIntel", 6, 0x55 };
+  CHECK(std::string(find_microarchitecture(skylake)->name) == "Skylake-SP");
+  auto events = counter_events(CounterMetric::REMOTE_DRAM, skylake);
+  CHECK(events.size() == 2 && events[0].config == 0x02d3);
+  CHECK(events.back().type == PERF_TYPE_HW_CACHE);
+  CpuModel unknown = { "GenuineIntel", 6, 0x01 };
+  CHECK(find_microarchitecture(unknown) == nullptr);
+  CHECK(counter_events(CounterMetric::STALLS, unknown).size() == 1);
+  CHECK(likwid_stall_events(unknown) == nullptr);
+  CpuModel milan = { "AuthenticAMD", 0x19, 0x01 };
+  CHECK(std::string(find_microarchitecture(milan)->name) == "Zen 3");
+  auto uarch = find_microarchitecture(CpuModel::current());
+  printf("this CPU: %s\n", uarch ? uarch->name : "not in the table");
+
+  // "none" always starts, and reads nothing
+  auto backend = CounterBackend::select("none", topology, &selected);
+  CHECK(selected == "none");
+  CHECK(backend->readStalls() == 0);
+  backend->stop();
+
+  // "auto" always ends up with a backend that started, never the opt-in one
+  backend = CounterBackend::select("auto", topology, &selected);
+  CHECK(backend != nullptr && !selected.empty() && selected != "software");
+  printf("auto selected %s\n", selected.c_str());
+  backend->stop();
+
+  // perf: an event that cannot be opened is skipped
+  PerfEventBackend perf({
+      { "bogus", PERF_TYPE_RAW, ~0ULL },
+      { "task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK } });
+  CHECK(perf.start(topology));
+
+  // and threads created afterwards are counted (task-clock is in ns)
+  double before = perf.readStalls();
+  std::thread worker(spin, 0.2);
+  worker.join();
+  double after = perf.readStalls();
+  printf("task-clock: %.0lf ns\n", after - before);
+  CHECK(after - before >= 0.1e9);
+
+  // the per-node breakdown adds up, and only the worker nodes count
+  std::vector<double> nodes = perf.readNodeStalls();
+  CHECK(nodes.size() == topology.numNodes());
+  double total = 0;
+  for (size_t node = 0; node < nodes.size(); node++) {
+    CHECK(topology.isWorker(node) || nodes[node] == 0);
+    total += nodes[node];
+  }
+  CHECK(total >= after);
+  perf.stop();
+  CHECK(perf.readStalls() == 0);
+
+  // the kernel statistics are always there, when asked for
+  backend = CounterBackend::select("software", topology, &selected);
+  CHECK(selected == "software");
+  backend->stop();
+  SoftwareBackend software;
+  CHECK(software.start(topology));
+  printf("software backend: %s\n", software.source()._to_string());
+  spin(0.05);
+  nodes = software.readNodeStalls();
+  CHECK(nodes.size() == topology.numNodes());
+  for (double stalls : nodes) {
+    CHECK(stalls >= 0);
+  }
+  CHECK(software.locality() >= 0 && software.locality() <= 1);
+  software.stop();
+  CHECK(software.readStalls() == 0);
+
+  // a thread counter reads the same with and without the syscall
+  ThreadCounter counter({
+      { "task-clock", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK } });
+  CHECK(counter.isOpen());
+  before = counter.read();
+  spin(0.1);
+  after = counter.read();
+  CHECK(after - before >= 0.05e9);
+  CHECK(counter.readSyscall() >= after);
+
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
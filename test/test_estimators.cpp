@@ -0,0 +1,128 @@
+/*
+ * Checks the online estimators against values computed offline, that
+ * sampling stops early on a stable signal but not on a noisy one, and that
+ * the sequential comparisons stop as soon as the verdict is clear.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "unstickymem/stats/Estimators.hpp"
+#include "unstickymem/stats/HypothesisTest.hpp"
+#include "check.h"
+
+using unstickymem::Estimate;
+using unstickymem::Ewma;
+using unstickymem::Comparison;
+using unstickymem::RunningStats;
+using unstickymem::Verdict;
+using unstickymem::WindowedStats;
+
+static bool near(double a, double b, double tolerance) {
+  return fabs(a - b) <= tolerance * fabs(b);
+}
+
+int main() {
+  // quantiles, from the tables
+  CHECK(near(unstickymem::normal_quantile(0.975), 1.959964, 1e-6));
+  CHECK(near(unstickymem::normal_quantile(0.01), -2.326348, 1e-6));
+  CHECK(near(unstickymem::student_t_quantile(0.975, 1), 12.7062, 1e-4));
+  CHECK(near(unstickymem::student_t_quantile(0.975, 2), 4.3027, 1e-4));
+  CHECK(near(unstickymem::student_t_quantile(0.975, 3), 3.1824, 2e-3));
+  CHECK(near(unstickymem::student_t_quantile(0.975, 10), 2.2281, 1e-3));
+  CHECK(near(unstickymem::student_t_quantile(0.975, 30), 2.0423, 1e-3));
+
+  // 2 4 4 4 5 5 7 9: mean 5, sample variance 32/7
+  double samples[] = { 2, 4, 4, 4, 5, 5, 7, 9 };
+  RunningStats stats;
+  WindowedStats window(8);
+  for (double x : samples) {
+    stats.add(x);
+    window.add(x);
+  }
+  CHECK(stats.count() == 8);
+  CHECK(near(stats.mean(), 5, 1e-12));
+  CHECK(near(stats.variance(), 32.0 / 7, 1e-12));
+  CHECK(near(stats.halfWidth(0.95), 2.3646 * sqrt(32.0 / 7 / 8), 1e-3));
+  CHECK(window.full());
+  CHECK(window.median() == 4.5);
+  CHECK(near(window.mad(), 1.4826 * 0.5, 1e-12));
+  CHECK(window.trimmedMean(0.25) == 4.5);
+
+  // the window forgets the oldest samples
+  window.add(100);
+  CHECK(window.count() == 8);
+  CHECK(window.median() == 5);
+
+  // EWMA: the first sample is the mean, then it moves alpha of the way
+  Ewma ewma(0.5);
+  CHECK(ewma.empty());
+  ewma.add(10);
+  ewma.add(20);
+  CHECK(ewma.mean() == 15);
+  CHECK(ewma.variance() == 25);
+
+  // a stable signal with a few outliers converges after a few samples
+  std::mt19937 random(42);
+  std::normal_distribution<double> stable(1.0, 0.001);
+  size_t calls = 0;
+  Estimate e = unstickymem::estimate([&]() {
+    calls++;
+    return calls % 7 == 0 ? 10.0 : stable(random);
+  }, 0, 0.0005, 1.0);
+  printf("stable: %.4lf +- %.4lf after %zu samples, %zu outliers\n", e.mean,
+         e.half_width, e.samples, e.outliers);
+  CHECK(e.converged);
+  CHECK(near(e.mean, 1.0, 0.01));
+  CHECK(e.samples < 100);
+  CHECK(e.outliers == calls / 7);
+
+  // a noisy one runs out of budget instead
+  std::normal_distribution<double> noisy(1.0, 1.0);
+  e = unstickymem::estimate([&]() { return noisy(random); }, 1000, 0.001,
+                            0.05);
+  CHECK(!e.converged);
+  CHECK(e.seconds <= 0.06);
+
+  // Welch: 1 2 3 4 5 vs 3 4 5 6 7 differ by 2, t = -2 with 8 df (p = 0.08)
+  RunningStats a, b;
+  for (int x = 1; x <= 5; x++) {
+    a.add(x);
+    b.add(x + 2);
+  }
+  CHECK(unstickymem::welch_test(a, b, 0.10, 0) == +Verdict::BETTER);
+  CHECK(unstickymem::welch_test(a, b, 0.05, 0) == +Verdict::INCONCLUSIVE);
+  CHECK(unstickymem::welch_test(b, a, 0.10, 0) == +Verdict::WORSE);
+  CHECK(unstickymem::welch_test(a, a, 0.05, 1.0) == +Verdict::SAME);
+
+  // sequential comparisons against a reference with mean 1
+  RunningStats reference;
+  std::normal_distribution<double> one(1.0, 0.01);
+  for (int i = 0; i < 20; i++) {
+    reference.add(one(random));
+  }
+  std::normal_distribution<double> lower(0.95, 0.01), higher(1.05, 0.01);
+  Comparison c = unstickymem::compare([&]() { return lower(random); }, 0,
+                                      reference, 0.05, 0.01, 1.0);
+  CHECK(c.verdict == +Verdict::BETTER);
+  CHECK(c.candidate.samples < 10);
+  c = unstickymem::compare([&]() { return higher(random); }, 0, reference,
+                           0.05, 0.01, 1.0);
+  CHECK(c.verdict == +Verdict::WORSE);
+  CHECK(c.candidate.samples < 10);
+  c = unstickymem::compare([&]() { return one(random); }, 0, reference,
+                           0.05, 0.05, 1.0);
+  CHECK(c.verdict == +Verdict::SAME);
+  printf("same after %zu samples\n", c.candidate.samples);
+
+  // no counters: every sample is zero
+  RunningStats zeros;
+  zeros.add(0);
+  zeros.add(0);
+  c = unstickymem::compare([]() { return 0.0; }, 0, zeros, 0.05, 0.01, 1.0);
+  CHECK(c.verdict == +Verdict::SAME);
+
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,110 @@
+/*
+ * Runs placement plans on the migration threads and checks that every
+ * chunk was applied exactly once, with the policy of its range, and that
+ * capped migrations respect the bandwidth.
+ */
+
+#include <sys/mman.h>
+#include <numa.h>
+#include <numaif.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/placement/MigrationExecutor.hpp"
+
+using unstickymem::MigrationExecutor;
+using unstickymem::PlacementPlan;
+
+static const size_t REGION_SIZE = 256ULL << 20;
+
+int main() {
+  MigrationExecutor &executor = MigrationExecutor::getInstance();
+  size_t errors = 0;
+
+  char *region = reinterpret_cast<char*>(mmap(nullptr, REGION_SIZE,
+                                              PROT_READ | PROT_WRITE,
+                                              MAP_PRIVATE | MAP_ANONYMOUS,
+                                              -1, 0));
+  if (region == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  memset(region, 1, REGION_SIZE);
+
+  // half local, half interleaved, several chunks each
+  uintptr_t start = reinterpret_cast<uintptr_t>(region);
+  unsigned long all_nodes = numa_get_mems_allowed()->maskp[0];
+  PlacementPlan plan = {
+      { start, REGION_SIZE / 2, MPOL_LOCAL, 0 },
+      { start + REGION_SIZE / 2, REGION_SIZE / 2, MPOL_INTERLEAVE, all_nodes } };
+
+  for (int run = 0; run < 3; run++) {
+    MigrationExecutor::Statistics statistics = executor.run(
+        plan, MPOL_MF_MOVE | MPOL_MF_STRICT);
+    size_t expected_chunks = REGION_SIZE / MigrationExecutor::CHUNK_LENGTH;
+    printf("run %d: %zu threads, %zu chunks (%zu stolen), %.0lf pages/s\n",
+           run, executor.numWorkers(), statistics.chunks, statistics.steals,
+           statistics.pagesPerSecond());
+    if (statistics.bytes != REGION_SIZE || statistics.chunks != expected_chunks) {
+      printf("expected %zu bytes in %zu chunks, got %zu in %zu\n",
+             REGION_SIZE, expected_chunks, statistics.bytes, statistics.chunks);
+      errors++;
+    }
+  }
+
+  // capped at two regions per second: moving it twice takes a second
+  executor.setBandwidth(2 * REGION_SIZE);
+  for (int run = 0; run < 2; run++) {
+    executor.submit(plan, MPOL_MF_MOVE | MPOL_MF_STRICT);
+    if (executor.pendingBytes() == 0) {
+      printf("capped run %d: nothing pending right after submitting\n", run);
+      errors++;
+    }
+  }
+  MigrationExecutor::Statistics statistics = executor.wait();
+  printf("capped: %zu bytes in %.3lfs (%zu chunks)\n", statistics.bytes,
+         statistics.seconds, statistics.chunks);
+  if (statistics.bytes != 2 * REGION_SIZE || executor.pendingBytes() != 0
+      || statistics.seconds < 0.9) {
+    errors++;
+  }
+  executor.setBandwidth(0);
+
+  // the workers finish MPOL_LOCAL chunks on their own, whatever node the
+  // submitter ends up on
+  executor.submit({ plan[0] }, MPOL_MF_MOVE | MPOL_MF_STRICT);
+  for (int i = 0; i < 1000 && executor.pendingBytes() != 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  if (executor.pendingBytes() != 0) {
+    printf("local chunks left without a waiter: %zu bytes\n",
+           executor.pendingBytes());
+    errors++;
+  }
+  executor.wait();
+
+  // check the policies at a few addresses
+  for (size_t offset = 0; offset < REGION_SIZE; offset += REGION_SIZE / 8) {
+    int mode = -1;
+    unsigned long nodemask = 0;
+    if (get_mempolicy(&mode, &nodemask, sizeof(nodemask) * 8, region + offset,
+                      MPOL_F_ADDR) != 0) {
+      perror("get_mempolicy");
+      errors++;
+      continue;
+    }
+    int expected = offset < REGION_SIZE / 2 ? MPOL_LOCAL : MPOL_INTERLEAVE;
+    if (mode != expected) {
+      printf("offset %zu: policy %d, expected %d\n", offset, mode, expected);
+      errors++;
+    }
+  }
+
+  munmap(region, REGION_SIZE);
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+/*
+ * Checks the phases mode (see CMakeLists.txt for its settings): each phase
+ * is tuned the first time it runs long enough, a phase cut short is not, and
+ * a tuned phase keeps its ratio when it begins again.
+ */
+
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+
+#include "unstickymem/unstickymem.h"
+#include "unstickymem/Runtime.hpp"
+#include "unstickymem/mode/PhaseMode.hpp"
+#include "check.h"
+
+using unstickymem::PhaseMode;
+using unstickymem::Runtime;
+
+// runs the phase until it is tuned, or for at most `seconds`
+static bool run_phase(PhaseMode *mode, const char *phase, double seconds,
+                      double *ratio) {
+  auto start = std::chrono::steady_clock::now();
+  unstickymem_phase_begin(phase);
+  bool tuned;
+  do {
+    usleep(10000);
+    tuned = mode->tunedRatio(phase, ratio);
+  } while (!tuned && std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count() < seconds);
+  unstickymem_phase_end();
+  return tuned;
+}
+
+int main() {
+  std::shared_ptr<unstickymem::Mode> selected = Runtime::getInstance()
+      .getMode();
+  PhaseMode *mode = dynamic_cast<PhaseMode*>(selected.get());
+  CHECK(mode != nullptr);
+  if (mode == nullptr) {
+    printf("%zu errors\n", errors);
+    return 1;
+  }
+  unstickymem_start();
+
+  // too short to be tuned
+  double ratio;
+  CHECK(!run_phase(mode, "short", 0.05, &ratio));
+  CHECK(!mode->tunedRatio("short", &ratio));
+
+  // long enough
+  double load, query;
+  CHECK(run_phase(mode, "load", 20, &load));
+  CHECK(run_phase(mode, "query", 20, &query));
+  printf("load: %.1lf, query: %.1lf\n", load, query);
+
+  // and remembered
+  CHECK(run_phase(mode, "load", 0, &ratio) && ratio == load);
+  CHECK(!mode->tunedRatio("short", &ratio));
+
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
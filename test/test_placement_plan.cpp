@@ -0,0 +1,219 @@
+/*
+ * Checks that moving between close placement ratios only rebinds the pages
+ * whose placement actually changes, that the initial placement only moves
+ * the pages that are resident, and that the system-wide weighted interleave
+ * weights are left alone unless allowed, and then set only once.
+ */
+
+#include <numaif.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/placement/PlacementPlan.hpp"
+#include "unstickymem/placement/WeightedInterleave.hpp"
+#include "check.h"
+
+using unstickymem::PlacementPlan;
+using unstickymem::Topology;
+
+static int read_node_weight(int node) {
+  char path[256];
+  snprintf(path, sizeof(path),
+           "/sys/kernel/mm/mempolicy/weighted_interleave/node%d", node);
+  FILE *f = fopen(path, "r");
+  int weight = -1;
+  if (f != NULL) {
+    if (fscanf(f, "%d", &weight) != 1) {
+      weight = -1;
+    }
+    fclose(f);
+  }
+  return weight;
+}
+
+int main() {
+  const size_t page = unstickymem::PAGE_SIZE;
+  const size_t len = 1000 * page;
+  void *addr = reinterpret_cast<void*>(0x10000000);
+  uintptr_t start = reinterpret_cast<uintptr_t>(addr);
+  const Topology &topology = Topology::getInstance();
+
+  // nothing to do when the layout does not change
+  PlacementPlan uniform = unstickymem::plan_interleave_all(topology, addr, len);
+  CHECK(unstickymem::plan_difference(uniform, uniform).empty());
+
+  // everything is new when the previous layout is unknown
+  PlacementPlan difference = unstickymem::plan_difference(PlacementPlan(),
+                                                          uniform);
+  CHECK(unstickymem::plan_length(difference) == len);
+
+  // the ranges of a local/interleave split that change between two ratios
+  PlacementPlan a = { { start, 600 * page, MPOL_INTERLEAVE, 3 },
+                      { start + 600 * page, 400 * page, MPOL_LOCAL, 0 } };
+  PlacementPlan b = { { start, 500 * page, MPOL_INTERLEAVE, 3 },
+                      { start + 500 * page, 500 * page, MPOL_LOCAL, 0 } };
+  difference = unstickymem::plan_difference(a, b);
+  CHECK(difference.size() == 1);
+  CHECK(difference[0].start == start + 500 * page);
+  CHECK(difference[0].length == 100 * page);
+  CHECK(difference[0].mode == MPOL_LOCAL);
+
+  // and going back
+  difference = unstickymem::plan_difference(b, a);
+  CHECK(difference.size() == 1);
+  CHECK(difference[0].start == start + 500 * page);
+  CHECK(difference[0].length == 100 * page);
+  CHECK(difference[0].mode == MPOL_INTERLEAVE);
+
+  // weighted slices: only the shifted boundaries are rebound, adjacent
+  // changes with the same policy are merged
+  PlacementPlan c = { { start, 200 * page, MPOL_INTERLEAVE, 3 },
+                      { start + 200 * page, 800 * page, MPOL_INTERLEAVE, 1 } };
+  PlacementPlan d = { { start, 100 * page, MPOL_INTERLEAVE, 3 },
+                      { start + 100 * page, 900 * page, MPOL_INTERLEAVE, 1 } };
+  difference = unstickymem::plan_difference(c, d);
+  CHECK(difference.size() == 1);
+  CHECK(difference[0].start == start + 100 * page);
+  CHECK(difference[0].length == 100 * page);
+  CHECK(difference[0].nodemask == 1);
+
+  // a segment that grew (e.g. the heap) gets its new pages placed
+  PlacementPlan grown = unstickymem::plan_interleave_all(topology, addr,
+                                                        len + 10 * page);
+  difference = unstickymem::plan_difference(uniform, grown);
+  CHECK(difference.size() == 1);
+  CHECK(difference[0].start == start + len);
+  CHECK(difference[0].length == 10 * page);
+
+  // weighted interleaving hands out runs of `weight` pages per node (by page
+  // number), and changing only the weights changes the layout
+  unstickymem::PlacementRange weighted = { start, 6 * page,
+      MPOL_WEIGHTED_INTERLEAVE, 3 };
+  weighted.weights[0] = 1;
+  weighted.weights[1] = 2;
+  for (size_t i = 0; i < 6; i++) {
+    int expected_node = (start / page + i) % 3 == 0 ? 0 : 1;
+    CHECK(unstickymem::weighted_interleave_node(weighted, start + i * page)
+          == expected_node);
+  }
+  unstickymem::PlacementRange reweighted = weighted;
+  reweighted.weights[1] = 1;
+  CHECK(unstickymem::plan_difference({ weighted }, { reweighted }).size() == 1);
+  CHECK(unstickymem::plan_difference({ weighted }, { weighted }).empty());
+
+  // the kernel weights are system-wide: they are not touched unless allowed,
+  // and then the process keeps the first ones it uses (those already set
+  // here, so nothing is written)
+  int node = topology.memoryNodes()[0];
+  int original = read_node_weight(node);
+  if (original > 0 && original < 255) {
+    CHECK(!unstickymem::weighted_interleave_supported(topology));
+    pid_t child = fork();
+    if (child == 0) {
+      unstickymem::weighted_interleave_allow_writes(true);
+      if (!unstickymem::weighted_interleave_supported(topology)) {
+        exit(2);
+      }
+      uint8_t current[unstickymem::MAX_PLAN_NODES] = {};
+      uint8_t other[unstickymem::MAX_PLAN_NODES] = {};
+      current[node] = original;
+      other[node] = original + 1;
+      bool kept = unstickymem::weighted_interleave_program(current, 1UL << node)
+          && unstickymem::weighted_interleave_compatible(current, 1UL << node)
+          && !unstickymem::weighted_interleave_compatible(other, 1UL << node)
+          && !unstickymem::weighted_interleave_program(other, 1UL << node);
+      exit(kept ? 0 : 1);
+    }
+    int status = -1;
+    CHECK(waitpid(child, &status, 0) == child);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) != 1);
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 2) {
+      printf("native weighted interleave is not available\n");
+    }
+    CHECK(read_node_weight(node) == original);
+  }
+
+  // plans always cover the whole region with page-aligned ranges
+  for (double ratio = 0.5; ratio <= 1.0; ratio += 0.1) {
+    PlacementPlan plan = unstickymem::plan_local_ratio(topology, addr, len,
+                                                       ratio);
+    CHECK(unstickymem::plan_length(plan) == len);
+    for (auto &range : plan) {
+      CHECK(range.start % page == 0 && range.length % page == 0);
+    }
+  }
+
+  // weighted slices cover the region whatever the node ids and weights
+  std::vector<double> weights(topology.numNodes(), 0.0);
+  for (int node : topology.memoryNodes()) {
+    weights[node] = 100.0 / topology.memoryNodes().size();
+  }
+  PlacementPlan slices = unstickymem::plan_weighted_slices(topology, addr, len,
+                                                           weights);
+  CHECK(unstickymem::plan_length(slices) == len);
+  CHECK(!slices.empty() && slices[0].nodemask == topology.memoryMask());
+
+  // moving s% of the pages to the workers keeps the total at 100%
+  std::vector<double> shifted = topology.weightsForWorkerShare(10);
+  double total = 0;
+  for (double weight : shifted) {
+    total += weight;
+  }
+  CHECK(std::lround(total) == std::lround(topology.workerWeight()
+                                          + topology.nonWorkerWeight()));
+  CHECK(!topology.workerNodes().empty());
+
+  // a mapping with only its first pages touched
+  const size_t mapped = 64 * page;
+  char *region = static_cast<char*>(mmap(nullptr, mapped,
+                                         PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  CHECK(region != MAP_FAILED);
+  for (size_t offset = 0; offset < 16 * page; offset += page) {
+    region[offset] = 1;
+  }
+  PlacementPlan everything = unstickymem::plan_interleave_all(topology, region,
+                                                              mapped);
+  PlacementPlan resident = unstickymem::plan_resident(everything);
+  CHECK(unstickymem::plan_length(resident) == 16 * page);
+  CHECK(!resident.empty()
+        && resident[0].start == reinterpret_cast<uintptr_t>(region));
+
+  // placing it lazily moves those, and sets the policy of the others
+  // without faulting them in
+  CHECK(unstickymem::apply_plan_lazily(everything) == 16 * page);
+  std::vector<unsigned char> residency(mapped / page);
+  CHECK(mincore(region, mapped, residency.data()) == 0);
+  size_t touched = 0;
+  for (unsigned char r : residency) {
+    touched += r & 1;
+  }
+  CHECK(touched == 16);
+  int mode = -1;
+  unsigned long mask = 0;
+  CHECK(get_mempolicy(&mode, &mask, sizeof(mask) * 8, region + 32 * page,
+                      MPOL_F_ADDR) == 0);
+  CHECK(mode == everything[0].mode);
+
+  // the same with local pages: they have no node to be moved to
+  PlacementPlan local = unstickymem::plan_local_ratio(topology, region,
+                                                      mapped, 1.0);
+  CHECK(!local.empty() && local.back().mode == MPOL_LOCAL);
+  CHECK(unstickymem::apply_plan_lazily(local) == 16 * page);
+  CHECK(get_mempolicy(&mode, &mask, sizeof(mask) * 8,
+                      reinterpret_cast<void*>(local.back().start),
+                      MPOL_F_ADDR) == 0);
+  CHECK(mode == MPOL_LOCAL);
+  munmap(region, mapped);
+
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
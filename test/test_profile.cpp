@@ -0,0 +1,60 @@
+/*
+ * Checks the profile store: profiles are read back as they were saved, a
+ * missing or incomplete profile is not read, and the key identifies this
+ * program on this machine.
+ */
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "unstickymem/Profile.hpp"
+#include "unstickymem/Topology.hpp"
+#include "check.h"
+
+using unstickymem::Profile;
+using unstickymem::Topology;
+
+int main() {
+  const Topology &topology = Topology::getInstance();
+
+  // the key does not change within a run, and names the file
+  std::string key = unstickymem::profile_key(topology);
+  CHECK(key.size() == 16);
+  CHECK(unstickymem::profile_key(topology) == key);
+  std::string build_id = unstickymem::executable_build_id();
+  printf("build-id: %s\n", build_id.empty() ? "none" : build_id.c_str());
+
+  char directory[] = "/tmp/unstickymem-profile-XXXXXX";
+  CHECK(mkdtemp(directory) != nullptr);
+  std::string store = std::string(directory) + "/profiles";
+  std::string filename = unstickymem::profile_filename(topology, store);
+  CHECK(filename == store + "/profile-" + key + ".txt");
+
+  // nothing there yet
+  Profile profile;
+  CHECK(!unstickymem::read_profile(filename, &profile));
+
+  // saving creates the directory, and replaces older profiles
+  CHECK(unstickymem::save_profile(filename, { "search", 12.3, 0.25 }));
+  CHECK(unstickymem::save_profile(filename, { "wadaptive", 40, 0.125 }));
+  CHECK(unstickymem::read_profile(filename, &profile));
+  CHECK(profile.mode == "wadaptive");
+  CHECK(profile.ratio == 40);
+  CHECK(profile.stall_rate == 0.125);
+
+  // an incomplete profile is not used
+  FILE *fp = fopen(filename.c_str(), "w");
+  fprintf(fp, "# truncated\nmode search\nratio 10\n");
+  fclose(fp);
+  CHECK(!unstickymem::read_profile(filename, &profile));
+
+  unlink(filename.c_str());
+  rmdir(store.c_str());
+  rmdir(directory);
+
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
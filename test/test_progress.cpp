@@ -0,0 +1,96 @@
+/*
+ * Checks the progress API: the operations and iterations reported by many
+ * threads add up (with their stalls), and the time per operation follows
+ * the rate at which they are reported.
+ */
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "unstickymem/unstickymem.h"
+#include "unstickymem/PerformanceCounters.hpp"
+#include "unstickymem/Progress.hpp"
+#include "unstickymem/counters/ThreadCounter.hpp"
+#include "check.h"
+
+using unstickymem::Objective;
+using unstickymem::ProgressCount;
+using unstickymem::ThreadCounter;
+
+int main() {
+  // nothing yet, and iterations stand in for operations until there are some
+  ProgressCount count = unstickymem::read_progress();
+  CHECK(count.ops == 0 && count.iterations == 0);
+  unstickymem::get_time_per_op();
+  for (int i = 0; i < 10; i++) {
+    usleep(10000);
+    unstickymem_iteration_done();
+  }
+  double per_iteration = unstickymem::get_time_per_op();
+  printf("%.4lf s per iteration\n", per_iteration);
+  CHECK(per_iteration >= 0.009 && per_iteration < 0.1);
+
+  // more threads than counters: nothing is lost
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < unstickymem::PROGRESS_SLOTS + 8; t++) {
+    threads.emplace_back([]() {
+      for (int i = 0; i < 1000; i++) {
+        unstickymem_report_progress(3);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  count = unstickymem::read_progress();
+  CHECK(count.ops == 3000 * (unstickymem::PROGRESS_SLOTS + 8));
+  CHECK(count.iterations == 10);
+
+  // the reporting threads added their stalls, if they could read them from
+  // user space
+  ThreadCounter counter;
+  if (counter.isOpen() && counter.userspaceReads()) {
+    CHECK(count.stalls > 0);
+  } else {
+    CHECK(count.stalls == 0);
+    printf("no user space stall counter for the threads\n");
+  }
+
+  // from now on, the time per operation
+  unstickymem::get_time_per_op();
+  for (int i = 0; i < 10; i++) {
+    usleep(10000);
+    unstickymem_report_progress(100);
+  }
+  double per_op = unstickymem::get_time_per_op();
+  printf("%.6lf s per op\n", per_op);
+  CHECK(per_op >= 0.00009 && per_op < 0.001);
+
+  // a period without progress counts as one operation
+  usleep(10000);
+  CHECK(unstickymem::get_time_per_op() >= 0.009);
+
+  // stall counts over operations
+  unstickymem::get_stalls_per_op();
+  for (int i = 0; i < 10; i++) {
+    usleep(10000);
+    unstickymem_report_progress(100);
+  }
+  double stalls_per_op = unstickymem::get_stalls_per_op();
+  printf("%.1lf stalls per op\n", stalls_per_op);
+  // the 1000 operations can not have more stalls than were ever counted
+  double counted = std::max<double>(unstickymem::get_stall_count(),
+                                    unstickymem::read_progress().stalls);
+  CHECK(stalls_per_op >= 0 && stalls_per_op * 1000 <= counted);
+
+  CHECK(unstickymem::parse_objective("Progress") == +Objective::PROGRESS);
+  CHECK(unstickymem::parse_objective("stalls_per_op")
+        == +Objective::STALLS_PER_OP);
+
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+/*
+ * Checks the golden-section search: it finds the minimum of unimodal
+ * functions (also at the ends of the interval) in O(log(1/tolerance))
+ * evaluations, and returns the best point evaluated.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <map>
+
+#include "unstickymem/stats/Search.hpp"
+#include "check.h"
+
+int main() {
+  // a parabola: 0..100 within 1 takes about log(100)/log(phi) = 10 steps
+  std::map<double, double> evaluations;
+  double best = unstickymem::golden_section_search(
+      [](double x) { return (x - 37) * (x - 37); }, 0, 100, 1, &evaluations);
+  printf("parabola: %.2lf after %zu evaluations\n", best, evaluations.size());
+  CHECK(fabs(best - 37) < 1);
+  CHECK(evaluations.size() <= 12);
+
+  // monotonic: the minimum is at an end of the interval
+  best = unstickymem::golden_section_search([](double x) { return x; }, 0, 100,
+                                            1);
+  CHECK(best < 1);
+  best = unstickymem::golden_section_search([](double x) { return -x; }, 0,
+                                            100, 1);
+  CHECK(best > 99);
+
+  // a point given beforehand is not evaluated again, and may win
+  evaluations.clear();
+  evaluations[0] = -1;
+  size_t calls = 0;
+  best = unstickymem::golden_section_search(
+      [&](double x) { calls++; return fabs(x - 50); }, 0, 100, 1,
+      &evaluations);
+  CHECK(best == 0);
+  CHECK(calls == evaluations.size() - 1);
+
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
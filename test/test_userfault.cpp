@@ -0,0 +1,108 @@
+/*
+ * Checks that, with userfaultfd, the pages of a registered region are born
+ * on the nodes its plan gives them, whether they are first touched by the
+ * program or by the kernel (a read() into the region), that unmapping part
+ * of a region keeps the plan of the rest, and that regions handed back to
+ * the kernel no longer go through the handler.
+ */
+
+#include <numaif.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "unstickymem/PagePlacement.hpp"
+#include "unstickymem/Topology.hpp"
+#include "unstickymem/placement/PlacementPlan.hpp"
+#include "unstickymem/placement/UserfaultHandler.hpp"
+#include "check.h"
+
+using unstickymem::PlacementPlan;
+using unstickymem::Topology;
+using unstickymem::UserfaultHandler;
+
+static const size_t page = unstickymem::PAGE_SIZE;
+
+// the pages of the plan in [start, end) are on the nodes it gives them
+static void check_nodes(const PlacementPlan &plan, char *start, char *end) {
+  for (const auto &range : plan) {
+    for (uintptr_t p = range.start; p < range.end(); p += page) {
+      if (p < reinterpret_cast<uintptr_t>(start)
+          || p >= reinterpret_cast<uintptr_t>(end)) {
+        continue;
+      }
+      int node = -1;
+      CHECK(get_mempolicy(&node, nullptr, 0, reinterpret_cast<void*>(p),
+                          MPOL_F_NODE | MPOL_F_ADDR) == 0);
+      CHECK(node == unstickymem::plan_page_node(range, p, 0));
+    }
+  }
+}
+
+int main() {
+  const size_t mapped = 64 * page;
+  const Topology &topology = Topology::getInstance();
+
+  UserfaultHandler &handler = UserfaultHandler::getInstance();
+  if (!handler.start()) {
+    printf("userfaultfd is not available\n");
+    return 0;
+  }
+
+  char *region = static_cast<char*>(mmap(nullptr, mapped,
+                                         PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  CHECK(region != MAP_FAILED);
+  PlacementPlan plan = unstickymem::plan_interleave_all(topology, region,
+                                                        mapped);
+  CHECK(handler.registerPlan(plan));
+
+  // the kernel writes the first pages: its faults are resolved too
+  int pipefd[2];
+  CHECK(pipe(pipefd) == 0);
+  std::vector<char> data(2 * page, 'x');
+  CHECK(write(pipefd[1], data.data(), data.size())
+        == static_cast<ssize_t>(data.size()));
+  CHECK(read(pipefd[0], region, data.size())
+        == static_cast<ssize_t>(data.size()));
+  CHECK(memcmp(region, data.data(), data.size()) == 0);
+  close(pipefd[0]);
+  close(pipefd[1]);
+
+  // unmapping the middle of the region keeps the plan of both ends
+  char *hole = region + 16 * page;
+  CHECK(munmap(hole, 16 * page) == 0);
+  handler.unregister(reinterpret_cast<uintptr_t>(hole), 16 * page);
+  for (size_t offset = 2 * page; offset < mapped; offset += page) {
+    if (region + offset < hole || region + offset >= hole + 16 * page) {
+      region[offset] = 1;
+    }
+  }
+  check_nodes(plan, region, hole);
+  check_nodes(plan, hole + 16 * page, region + mapped);
+  CHECK(handler.statistics().faults >= 48);
+  CHECK(handler.statistics().misplaced == 0);
+  handler.unregister(reinterpret_cast<uintptr_t>(region), mapped);
+  munmap(region, 16 * page);
+  munmap(hole + 16 * page, 32 * page);
+
+  // regions handed back to the kernel are not resolved by the handler
+  region = static_cast<char*>(mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  CHECK(region != MAP_FAILED);
+  plan = unstickymem::plan_interleave_all(topology, region, mapped);
+  CHECK(handler.registerPlan(plan));
+  handler.unregisterAll();
+  uint64_t faults = handler.statistics().faults;
+  for (size_t offset = 0; offset < mapped; offset += page) {
+    region[offset] = 1;
+  }
+  CHECK(handler.statistics().faults == faults);
+  munmap(region, mapped);
+
+  printf("%zu errors\n", errors);
+  return errors == 0 ? 0 : 1;
+}
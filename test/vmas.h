@@ -0,0 +1,28 @@
+/*
+ * Counts the mappings (VMAs) of the process that overlap a region, to see
+ * how much a placement splits it.
+ */
+
+#ifndef TEST_VMAS_H_
+#define TEST_VMAS_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+// number of mappings overlapping [start, end)
+static size_t count_vmas(uintptr_t start, uintptr_t end) {
+  FILE *maps = fopen("/proc/self/maps", "r");
+  size_t count = 0;
+  uintptr_t vma_start, vma_end;
+  char line[1024];
+  while (fgets(line, sizeof(line), maps) != NULL) {
+    if (sscanf(line, "%lx-%lx", &vma_start, &vma_end) == 2
+        && vma_start < end && vma_end > start) {
+      count++;
+    }
+  }
+  fclose(maps);
+  return count;
+}
+
+#endif  // TEST_VMAS_H_